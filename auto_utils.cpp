@@ -31,6 +31,8 @@ void params_set_defaults(f3kdb_params_t* params)
     params->random_algo_grain = RANDOM_ALGORITHM_UNIFORM;
     params->random_param_ref = DEFAULT_RANDOM_PARAM;
     params->random_param_grain = DEFAULT_RANDOM_PARAM;
+    params->memory_budget = 0;
+    params->large_pages = false;
 }
 
 int params_set_by_string(f3kdb_params_t* params, const char* name, const char* value_string)
@@ -54,5 +56,7 @@ int params_set_by_string(f3kdb_params_t* params, const char* name, const char* v
     if (!_stricmp(name, "random_algo_grain")) { return params_set_value_by_string(&params->random_algo_grain, value_string); }
     if (!_stricmp(name, "random_param_ref")) { return params_set_value_by_string(&params->random_param_ref, value_string); }
     if (!_stricmp(name, "random_param_grain")) { return params_set_value_by_string(&params->random_param_grain, value_string); }
+    if (!_stricmp(name, "memory_budget")) { return params_set_value_by_string(&params->memory_budget, value_string); }
+    if (!_stricmp(name, "large_pages")) { return params_set_value_by_string(&params->large_pages, value_string); }
     return F3KDB_ERROR_INVALID_NAME;
 }
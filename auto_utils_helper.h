@@ -5,6 +5,8 @@
 #include <stdlib.h>
 #include <stdarg.h>
 
+#include "compiler_compat.h"
+
 #include "include/f3kdb.h"
 
 using namespace std;
@@ -35,7 +37,7 @@ int params_set_value_by_string(T* target, const char* value_string)
     static_assert(is_integral<T>::value || is_same<T, double>::value || is_enum<T>::value, "T must be integral type");
     char* end = NULL;
     errno = 0;
-    number_converter<T>::intermediate_type value;
+    typename number_converter<T>::intermediate_type value;
     value = number_converter<T>::convert(value_string, &end);
     if (errno == ERANGE)
     {
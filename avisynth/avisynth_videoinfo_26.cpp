@@ -20,6 +20,7 @@ bool VideoInfo::IsYV24()  const { return (pixel_type & CS_PLANAR_MASK) == (CS_YV
 bool VideoInfo::IsYV16()  const { return (pixel_type & CS_PLANAR_MASK) == (CS_YV16  & CS_PLANAR_FILTER); }
 bool VideoInfo::IsYV12()  const { return (pixel_type & CS_PLANAR_MASK) == (CS_YV12  & CS_PLANAR_FILTER); }
 bool VideoInfo::IsY8()    const { return (pixel_type & CS_PLANAR_MASK) == (CS_Y8    & CS_PLANAR_FILTER); }
+bool VideoInfo::IsY()     const { return (pixel_type & CS_PLANAR_MASK & ~CS_Sample_Bits_Mask) == (CS_Y8 & CS_PLANAR_FILTER); }
 
 bool VideoInfo::IsYV411() const { return (pixel_type & CS_PLANAR_MASK) == (CS_YV411 & CS_PLANAR_FILTER); }
 //bool VideoInfo::IsYUV9()  const { return (pixel_type & CS_PLANAR_MASK) == (CS_YUV9  & CS_PLANAR_FILTER); }
@@ -99,7 +100,7 @@ bool VideoInfo::IsVPlaneFirst() const {
 }
 
 int VideoInfo::BytesFromPixels(int pixels) const {
-  return !IsY8() && IsPlanar() ? pixels << ((pixel_type>>CS_Shift_Sample_Bits) & 3) : pixels * (BitsPerPixel()>>3);   // For planar images, will return luma plane
+  return !IsY8() && IsPlanar() ? pixels * ComponentSize() : pixels * (BitsPerPixel()>>3);   // For planar images, will return luma plane
 }
 
 int VideoInfo::RowSize(int plane) const {
@@ -131,7 +132,7 @@ int VideoInfo::BMPSize() const {
 int VideoInfo::GetPlaneWidthSubsampling(int plane) const {  // Subsampling in bitshifts!
   if (plane == PLANAR_Y)  // No subsampling
     return 0;
-  if (IsY8())
+  if (IsY())
     throw AvisynthError("Filter error: GetPlaneWidthSubsampling not available on Y8 pixel type.");
   if (plane == PLANAR_U || plane == PLANAR_V) {
     if (IsYUY2())
@@ -147,7 +148,7 @@ int VideoInfo::GetPlaneWidthSubsampling(int plane) const {  // Subsampling in bi
 int VideoInfo::GetPlaneHeightSubsampling(int plane) const {  // Subsampling in bitshifts!
   if (plane == PLANAR_Y)  // No subsampling
     return 0;
-  if (IsY8())
+  if (IsY())
     throw AvisynthError("Filter error: GetPlaneHeightSubsampling not available on Y8 pixel type.");
   if (plane == PLANAR_U || plane == PLANAR_V) {
     if (IsYUY2())
@@ -177,12 +178,33 @@ int VideoInfo::BitsPerPixel() const {
 //      return 32;
     }
     if (IsPlanar()) {
+      if (IsY())
+        return 8 * ComponentSize();
       const int S = IsYUV() ? GetPlaneWidthSubsampling(PLANAR_U) + GetPlaneHeightSubsampling(PLANAR_U) : 0;
-      return ( ((1<<S)+2) * (8<<((pixel_type>>CS_Shift_Sample_Bits) & 3)) ) >> S;
+      return ( ((1<<S)+2) * (8 * ComponentSize()) ) >> S;
     }
     return 0;
 }
 
+int VideoInfo::BitsPerComponent() const {
+  if (!IsPlanar())
+    return 8;
+  switch (pixel_type & CS_Sample_Bits_Mask) {
+    case CS_Sample_Bits_8:  return 8;
+    case CS_Sample_Bits_10: return 10;
+    case CS_Sample_Bits_12: return 12;
+    case CS_Sample_Bits_14: return 14;
+    case CS_Sample_Bits_16: return 16;
+    case CS_Sample_Bits_32: return 32;
+  }
+  return 0;
+}
+
+int VideoInfo::ComponentSize() const {
+  const int bits = BitsPerComponent();
+  return bits == 8 ? 1 : (bits == 32 ? 4 : 2);
+}
+
 // useful mutator
 void VideoInfo::SetFPS(unsigned numerator, unsigned denominator) {
   if ((numerator == 0) || (denominator == 0)) {
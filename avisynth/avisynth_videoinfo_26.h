@@ -48,9 +48,11 @@ struct VideoInfo {
 7<<16 Sample resolution bits
         000 => 8
         001 => 16
-        010 => 32
+        010 => 32 (float in AviSynth+)
         011 => reserved
-        1xx => reserved
+        101 => 10 (AviSynth+)
+        110 => 12 (AviSynth+)
+        111 => 14 (AviSynth+)
 
 Planar match mask  1111.0000.0000.0111.0000.0111.0000.0111
 Planar signature   10xx.0000.0000.00xx.0000.00xx.00xx.00xx
@@ -83,6 +85,9 @@ Planar filter mask 1111.1111.1111.1111.1111.1111.1100.1111
     CS_Sample_Bits_8     = 0 << CS_Shift_Sample_Bits,
     CS_Sample_Bits_16    = 1 << CS_Shift_Sample_Bits,
     CS_Sample_Bits_32    = 2 << CS_Shift_Sample_Bits,
+    CS_Sample_Bits_10    = 5 << CS_Shift_Sample_Bits,
+    CS_Sample_Bits_12    = 6 << CS_Shift_Sample_Bits,
+    CS_Sample_Bits_14    = 7 << CS_Shift_Sample_Bits,
 
     CS_PLANAR_MASK       = CS_PLANAR | CS_INTERLEAVED | CS_YUV | CS_BGR | CS_Sample_Bits_Mask | CS_Sub_Height_Mask | CS_Sub_Width_Mask,
     CS_PLANAR_FILTER     = ~( CS_VPlaneFirst | CS_UPlaneFirst ),
@@ -163,6 +168,8 @@ Planar filter mask 1111.1111.1111.1111.1111.1111.1100.1111
   bool IsYV411() const;
 //bool IsYUV9()  const;
   bool IsY8()    const;
+  // greyscale of any sample size, from AviSynth+
+  bool IsY()     const;
 
   bool IsColorSpace(int c_space) const;
 
@@ -197,6 +204,10 @@ Planar filter mask 1111.1111.1111.1111.1111.1111.1100.1111
 
   int BytesPerChannelSample() const;
 
+  // from AviSynth+, 8 for formats without the sample resolution bits
+  int BitsPerComponent() const;
+  int ComponentSize() const;
+
   // useful mutator
   void SetFPS(unsigned numerator, unsigned denominator);
 
@@ -13,6 +13,10 @@ AVSValue __cdecl Create_dither(AVSValue args, void* user_data, IScriptEnvironmen
     PClip child = args[0].AsClip();
     const VideoInfo& vi = child->GetVideoInfo();
     check_video_format("f3kdb_dither", vi, env);
+    if (vi.BitsPerComponent() != 8)
+    {
+        env->ThrowError("f3kdb_dither: Only stacked or interleaved high bit depth clips are supported, use f3kdb with output_depth=8 for high bit depth clips of AviSynth+.");
+    }
 
     int mode = args[1].AsInt(1);
     bool stacked = args[2].AsBool(true);
@@ -11,6 +11,20 @@
 #include "filter.h"
 #include "check.h"
 
+// AviSynth+ planar formats with more than 8 bits per sample
+static int get_sample_bits_flag(int depth)
+{
+    switch (depth)
+    {
+    case 8: return VideoInfo::CS_Sample_Bits_8;
+    case 10: return VideoInfo::CS_Sample_Bits_10;
+    case 12: return VideoInfo::CS_Sample_Bits_12;
+    case 14: return VideoInfo::CS_Sample_Bits_14;
+    case 16: return VideoInfo::CS_Sample_Bits_16;
+    default: return -1;
+    }
+}
+
 AVSValue __cdecl Create_flash3kyuu_deband(AVSValue args, void* user_data, IScriptEnvironment* env){
     PClip child = ARG(child).AsClip();
     const VideoInfo& vi = child->GetVideoInfo();
@@ -21,21 +35,87 @@ AVSValue __cdecl Create_flash3kyuu_deband(AVSValue args, void* user_data, IScrip
     GetSystemInfo(&si);
     bool mt = ARG(mt).AsBool(si.dwNumberOfProcessors > 1);
 
+    // AviSynth+ is detected by Prefetch(). Its environments are per thread, so nothing running
+    // on threads of this filter may use the environment of the thread that requested the frame.
+    // It runs frames in parallel itself, so the U/V helper thread isn't needed there.
+    bool avs_plus = env->FunctionExists("Prefetch");
+    if (avs_plus)
+    {
+        mt = false;
+    }
+
+    int prefetch = ARG(prefetch).AsInt(0);
+    if (prefetch < 0)
+    {
+        env->ThrowError("f3kdb: prefetch must not be negative.");
+    }
+    // The prefetch thread calls GetFrame with the environment of the calling thread, and
+    // AviSynth+ prefetches frames itself with Prefetch().
+    if (prefetch > 0 && avs_plus)
+    {
+        env->ThrowError("f3kdb: prefetch is only supported in AviSynth 2.5 and 2.6, use Prefetch() in AviSynth+.");
+    }
+
+    // AviSynth+ high bit-depth samples are 16-bit little endian, as in the interleaved mode, 
+    // so they are passed as they are and the hacked formats are not used at all
+    int input_bits = vi.BitsPerComponent();
+    bool native_high_bit_depth = input_bits > 8;
+    if (input_bits == 32)
+    {
+        env->ThrowError("f3kdb: Float samples are not supported in AviSynth.");
+    }
+
     f3kdb_params_t params;
     f3kdb_params_init_defaults(&params);
     f3kdb_params_from_avs(args, &params);
+    if (native_high_bit_depth)
+    {
+        if (ARG(input_mode).Defined() || ARG(input_depth).Defined() || ARG(output_mode).Defined())
+        {
+            env->ThrowError("f3kdb: input_mode, input_depth and output_mode can't be used with high bit depth clips of AviSynth+.");
+        }
+        if (params.output_depth == -1)
+        {
+            params.output_depth = input_bits;
+        }
+        params.output_mode = params.output_depth <= 8 ? LOW_BIT_DEPTH : HIGH_BIT_DEPTH_INTERLEAVED;
+    }
     f3kdb_params_sanitize(&params);
 
     f3kdb_video_info_t video_info;
     video_info.num_frames = vi.num_frames;
-    video_info.pixel_mode = (PIXEL_MODE)ARG(input_mode).AsInt(DEFAULT_PIXEL_MODE);
-    video_info.depth = ARG(input_depth).AsInt(-1);
-    video_info.chroma_width_subsampling  = vi.IsY8() ? 0 : vi.GetPlaneWidthSubsampling(PLANAR_U);
-    video_info.chroma_height_subsampling = vi.IsY8() ? 0 : vi.GetPlaneHeightSubsampling(PLANAR_U);
+    video_info.color_family = COLOR_FAMILY_YUV;
+    if (native_high_bit_depth)
+    {
+        video_info.pixel_mode = HIGH_BIT_DEPTH_INTERLEAVED;
+        video_info.depth = input_bits;
+    } else {
+        video_info.pixel_mode = (PIXEL_MODE)ARG(input_mode).AsInt(DEFAULT_PIXEL_MODE);
+        video_info.depth = ARG(input_depth).AsInt(-1);
+    }
+    video_info.chroma_width_subsampling  = vi.IsY() ? 0 : vi.GetPlaneWidthSubsampling(PLANAR_U);
+    video_info.chroma_height_subsampling = vi.IsY() ? 0 : vi.GetPlaneHeightSubsampling(PLANAR_U);
     f3kdb_video_info_sanitize(&video_info);
 
+    if (video_info.pixel_mode == HIGH_BIT_DEPTH_FLOAT || params.output_mode == HIGH_BIT_DEPTH_FLOAT)
+    {
+        env->ThrowError("f3kdb: Float samples are not supported in AviSynth.");
+    }
+
+    int dst_pixel_type = vi.pixel_type;
+    if (native_high_bit_depth)
+    {
+        int sample_bits = get_sample_bits_flag(params.output_depth);
+        if (sample_bits == -1)
+        {
+            env->ThrowError("f3kdb: output_depth must be 8, 10, 12, 14 or 16 for high bit depth clips of AviSynth+.");
+        }
+        dst_pixel_type = (vi.pixel_type & ~VideoInfo::CS_Sample_Bits_Mask) | sample_bits;
+    }
+
     video_info.width = vi.width;
-    if (video_info.pixel_mode == HIGH_BIT_DEPTH_INTERLEAVED)
+    if (!native_high_bit_depth && 
+        (video_info.pixel_mode == HIGH_BIT_DEPTH_INTERLEAVED || video_info.pixel_mode == HIGH_BIT_DEPTH_INTERLEAVED_MSB))
     {
         int width_mod = 2 << video_info.chroma_width_subsampling;
         if (video_info.width % width_mod != 0)
@@ -66,7 +146,8 @@ AVSValue __cdecl Create_flash3kyuu_deband(AVSValue args, void* user_data, IScrip
     }
 
     int dst_width = video_info.width;
-    if (params.output_mode == HIGH_BIT_DEPTH_INTERLEAVED)
+    if (!native_high_bit_depth && 
+        (params.output_mode == HIGH_BIT_DEPTH_INTERLEAVED || params.output_mode == HIGH_BIT_DEPTH_INTERLEAVED_MSB))
     {
         dst_width *= 2;
     }
@@ -77,26 +158,46 @@ AVSValue __cdecl Create_flash3kyuu_deband(AVSValue args, void* user_data, IScrip
         dst_height *= 2;
     }
     
-    return new f3kdb_avisynth(child, core, dst_width, dst_height, mt);
+    frame_prefetcher* prefetcher = NULL;
+    if (prefetch > 0)
+    {
+        prefetcher = new frame_prefetcher(child, vi.num_frames, prefetch);
+        if (!prefetcher->init())
+        {
+            delete prefetcher;
+            f3kdb_destroy(core);
+            env->ThrowError("f3kdb: Failed to create prefetch thread.");
+        }
+    }
+    
+    return new f3kdb_avisynth(child, core, dst_width, dst_height, dst_pixel_type, mt, prefetcher);
 }
-f3kdb_avisynth::f3kdb_avisynth(PClip child, f3kdb_core_t* core, int dst_width, int dst_height, bool mt) :
+f3kdb_avisynth::f3kdb_avisynth(PClip child, f3kdb_core_t* core, int dst_width, int dst_height, int dst_pixel_type, bool mt, frame_prefetcher* prefetcher) :
             GenericVideoFilter(child),
+            _core(core),
+            _mt(mt),
             _mt_info(NULL),
-            _core(core)
+            _mt_busy(0),
+            _prefetcher(prefetcher),
+            _prefetch_busy(0)
 {
     vi.width = dst_width;
     vi.height = dst_height;
+    vi.pixel_type = dst_pixel_type;
 }
 
 f3kdb_avisynth::~f3kdb_avisynth()
 {
+    delete _prefetcher;
+    _prefetcher = NULL;
     mt_info_destroy(_mt_info);
     _mt_info = NULL;
     f3kdb_destroy(_core);
     _core = NULL;
 }
 
-void f3kdb_avisynth::process_plane(int n, PVideoFrame src, PVideoFrame dst, unsigned char *dstp, int plane, IScriptEnvironment* env)
+// doesn't use the environment, so it can run on the helper thread
+int f3kdb_avisynth::process_plane(int n, PVideoFrame src, PVideoFrame dst, unsigned char *dstp, int plane)
 {
     int f3kdb_plane;
     switch (plane & 7)
@@ -112,9 +213,13 @@ void f3kdb_avisynth::process_plane(int n, PVideoFrame src, PVideoFrame dst, unsi
         break;
     default:
         assert(false);
-        env->ThrowError("f3kdb: Invalid plane");
+        return F3KDB_ERROR_INVALID_ARGUMENT;
     }
-    int result = f3kdb_process_plane(_core, n, f3kdb_plane, dstp, dst->GetPitch(plane), src->GetReadPtr(plane), src->GetPitch(plane));
+    return f3kdb_process_plane(_core, n, f3kdb_plane, dstp, dst->GetPitch(plane), src->GetReadPtr(plane), src->GetPitch(plane));
+}
+
+static void check_result(int result, IScriptEnvironment* env)
+{
     if (result != F3KDB_SUCCESS)
     {
         env->ThrowError("f3kdb: Unknown error, code = %d", result);
@@ -128,8 +233,13 @@ void f3kdb_avisynth::mt_proc(void)
 
     while (!info->exit)
     {
-        process_plane(info->n, info->src, info->dst, info->dstp_u, PLANAR_U, info->env);
-        process_plane(info->n, info->src, info->dst, info->dstp_v, PLANAR_V, info->env);
+        // errors are thrown by the thread that requested the frame
+        int result = process_plane(info->n, info->src, info->dst, info->dstp_u, PLANAR_U);
+        if (result == F3KDB_SUCCESS)
+        {
+            result = process_plane(info->n, info->src, info->dst, info->dstp_v, PLANAR_V);
+        }
+        info->result = result;
 
         mt_info_reset_pointers(info);
 
@@ -147,25 +257,53 @@ unsigned int __stdcall mt_proc_wrapper(void* filter_instance)
 
 PVideoFrame __stdcall f3kdb_avisynth::GetFrame(int n, IScriptEnvironment* env)
 {
-    PVideoFrame src = child->GetFrame(n, env);
-    // interleaved 16bit output needs extra alignment
-    PVideoFrame dst = env->NewVideoFrame(vi, PLANE_ALIGNMENT * 2);
+    // only one thread at a time may drive the prefetcher
+    if (!_prefetcher || InterlockedCompareExchange(&_prefetch_busy, 1, 0) != 0)
+    {
+        PVideoFrame src = child->GetFrame(n, env);
+        PVideoFrame dst = env->NewVideoFrame(vi);
+        process_frame(n, src, dst, env);
+        return dst;
+    }
 
-    if (vi.IsPlanar() && !vi.IsY8())
+    PVideoFrame dst;
+    try
+    {
+        PVideoFrame src = _prefetcher->get_frame(n, env);
+        // allocate before starting the worker, env must not be used concurrently with it
+        dst = env->NewVideoFrame(vi);
+        _prefetcher->start(n, env);
+        process_frame(n, src, dst, env);
+    } catch (...) {
+        _prefetcher->stop();
+        InterlockedExchange(&_prefetch_busy, 0);
+        throw;
+    }
+    _prefetcher->stop();
+    InterlockedExchange(&_prefetch_busy, 0);
+    return dst;
+}
+
+void f3kdb_avisynth::process_frame(int n, PVideoFrame src, PVideoFrame dst, IScriptEnvironment* env)
+{
+    if (vi.IsPlanar() && !vi.IsY())
     {
-        if (!_mt) 
+        // under AviSynth+ MT, another thread may be using the helper thread,
+        // in that case just process all planes on this thread
+        if (!_mt || InterlockedCompareExchange(&_mt_busy, 1, 0) != 0) 
         {
-            process_plane(n, src, dst, dst->GetWritePtr(PLANAR_Y), PLANAR_Y, env);
-            process_plane(n, src, dst, dst->GetWritePtr(PLANAR_U), PLANAR_U, env);
-            process_plane(n, src, dst, dst->GetWritePtr(PLANAR_V), PLANAR_V, env);
+            check_result(process_plane(n, src, dst, dst->GetWritePtr(PLANAR_Y), PLANAR_Y), env);
+            check_result(process_plane(n, src, dst, dst->GetWritePtr(PLANAR_U), PLANAR_U), env);
+            check_result(process_plane(n, src, dst, dst->GetWritePtr(PLANAR_V), PLANAR_V), env);
         } else {
             bool new_thread = _mt_info == NULL;
             if (new_thread)
             {
                 _mt_info = mt_info_create();
                 if (!_mt_info) {
+                    InterlockedExchange(&_mt_busy, 0);
                     env->ThrowError("f3kdb_avisynth: Failed to allocate mt_info.");
-                    return NULL;
+                    return;
                 }
             }
             // we must get write pointer before copying the frame pointer
@@ -174,7 +312,6 @@ PVideoFrame __stdcall f3kdb_avisynth::GetFrame(int n, IScriptEnvironment* env)
             _mt_info->n = n;
             _mt_info->dstp_u = dst->GetWritePtr(PLANAR_U);
             _mt_info->dstp_v = dst->GetWritePtr(PLANAR_V);
-            _mt_info->env = env;
             _mt_info->dst = dst;
             _mt_info->src = src;
             if (!new_thread)
@@ -188,16 +325,31 @@ PVideoFrame __stdcall f3kdb_avisynth::GetFrame(int n, IScriptEnvironment* env)
                     int err = errno;
                     mt_info_destroy(_mt_info);
                     _mt_info = NULL;
+                    InterlockedExchange(&_mt_busy, 0);
                     env->ThrowError("f3kdb_avisynth: Failed to create worker thread, code = %d.", err);
-                    return NULL;
+                    return;
                 }
             }
-            process_plane(n, src, dst, dstp_y, PLANAR_Y, env);
+            int result = process_plane(n, src, dst, dstp_y, PLANAR_Y);
             WaitForSingleObject(_mt_info->work_complete_event, INFINITE);
+            int result_uv = _mt_info->result;
+            InterlockedExchange(&_mt_busy, 0);
+            check_result(result, env);
+            check_result(result_uv, env);
         }
     } else {
         // Y8
-        process_plane(n, src, dst, dst->GetWritePtr(), PLANAR_Y, env);
+        check_result(process_plane(n, src, dst, dst->GetWritePtr(), PLANAR_Y), env);
     }
-    return dst;
+}
+
+int __stdcall f3kdb_avisynth::SetCacheHints(int cachehints, int frame_range)
+{
+    if (cachehints == CACHE_GET_MTMODE)
+    {
+        // tables of the core are all built on creation and read-only afterwards,
+        // per-call buffers are taken from its thread-safe scratch pool
+        return MT_NICE_FILTER;
+    }
+    return 0;
 }
\ No newline at end of file
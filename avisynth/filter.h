@@ -5,6 +5,16 @@
 #include "flash3kyuu_deband.def.h"
 
 #include "mt_info.h"
+#include "prefetch.h"
+
+// AviSynth+ MT mode query, SetCacheHints(CACHE_GET_MTMODE, 0) is expected to return one of the MT_* values
+enum {
+    CACHE_GET_MTMODE = 200,
+
+    MT_NICE_FILTER = 1,
+    MT_MULTI_INSTANCE = 2,
+    MT_SERIALIZED = 3
+};
 
 AVSValue __cdecl Create_flash3kyuu_deband(AVSValue args, void* user_data, IScriptEnvironment* env);
 extern "C" __declspec(dllexport) const char* __stdcall AvisynthPluginInit2(IScriptEnvironment* env);
@@ -14,13 +24,21 @@ private:
     f3kdb_core_t* _core;
     bool _mt;
     volatile mt_info* _mt_info;
+    // GetFrame may be called concurrently by MT builds of AviSynth 2.6,
+    // only the thread holding this flag may use the helper thread
+    volatile LONG _mt_busy;
+
+    frame_prefetcher* _prefetcher;
+    volatile LONG _prefetch_busy;
 
-    void process_plane(int n, PVideoFrame src, PVideoFrame dst, unsigned char *dstp, int plane, IScriptEnvironment* env);
+    int process_plane(int n, PVideoFrame src, PVideoFrame dst, unsigned char *dstp, int plane);
+    void process_frame(int n, PVideoFrame src, PVideoFrame dst, IScriptEnvironment* env);
 
 public:
     void mt_proc(void);
-    f3kdb_avisynth(PClip child, f3kdb_core_t* core, int dst_width, int dst_height, bool mt);
+    f3kdb_avisynth(PClip child, f3kdb_core_t* core, int dst_width, int dst_height, int dst_pixel_type, bool mt, frame_prefetcher* prefetcher);
     ~f3kdb_avisynth();
 
     PVideoFrame __stdcall GetFrame(int n, IScriptEnvironment* env);
+    int __stdcall SetCacheHints(int cachehints, int frame_range);
 };
\ No newline at end of file
@@ -11,11 +11,11 @@
 #include "avisynth.h"
 #include "../include/f3kdb.h"
 
-static const char* F3KDB_AVS_PARAMS = "c[range]i[Y]i[Cb]i[Cr]i[grainY]i[grainC]i[sample_mode]i[seed]i[blur_first]b[dynamic_grain]b[opt]i[mt]b[dither_algo]i[keep_tv_range]b[input_mode]i[input_depth]i[output_mode]i[output_depth]i[random_algo_ref]i[random_algo_grain]i[random_param_ref]f[random_param_grain]f";
+static const char* F3KDB_AVS_PARAMS = "c[range]i[Y]i[Cb]i[Cr]i[grainY]i[grainC]i[sample_mode]i[seed]i[blur_first]b[dynamic_grain]b[opt]i[mt]b[dither_algo]i[keep_tv_range]b[input_mode]i[input_depth]i[output_mode]i[output_depth]i[random_algo_ref]i[random_algo_grain]i[random_param_ref]f[random_param_grain]f[prefetch]i[memory_budget]i[large_pages]b";
 
 typedef struct _F3KDB_RAW_ARGS
 {
-    AVSValue child, range, Y, Cb, Cr, grainY, grainC, sample_mode, seed, blur_first, dynamic_grain, opt, mt, dither_algo, keep_tv_range, input_mode, input_depth, output_mode, output_depth, random_algo_ref, random_algo_grain, random_param_ref, random_param_grain;
+    AVSValue child, range, Y, Cb, Cr, grainY, grainC, sample_mode, seed, blur_first, dynamic_grain, opt, mt, dither_algo, keep_tv_range, input_mode, input_depth, output_mode, output_depth, random_algo_ref, random_algo_grain, random_param_ref, random_param_grain, prefetch, memory_budget, large_pages;
 } F3KDB_RAW_ARGS;
 
 #define F3KDB_ARG_INDEX(name) (offsetof(F3KDB_RAW_ARGS, name) / sizeof(AVSValue))
@@ -55,5 +55,7 @@ static void f3kdb_params_from_avs(AVSValue args, f3kdb_params_t* f3kdb_params)
     if (F3KDB_ARG(random_algo_grain).Defined()) { f3kdb_params->random_algo_grain = (RANDOM_ALGORITHM)F3KDB_ARG(random_algo_grain).AsInt(); }
     if (F3KDB_ARG(random_param_ref).Defined()) { f3kdb_params->random_param_ref = F3KDB_ARG(random_param_ref).AsFloat(); }
     if (F3KDB_ARG(random_param_grain).Defined()) { f3kdb_params->random_param_grain = F3KDB_ARG(random_param_grain).AsFloat(); }
+    if (F3KDB_ARG(memory_budget).Defined()) { f3kdb_params->memory_budget = F3KDB_ARG(memory_budget).AsInt(); }
+    if (F3KDB_ARG(large_pages).Defined()) { f3kdb_params->large_pages = F3KDB_ARG(large_pages).AsBool(); }
 }
 
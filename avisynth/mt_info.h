@@ -12,7 +12,8 @@ typedef struct _mt_info
 	PVideoFrame dst;
 	unsigned char *dstp_u;
 	unsigned char *dstp_v;
-	IScriptEnvironment* env;
+	// of the U and V planes, F3KDB_SUCCESS or the first error
+	int result;
 
 	bool exit;
 
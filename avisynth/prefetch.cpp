@@ -0,0 +1,145 @@
+#include "stdafx.h"
+
+#include <process.h>
+#include <assert.h>
+
+#include "prefetch.h"
+
+static unsigned int __stdcall prefetch_proc_wrapper(void* prefetcher)
+{
+    assert(prefetcher);
+    ((frame_prefetcher*)prefetcher)->worker_proc();
+    return 0;
+}
+
+frame_prefetcher::frame_prefetcher(PClip child, int num_frames, int depth) :
+    _child(child),
+    _num_frames(num_frames),
+    _depth(depth),
+    _env(NULL),
+    _next_frame(0),
+    _last_frame(-1),
+    _stop(false),
+    _exit(false),
+    _running(false),
+    _thread_handle(NULL),
+    _work_event(NULL),
+    _idle_event(NULL)
+{
+    assert(depth > 0);
+    _frames = new PVideoFrame[depth];
+    _frame_numbers = new int[depth];
+    for (int i = 0; i < depth; i++)
+    {
+        _frame_numbers[i] = -1;
+    }
+}
+
+frame_prefetcher::~frame_prefetcher()
+{
+    stop();
+    if (_thread_handle)
+    {
+        _exit = true;
+        SetEvent(_work_event);
+        WaitForSingleObject(_thread_handle, INFINITE);
+        CloseHandle(_thread_handle);
+    }
+    if (_work_event)
+    {
+        CloseHandle(_work_event);
+    }
+    if (_idle_event)
+    {
+        CloseHandle(_idle_event);
+    }
+    delete [] _frames;
+    delete [] _frame_numbers;
+}
+
+bool frame_prefetcher::init(void)
+{
+    _work_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+    _idle_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (!_work_event || !_idle_event)
+    {
+        return false;
+    }
+    _thread_handle = (HANDLE)_beginthreadex(NULL, 0, prefetch_proc_wrapper, this, 0, NULL);
+    return _thread_handle != NULL;
+}
+
+PVideoFrame frame_prefetcher::get_frame(int n, IScriptEnvironment* env)
+{
+    assert(!_running);
+    int slot = n % _depth;
+    if (_frame_numbers[slot] == n)
+    {
+        PVideoFrame frame = _frames[slot];
+        _frames[slot] = NULL;
+        _frame_numbers[slot] = -1;
+        return frame;
+    }
+    return _child->GetFrame(n, env);
+}
+
+void frame_prefetcher::start(int n, IScriptEnvironment* env)
+{
+    assert(!_running);
+    _env = env;
+    _next_frame = n + 1;
+    _last_frame = n + _depth;
+    if (_last_frame > _num_frames - 1)
+    {
+        _last_frame = _num_frames - 1;
+    }
+    if (_next_frame > _last_frame)
+    {
+        return;
+    }
+    _stop = false;
+    _running = true;
+    SetEvent(_work_event);
+}
+
+void frame_prefetcher::stop(void)
+{
+    if (!_running)
+    {
+        return;
+    }
+    _stop = true;
+    WaitForSingleObject(_idle_event, INFINITE);
+    _running = false;
+}
+
+void frame_prefetcher::worker_proc(void)
+{
+    while (true)
+    {
+        WaitForSingleObject(_work_event, INFINITE);
+        if (_exit)
+        {
+            break;
+        }
+        for (int n = _next_frame; n <= _last_frame && !_stop; n++)
+        {
+            int slot = n % _depth;
+            if (_frame_numbers[slot] == n)
+            {
+                continue;
+            }
+            _frames[slot] = NULL;
+            _frame_numbers[slot] = -1;
+            try
+            {
+                _frames[slot] = _child->GetFrame(n, _env);
+                _frame_numbers[slot] = n;
+            } catch (...) {
+                // leave it to the main thread, it will fetch the frame again and report the error there
+                break;
+            }
+        }
+        SetEvent(_idle_event);
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <Windows.h>
+
+#include "avisynth.h"
+
+// Fetches the frames following the current one from the child clip on a worker thread.
+// The worker only runs between start() and stop(), which the filter calls while it is
+// inside its own GetFrame, so the upstream filter chain is never entered by two threads
+// at the same time even on single-threaded AviSynth.
+class frame_prefetcher
+{
+private:
+    PClip _child;
+    int _num_frames;
+    int _depth;
+
+    // ring of prefetched frames, frame n is stored in slot n % depth
+    PVideoFrame* _frames;
+    int* _frame_numbers;
+
+    IScriptEnvironment* _env;
+    int _next_frame;
+    int _last_frame;
+    volatile bool _stop;
+    volatile bool _exit;
+    bool _running;
+
+    HANDLE _thread_handle;
+    HANDLE _work_event;
+    HANDLE _idle_event;
+
+public:
+    frame_prefetcher(PClip child, int num_frames, int depth);
+    ~frame_prefetcher();
+
+    // returns false if the worker thread can't be created
+    bool init(void);
+
+    // returns frame n, from the prefetched frames if possible
+    // must not be called between start() and stop()
+    PVideoFrame get_frame(int n, IScriptEnvironment* env);
+
+    // starts fetching frames n+1 ~ n+depth in background
+    void start(int n, IScriptEnvironment* env);
+
+    // waits for the frame currently being fetched and stops the worker
+    void stop(void);
+
+    void worker_proc(void);
+};
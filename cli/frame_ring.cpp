@@ -0,0 +1,106 @@
+#include "stdafx.h"
+
+#include <assert.h>
+#include <limits.h>
+
+#include "frame_ring.h"
+
+frame_ring::frame_ring(int slot_count) :
+    _slot_count(slot_count),
+    _end(INT_MAX),
+    _next_to_process(0),
+    _aborted(false)
+{
+    assert(slot_count > 0);
+    _slots = new frame_slot[slot_count];
+    memset(_slots, 0, sizeof(frame_slot) * slot_count);
+    for (int i = 0; i < slot_count; i++)
+    {
+        _slots[i].frame_number = -1;
+    }
+}
+
+frame_ring::~frame_ring()
+{
+    delete [] _slots;
+}
+
+frame_slot* frame_ring::wait(int frame_number, SLOT_STATE state)
+{
+    frame_slot* slot = &_slots[frame_number % _slot_count];
+    frame_slot* ret = NULL;
+
+    std::unique_lock<std::mutex> lock(_lock);
+    while (!_aborted && frame_number < _end)
+    {
+        if (state == SLOT_EMPTY && slot->state == SLOT_EMPTY)
+        {
+            slot->frame_number = frame_number;
+            ret = slot;
+            break;
+        }
+        if (state != SLOT_EMPTY && slot->state == state && slot->frame_number == frame_number)
+        {
+            ret = slot;
+            break;
+        }
+        _changed.wait(lock);
+    }
+    return ret;
+}
+
+frame_slot* frame_ring::take_next_read(void)
+{
+    frame_slot* ret = NULL;
+
+    std::unique_lock<std::mutex> lock(_lock);
+    while (!_aborted && _next_to_process < _end)
+    {
+        frame_slot* slot = &_slots[_next_to_process % _slot_count];
+        if (slot->state == SLOT_READ && slot->frame_number == _next_to_process)
+        {
+            slot->state = SLOT_PROCESSING;
+            _next_to_process++;
+            ret = slot;
+            break;
+        }
+        _changed.wait(lock);
+    }
+    return ret;
+}
+
+void frame_ring::set_state(frame_slot* slot, SLOT_STATE state)
+{
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        slot->state = state;
+    }
+    _changed.notify_all();
+}
+
+void frame_ring::set_end(int frame_count)
+{
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        _end = frame_count;
+    }
+    _changed.notify_all();
+}
+
+bool frame_ring::abort(void)
+{
+    bool ret;
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        ret = !_aborted;
+        _aborted = true;
+    }
+    _changed.notify_all();
+    return ret;
+}
+
+bool frame_ring::is_aborted(void)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+    return _aborted;
+}
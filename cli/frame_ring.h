@@ -0,0 +1,73 @@
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+
+typedef enum _SLOT_STATE
+{
+    SLOT_EMPTY = 0,
+    SLOT_READ,
+    SLOT_PROCESSING,
+    SLOT_PROCESSED,
+} SLOT_STATE;
+
+typedef struct _frame_slot
+{
+    int frame_number;
+    SLOT_STATE state;
+
+    // point into src_buffer, or into the mapped input file
+    const unsigned char* src_planes[3];
+    unsigned char* src_buffer;
+
+    unsigned char* dst_buffer;
+} frame_slot;
+
+// Bounded queue of frames between the pipeline stages.
+// Frame n always goes into slot n % slot_count and moves through 
+// EMPTY -> READ -> PROCESSING -> PROCESSED -> EMPTY, so the reader can't get more than 
+// slot_count frames ahead of the writer, and the writer gets frames in order 
+// no matter how many workers process them.
+class frame_ring
+{
+public:
+    frame_ring(int slot_count);
+    ~frame_ring();
+
+    int get_slot_count() const { return _slot_count; }
+    frame_slot* get_slot(int index) { return &_slots[index]; }
+
+    // Waits until frame_number is in the given state. For SLOT_EMPTY, waits until the slot 
+    // of frame_number is free and assigns it to the frame.
+    // Returns NULL if the stream ends before frame_number or the pipeline is aborted.
+    frame_slot* wait(int frame_number, SLOT_STATE state);
+
+    // for workers, takes the next read frame and marks it SLOT_PROCESSING
+    // returns NULL at the end of the stream or if the pipeline is aborted
+    frame_slot* take_next_read(void);
+
+    void set_state(frame_slot* slot, SLOT_STATE state);
+
+    // called by the reader, there are no frames from frame_count on
+    void set_end(int frame_count);
+
+    // stops all stages, called on errors
+    // returns false if the pipeline has already been aborted
+    bool abort(void);
+    bool is_aborted(void);
+
+private:
+    frame_slot* _slots;
+    int _slot_count;
+
+    // frames at and after _end don't exist, INT_MAX until the reader reaches the end
+    int _end;
+    int _next_to_process;
+    bool _aborted;
+
+    std::mutex _lock;
+    std::condition_variable _changed;
+
+    frame_ring(const frame_ring&);
+    frame_ring operator=(const frame_ring&);
+};
@@ -0,0 +1,654 @@
+#include "stdafx.h"
+
+#include <limits.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "frame_service.h"
+
+// mappings and the frames in them start at page boundaries
+#define SERVICE_PAGE_SIZE 4096
+#define SERVICE_MAX_NAME_LENGTH 200
+
+#ifndef _WIN32
+// milliseconds between checks whether the service is still running while a client waits
+#define SERVICE_ALIVE_CHECK_INTERVAL 100
+#endif
+
+static unsigned __int64 align_size(unsigned __int64 size, unsigned __int64 alignment)
+{
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+static const int PLANES[] = {PLANE_Y, PLANE_CB, PLANE_CR};
+
+static int get_sample_size(int depth)
+{
+    return depth == 8 ? 1 : 2;
+}
+
+static unsigned __int64 get_frame_size(f3kdb_video_info_t video_info, int depth)
+{
+    unsigned __int64 size = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        size += (unsigned __int64)video_info.get_plane_width(PLANES[i]) * video_info.get_plane_height(PLANES[i]) * get_sample_size(depth);
+    }
+    return size;
+}
+
+#ifdef _WIN32
+// index is -1 for objects that aren't per slot
+static void get_object_name(char* buffer, size_t size, const char* name, const char* suffix, int index)
+{
+    if (index < 0)
+    {
+        _snprintf(buffer, size - 1, "Local\\f3kdb_%s%s", name, suffix);
+    } else {
+        _snprintf(buffer, size - 1, "Local\\f3kdb_%s%s_%d", name, suffix, index);
+    }
+    buffer[size - 1] = 0;
+}
+
+static unsigned long get_current_process_id(void)
+{
+    return GetCurrentProcessId();
+}
+
+static bool is_process_alive(unsigned long process_id)
+{
+    HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, process_id);
+    if (!process)
+    {
+        return false;
+    }
+    bool alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+    CloseHandle(process);
+    return alive;
+}
+
+static void sleep_ms(int milliseconds)
+{
+    Sleep(milliseconds);
+}
+#else
+// the semaphores are in the shared memory, so it is the only named object
+static void get_object_name(char* buffer, size_t size, const char* name)
+{
+    snprintf(buffer, size, "/f3kdb_%s", name);
+}
+
+static unsigned long get_current_process_id(void)
+{
+    return (unsigned long)getpid();
+}
+
+static bool is_process_alive(unsigned long process_id)
+{
+    return kill((pid_t)process_id, 0) == 0 || errno == EPERM;
+}
+
+static void sleep_ms(int milliseconds)
+{
+    usleep(milliseconds * 1000);
+}
+
+// Unlike file mappings on Windows, shared memory objects outlive their processes.
+// Returns false if the object is left over from a service that has exited.
+static bool is_object_in_use(const char* object_name)
+{
+    int fd = shm_open(object_name, O_RDONLY, 0);
+    if (fd < 0)
+    {
+        return errno != ENOENT;
+    }
+    // the service may still be starting, only a service known to be gone gives up the name
+    bool in_use = true;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(service_header))
+    {
+        void* view = mmap(NULL, sizeof(service_header), PROT_READ, MAP_SHARED, fd, 0);
+        if (view != MAP_FAILED)
+        {
+            unsigned long process_id = ((const service_header*)view)->service_process_id;
+            in_use = process_id == 0 || is_process_alive(process_id);
+            munmap(view, sizeof(service_header));
+        }
+    }
+    close(fd);
+    return in_use;
+}
+#endif
+
+frame_service::frame_service() :
+    _header(NULL),
+    _slots(NULL),
+    _data(NULL),
+    _slot_count(0),
+    _client_index(-1),
+#ifdef _WIN32
+    _mapping(NULL),
+    _submitted(NULL),
+    _processed_events(NULL),
+    _service_process(NULL)
+#else
+    _mapping_size(0),
+    _unlink_name(NULL)
+#endif
+{
+}
+
+frame_service::~frame_service()
+{
+    if (_client_index >= 0)
+    {
+        // the entry can't be reused while the service may still write to its slots
+        wait_client_idle(_client_index);
+        _InterlockedExchange(&_header->client_process_ids[_client_index], 0);
+    }
+#ifdef _WIN32
+    if (_processed_events)
+    {
+        for (int i = 0; i < _slot_count; i++)
+        {
+            if (_processed_events[i])
+            {
+                CloseHandle(_processed_events[i]);
+            }
+        }
+        delete [] _processed_events;
+    }
+    if (_submitted)
+    {
+        CloseHandle(_submitted);
+    }
+    if (_service_process)
+    {
+        CloseHandle(_service_process);
+    }
+    if (_header)
+    {
+        UnmapViewOfFile(_header);
+    }
+    if (_mapping)
+    {
+        CloseHandle(_mapping);
+    }
+#else
+    // clients that are still connected keep their mapping, new ones can't find the service anymore
+    if (_unlink_name)
+    {
+        shm_unlink(_unlink_name);
+        free(_unlink_name);
+    }
+    if (_header)
+    {
+        munmap(_header, _mapping_size);
+    }
+#endif
+}
+
+#ifdef _WIN32
+const char* frame_service::map_memory(const char* name, unsigned __int64 size)
+{
+    char object_name[MAX_PATH];
+    get_object_name(object_name, sizeof(object_name), name, "", -1);
+    if (size > 0)
+    {
+        _mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, object_name);
+        if (!_mapping)
+        {
+            return "Unable to create shared memory";
+        }
+        if (GetLastError() == ERROR_ALREADY_EXISTS)
+        {
+            return "A service with this name is already running";
+        }
+    } else {
+        _mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, object_name);
+        if (!_mapping)
+        {
+            return "Service is not running";
+        }
+    }
+    _header = (service_header*)MapViewOfFile(_mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if (!_header)
+    {
+        return "Unable to map shared memory";
+    }
+    return NULL;
+}
+
+bool frame_service::open_events(const char* name, bool create, int first_slot, int slot_count)
+{
+    char object_name[MAX_PATH];
+    get_object_name(object_name, sizeof(object_name), name, "_submitted", -1);
+    if (create)
+    {
+        _submitted = CreateSemaphoreA(NULL, 0, LONG_MAX, object_name);
+    } else {
+        _submitted = OpenSemaphoreA(SEMAPHORE_MODIFY_STATE | SYNCHRONIZE, FALSE, object_name);
+    }
+    if (!_submitted)
+    {
+        return false;
+    }
+
+    _processed_events = new HANDLE[_slot_count];
+    memset(_processed_events, 0, sizeof(HANDLE) * _slot_count);
+    for (int i = first_slot; i < first_slot + slot_count; i++)
+    {
+        get_object_name(object_name, sizeof(object_name), name, "_processed", i);
+        if (create)
+        {
+            _processed_events[i] = CreateEventA(NULL, FALSE, FALSE, object_name);
+        } else {
+            _processed_events[i] = OpenEventA(EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE, object_name);
+        }
+        if (!_processed_events[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool frame_service::signal_submitted(void)
+{
+    return !!ReleaseSemaphore(_submitted, 1, NULL);
+}
+
+void frame_service::wait_submitted(void)
+{
+    WaitForSingleObject(_submitted, INFINITE);
+}
+
+void frame_service::signal_processed(int slot_index)
+{
+    SetEvent(_processed_events[slot_index]);
+}
+
+bool frame_service::wait_processed(int slot_index)
+{
+    HANDLE handles[] = {_processed_events[slot_index], _service_process};
+    return WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0;
+}
+
+bool frame_service::open_service_process(void)
+{
+    _service_process = OpenProcess(SYNCHRONIZE, FALSE, _header->service_process_id);
+    return _service_process != NULL;
+}
+
+bool frame_service::is_service_alive(void)
+{
+    return WaitForSingleObject(_service_process, 0) == WAIT_TIMEOUT;
+}
+#else
+const char* frame_service::map_memory(const char* name, unsigned __int64 size)
+{
+    char object_name[SERVICE_MAX_NAME_LENGTH + 16];
+    get_object_name(object_name, sizeof(object_name), name);
+    int fd;
+    if (size > 0)
+    {
+        fd = shm_open(object_name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0 && errno == EEXIST && !is_object_in_use(object_name))
+        {
+            shm_unlink(object_name);
+            fd = shm_open(object_name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        }
+        if (fd < 0)
+        {
+            return errno == EEXIST ? "A service with this name is already running" : "Unable to create shared memory";
+        }
+        _unlink_name = _strdup(object_name);
+        // the new object is zeroed like a new file mapping
+        if (ftruncate(fd, (off_t)size))
+        {
+            close(fd);
+            return "Unable to create shared memory";
+        }
+    } else {
+        fd = shm_open(object_name, O_RDWR, 0);
+        if (fd < 0)
+        {
+            return "Service is not running";
+        }
+        struct stat st;
+        if (fstat(fd, &st) || (size_t)st.st_size < sizeof(service_header))
+        {
+            close(fd);
+            return "Service is not ready, or is a different version";
+        }
+        size = st.st_size;
+    }
+    void* view = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED)
+    {
+        return "Unable to map shared memory";
+    }
+    _header = (service_header*)view;
+    _mapping_size = (size_t)size;
+    return NULL;
+}
+
+// the semaphores are created with the shared memory, clients have nothing to open
+bool frame_service::open_events(const char* name, bool create, int first_slot, int slot_count)
+{
+    if (!create)
+    {
+        return true;
+    }
+    if (sem_init(&_header->submitted, 1, 0))
+    {
+        return false;
+    }
+    for (int i = first_slot; i < first_slot + slot_count; i++)
+    {
+        if (sem_init(&_slots[i].processed, 1, 0))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool frame_service::signal_submitted(void)
+{
+    return sem_post(&_header->submitted) == 0;
+}
+
+void frame_service::wait_submitted(void)
+{
+    while (sem_wait(&_header->submitted) && errno == EINTR)
+    {
+    }
+}
+
+void frame_service::signal_processed(int slot_index)
+{
+    sem_post(&_slots[slot_index].processed);
+}
+
+bool frame_service::wait_processed(int slot_index)
+{
+    // there is no handle to wait for the service process, so it is checked in between
+    for (;;)
+    {
+        timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += SERVICE_ALIVE_CHECK_INTERVAL * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        if (sem_timedwait(&_slots[slot_index].processed, &deadline) == 0)
+        {
+            return true;
+        }
+        if (errno == ETIMEDOUT && !is_service_alive())
+        {
+            return false;
+        }
+    }
+}
+
+bool frame_service::open_service_process(void)
+{
+    return true;
+}
+
+bool frame_service::is_service_alive(void)
+{
+    return is_process_alive(_header->service_process_id);
+}
+#endif
+
+const char* frame_service::create(const char* name, const f3kdb_video_info_t* video_info, int output_depth, int client_count, int slots_per_client)
+{
+    if (strlen(name) > SERVICE_MAX_NAME_LENGTH)
+    {
+        return "Service name is too long";
+    }
+    if (client_count <= 0 || client_count > SERVICE_MAX_CLIENTS || slots_per_client <= 0)
+    {
+        return "Invalid number of clients or slots";
+    }
+    _slot_count = client_count * slots_per_client;
+
+    unsigned __int64 src_frame_size = get_frame_size(*video_info, video_info->depth);
+    unsigned __int64 dst_frame_size = get_frame_size(*video_info, output_depth);
+    unsigned __int64 slots_offset = align_size(sizeof(service_header), PLANE_ALIGNMENT);
+    unsigned __int64 data_offset = align_size(slots_offset + sizeof(service_slot) * _slot_count, SERVICE_PAGE_SIZE);
+    unsigned __int64 dst_offset = align_size(src_frame_size, SERVICE_PAGE_SIZE);
+    unsigned __int64 slot_size = dst_offset + align_size(dst_frame_size, SERVICE_PAGE_SIZE);
+    unsigned __int64 mapping_size = data_offset + slot_size * _slot_count;
+    if (mapping_size > (size_t)-1)
+    {
+        return "Slots don't fit in the address space";
+    }
+
+    const char* error = map_memory(name, mapping_size);
+    if (error)
+    {
+        return error;
+    }
+    _slots = (service_slot*)((unsigned char*)_header + slots_offset);
+    _data = (unsigned char*)_header + data_offset;
+
+    // new mappings are zeroed, so all slots are SERVICE_SLOT_EMPTY and all client entries are free
+    _header->version = SERVICE_VERSION;
+    _header->service_process_id = get_current_process_id();
+    _header->width = video_info->width;
+    _header->height = video_info->height;
+    _header->chroma_width_subsampling = video_info->chroma_width_subsampling;
+    _header->chroma_height_subsampling = video_info->chroma_height_subsampling;
+    _header->depth = video_info->depth;
+    _header->output_depth = output_depth;
+    _header->num_frames = video_info->num_frames;
+    _header->client_count = client_count;
+    _header->slots_per_client = slots_per_client;
+    _header->slots_offset = slots_offset;
+    _header->data_offset = data_offset;
+    _header->slot_size = slot_size;
+    _header->dst_offset = dst_offset;
+
+    if (!open_events(name, true, 0, _slot_count))
+    {
+        return "Unable to create events";
+    }
+    _InterlockedExchange(&_header->magic, SERVICE_MAGIC);
+    return NULL;
+}
+
+int frame_service::take_next_submitted(void)
+{
+    wait_submitted();
+    for (;;)
+    {
+        if (_header->stopping)
+        {
+            // pass the wakeup on to the next worker
+            signal_submitted();
+            return -1;
+        }
+        // The count of _submitted guarantees a submitted slot for every worker that got past
+        // the wait, but another worker may take the one found here first
+        int earliest = -1;
+        for (int i = 0; i < _slot_count; i++)
+        {
+            if (_slots[i].state == SERVICE_SLOT_SUBMITTED &&
+                (earliest < 0 || (long)((unsigned long)_slots[i].sequence - (unsigned long)_slots[earliest].sequence) < 0))
+            {
+                earliest = i;
+            }
+        }
+        if (earliest >= 0 &&
+            _InterlockedCompareExchange(&_slots[earliest].state, SERVICE_SLOT_PROCESSING, SERVICE_SLOT_SUBMITTED) == SERVICE_SLOT_SUBMITTED)
+        {
+            return earliest;
+        }
+    }
+}
+
+int frame_service::process_slot(f3kdb_core_t* core, int slot_index)
+{
+    // written by the client, so it is checked before the core indexes its tables with it
+    int frame_number = _slots[slot_index].frame_number;
+    if (frame_number < 0)
+    {
+        return F3KDB_ERROR_INVALID_ARGUMENT;
+    }
+
+    f3kdb_video_info_t video_info;
+    memset(&video_info, 0, sizeof(video_info));
+    video_info.width = _header->width;
+    video_info.height = _header->height;
+    video_info.chroma_width_subsampling = _header->chroma_width_subsampling;
+    video_info.chroma_height_subsampling = _header->chroma_height_subsampling;
+    int src_sample_size = get_sample_size(_header->depth);
+    int dst_sample_size = get_sample_size(_header->output_depth);
+
+    // planes are packed one after another, see get_frame_size
+    const unsigned char* src = get_src(slot_index);
+    unsigned char* dst = get_dst(slot_index);
+    for (int i = 0; i < 3; i++)
+    {
+        int width = video_info.get_plane_width(PLANES[i]);
+        int height = video_info.get_plane_height(PLANES[i]);
+        int result = f3kdb_process_plane(core, frame_number, PLANES[i], dst, width * dst_sample_size, src, width * src_sample_size);
+        if (result != F3KDB_SUCCESS)
+        {
+            return result;
+        }
+        src += (size_t)width * height * src_sample_size;
+        dst += (size_t)width * height * dst_sample_size;
+    }
+    return F3KDB_SUCCESS;
+}
+
+void frame_service::complete(int slot_index, int result)
+{
+    _slots[slot_index].result = result;
+    _InterlockedExchange(&_slots[slot_index].state, SERVICE_SLOT_PROCESSED);
+    signal_processed(slot_index);
+}
+
+void frame_service::stop(void)
+{
+    _InterlockedExchange(&_header->stopping, 1);
+    signal_submitted();
+    for (int i = 0; i < _slot_count; i++)
+    {
+        signal_processed(i);
+    }
+}
+
+const char* frame_service::connect(const char* name)
+{
+    if (strlen(name) > SERVICE_MAX_NAME_LENGTH)
+    {
+        return "Service name is too long";
+    }
+    const char* error = map_memory(name, 0);
+    if (error)
+    {
+        return error;
+    }
+    if (_header->magic != SERVICE_MAGIC || _header->version != SERVICE_VERSION)
+    {
+        return "Service is not ready, or is a different version";
+    }
+    if (!open_service_process() || !is_service_alive() || _header->stopping)
+    {
+        return "Service is not running";
+    }
+    _slot_count = _header->client_count * _header->slots_per_client;
+    _slots = (service_slot*)((unsigned char*)_header + _header->slots_offset);
+    _data = (unsigned char*)_header + _header->data_offset;
+
+    long process_id = (long)get_current_process_id();
+    for (int i = 0; i < _header->client_count && _client_index < 0; i++)
+    {
+        long owner = _header->client_process_ids[i];
+        if (owner != 0 && is_process_alive((unsigned long)owner))
+        {
+            continue;
+        }
+        // entries of clients that exited without disconnecting are taken over
+        // once the service is done with their slots
+        if (owner != 0)
+        {
+            wait_client_idle(i);
+        }
+        if (_InterlockedCompareExchange(&_header->client_process_ids[i], process_id, owner) == owner)
+        {
+            _client_index = i;
+        }
+    }
+    if (_client_index < 0)
+    {
+        return "All clients of the service are in use";
+    }
+    for (int i = 0; i < _header->slots_per_client; i++)
+    {
+        _InterlockedExchange(&_slots[get_client_slot(i)].state, SERVICE_SLOT_EMPTY);
+    }
+
+    if (!open_events(name, false, get_client_slot(0), _header->slots_per_client))
+    {
+        return "Unable to open events";
+    }
+    return NULL;
+}
+
+int frame_service::process(int slot_index, int frame_number)
+{
+    service_slot* slot = &_slots[slot_index];
+    slot->frame_number = frame_number;
+    slot->sequence = _InterlockedIncrement(&_header->next_sequence);
+    _InterlockedExchange(&slot->state, SERVICE_SLOT_SUBMITTED);
+    if (!signal_submitted())
+    {
+        return -1;
+    }
+
+    for (;;)
+    {
+        if (slot->state == SERVICE_SLOT_PROCESSED)
+        {
+            int result = slot->result;
+            _InterlockedExchange(&slot->state, SERVICE_SLOT_EMPTY);
+            return result;
+        }
+        // the event may still be set from an earlier frame, so check again after waking up
+        if (_header->stopping || !wait_processed(slot_index))
+        {
+            return -1;
+        }
+    }
+}
+
+void frame_service::wait_client_idle(int client_index)
+{
+    int first_slot = client_index * _header->slots_per_client;
+    for (int i = first_slot; i < first_slot + _header->slots_per_client; i++)
+    {
+        while ((_slots[i].state == SERVICE_SLOT_SUBMITTED || _slots[i].state == SERVICE_SLOT_PROCESSING) &&
+            !_header->stopping && is_service_alive())
+        {
+            sleep_ms(10);
+        }
+    }
+}
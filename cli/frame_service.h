@@ -0,0 +1,161 @@
+#pragma once
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <semaphore.h>
+#endif
+
+#include "../include/f3kdb.h"
+
+#define SERVICE_MAGIC 0x62646b33
+#define SERVICE_VERSION 2
+#define SERVICE_MAX_CLIENTS 64
+
+typedef enum _SERVICE_SLOT_STATE
+{
+    SERVICE_SLOT_EMPTY = 0,
+    SERVICE_SLOT_SUBMITTED,
+    SERVICE_SLOT_PROCESSING,
+    SERVICE_SLOT_PROCESSED,
+} SERVICE_SLOT_STATE;
+
+// everything below lives in the shared mapping, so it only holds offsets, no pointers
+
+typedef struct _service_slot
+{
+    volatile long state;
+    // slots are processed in the order they were submitted, over all clients
+    volatile long sequence;
+    int frame_number;
+    int result;
+#ifndef _WIN32
+    // posted when the slot has been processed, see _processed_events for Windows
+    sem_t processed;
+#endif
+} service_slot;
+
+typedef struct _service_header
+{
+    // written last by the service, clients check it before anything else
+    volatile long magic;
+    int version;
+    unsigned long service_process_id;
+    volatile long stopping;
+    volatile long next_sequence;
+#ifndef _WIN32
+    // count is the number of slots waiting for a worker, see _submitted for Windows
+    sem_t submitted;
+#endif
+
+    // format of the frames, clients must send exactly this
+    int width;
+    int height;
+    int chroma_width_subsampling;
+    int chroma_height_subsampling;
+    int depth;
+    int output_depth;
+    // passed to the core of the service, so clients get the output of a standalone run
+    // with --frames set to this
+    int num_frames;
+
+    int client_count;
+    int slots_per_client;
+    // 0 if the entry is free
+    volatile long client_process_ids[SERVICE_MAX_CLIENTS];
+
+    // from the start of the mapping
+    unsigned __int64 slots_offset;
+    unsigned __int64 data_offset;
+    // data of slot n starts at data_offset + n * slot_size, with the source frame first
+    // and the processed frame at dst_offset
+    unsigned __int64 slot_size;
+    unsigned __int64 dst_offset;
+} service_header;
+
+// Frames shared with other processes through named shared memory, so that several
+// encoders on one host use the core, LUTs and worker threads of a single service process.
+// Each connected client owns slots_per_client slots. It puts a source frame into a slot and
+// submits it, the service processes it and writes the result into the same slot.
+// On Windows the memory is a named file mapping and processes are woken by named events,
+// elsewhere it is a POSIX shared memory object with process-shared semaphores inside it.
+class frame_service
+{
+public:
+    frame_service();
+    ~frame_service();
+
+    // Service side. Returns an error message, or NULL on success.
+    const char* create(const char* name, const f3kdb_video_info_t* video_info, int output_depth, int client_count, int slots_per_client);
+
+    // Waits for the earliest submitted slot of any client and marks it SERVICE_SLOT_PROCESSING.
+    // Returns -1 after stop().
+    int take_next_submitted(void);
+
+    // Processes the frame in a slot returned by take_next_submitted with a core created for the
+    // format of the service. Returns the result to pass to complete().
+    int process_slot(f3kdb_core_t* core, int slot_index);
+
+    void complete(int slot_index, int result);
+
+    // wakes all waiting workers and clients
+    void stop(void);
+
+    // Client side, takes a free client entry. Returns an error message, or NULL on success.
+    const char* connect(const char* name);
+
+    const service_header* get_header() const { return _header; }
+
+    // index of the n-th slot of this client
+    int get_client_slot(int n) const { return _client_index * _header->slots_per_client + n; }
+
+    // Submits a slot of this client and waits until it has been processed.
+    // Returns the result of processing, or -1 if the service has stopped.
+    int process(int slot_index, int frame_number);
+
+    unsigned char* get_src(int slot_index) { return _data + _header->slot_size * slot_index; }
+    unsigned char* get_dst(int slot_index) { return get_src(slot_index) + _header->dst_offset; }
+
+private:
+    service_header* _header;
+    service_slot* _slots;
+    unsigned char* _data;
+    int _slot_count;
+
+    // -1 on the service side
+    int _client_index;
+
+#ifdef _WIN32
+    HANDLE _mapping;
+
+    // count is the number of slots waiting for a worker
+    HANDLE _submitted;
+    // one per slot, set when the slot has been processed
+    HANDLE* _processed_events;
+
+    HANDLE _service_process;
+#else
+    size_t _mapping_size;
+    // the service removes the name when it exits, set on the service side
+    char* _unlink_name;
+#endif
+
+    // Platform part, the rest of the class is the same on all systems.
+    // Returns an error message, or NULL on success. Creates the memory if size > 0, opens it otherwise.
+    const char* map_memory(const char* name, unsigned __int64 size);
+    // only the events of the given slots are opened
+    bool open_events(const char* name, bool create, int first_slot, int slot_count);
+    // returns false if the count of waiting slots overflows
+    bool signal_submitted(void);
+    void wait_submitted(void);
+    void signal_processed(int slot_index);
+    // returns false if the service has exited
+    bool wait_processed(int slot_index);
+    bool open_service_process(void);
+    bool is_service_alive(void);
+    // waits until the service is done with all slots of a client
+    void wait_client_idle(int client_index);
+
+    frame_service(const frame_service&);
+    frame_service operator=(const frame_service&);
+};
@@ -0,0 +1,178 @@
+#include "stdafx.h"
+
+#include <fcntl.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "input_file.h"
+
+input_file::input_file() :
+    _stream(NULL),
+    _own_stream(false),
+#ifdef _WIN32
+    _file(INVALID_HANDLE_VALUE),
+    _mapping(NULL),
+#endif
+    _view(NULL),
+    _size(-1),
+    _position(0)
+{
+}
+
+input_file::~input_file()
+{
+#ifdef _WIN32
+    if (_view)
+    {
+        UnmapViewOfFile(_view);
+    }
+    if (_mapping)
+    {
+        CloseHandle(_mapping);
+    }
+    if (_file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(_file);
+    }
+#else
+    if (_view)
+    {
+        munmap((void*)_view, (size_t)_size);
+    }
+#endif
+    if (_own_stream && _stream)
+    {
+        fclose(_stream);
+    }
+}
+
+#ifdef _WIN32
+bool input_file::map(const char* path)
+{
+    _file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (_file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(_file, &size) && size.QuadPart > 0 && (unsigned __int64)size.QuadPart <= (SIZE_T)-1)
+    {
+        _mapping = CreateFileMapping(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (_mapping)
+        {
+            _view = (const unsigned char*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+        }
+        if (_view)
+        {
+            _size = size.QuadPart;
+            return true;
+        }
+    }
+
+    if (_mapping)
+    {
+        CloseHandle(_mapping);
+        _mapping = NULL;
+    }
+    CloseHandle(_file);
+    _file = INVALID_HANDLE_VALUE;
+    return false;
+}
+#else
+bool input_file::map(const char* path)
+{
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && (unsigned __int64)st.st_size <= (size_t)-1)
+    {
+        void* view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view != MAP_FAILED)
+        {
+            // frames are read once, front to back
+            madvise(view, (size_t)st.st_size, MADV_SEQUENTIAL);
+            _view = (const unsigned char*)view;
+            _size = st.st_size;
+        }
+    }
+    // the mapping stays valid after the file is closed
+    close(fd);
+    return _view != NULL;
+}
+#endif
+
+bool input_file::open(const char* path)
+{
+    if (!strcmp(path, "-"))
+    {
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        _stream = stdin;
+        return true;
+    }
+
+    if (map(path))
+    {
+        return true;
+    }
+
+    // not a regular file (e.g. a named pipe), or it doesn't fit in the address space
+    _stream = fopen(path, "rb");
+    _own_stream = true;
+    return _stream != NULL;
+}
+
+bool input_file::read_line(char* line, size_t size)
+{
+    size_t length = 0;
+    while (true)
+    {
+        int c;
+        if (_view)
+        {
+            c = _position < _size ? _view[_position++] : EOF;
+        } else {
+            c = fgetc(_stream);
+        }
+        if (c == EOF)
+        {
+            return false;
+        }
+        if (c == '\n')
+        {
+            break;
+        }
+        if (length + 1 >= size)
+        {
+            return false;
+        }
+        line[length++] = (char)c;
+    }
+    line[length] = 0;
+    return true;
+}
+
+const unsigned char* input_file::read(size_t size, unsigned char* buffer)
+{
+    if (_view)
+    {
+        if (_size - _position < (__int64)size)
+        {
+            return NULL;
+        }
+        const unsigned char* ret = _view + _position;
+        _position += size;
+        return ret;
+    }
+    return fread(buffer, 1, size, _stream) == size ? buffer : NULL;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// Source of the input stream. Regular files are mapped into memory, so their frames
+// are processed in place without being copied, everything else (stdin, or files that 
+// are too big for the address space) is read into the caller's buffers.
+class input_file
+{
+public:
+    input_file();
+    ~input_file();
+
+    // "-" is stdin
+    bool open(const char* path);
+
+    bool is_mapped() const { return _view != NULL; }
+
+    // reads up to the next line break, which is not stored
+    // returns false at the end of input or if the line doesn't fit
+    bool read_line(char* line, size_t size);
+
+    // returns the next size bytes, read into buffer unless the file is mapped
+    // returns NULL if the input ends before
+    const unsigned char* read(size_t size, unsigned char* buffer);
+
+private:
+    // maps a regular file, returns false for anything else
+    bool map(const char* path);
+
+    FILE* _stream;
+    bool _own_stream;
+
+#ifdef _WIN32
+    HANDLE _file;
+    HANDLE _mapping;
+#endif
+    const unsigned char* _view;
+    __int64 _size;
+    __int64 _position;
+
+    input_file(const input_file&);
+    input_file operator=(const input_file&);
+};
@@ -0,0 +1,745 @@
+#include "stdafx.h"
+
+#include <fcntl.h>
+#include <malloc.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <signal.h>
+#endif
+
+#include <chrono>
+#include <thread>
+
+#include "../include/f3kdb.h"
+
+#include "input_file.h"
+#include "y4m.h"
+#include "frame_ring.h"
+#include "frame_service.h"
+
+// number of frames passed to the core unless --frames is given, it only affects the random seed 
+// and the cycle of dynamic grain. It doesn't depend on the input, so the output of a file is the 
+// same whether it is mapped or piped.
+#define DEFAULT_FRAME_COUNT 10000
+
+#define DEFAULT_SERVICE_CLIENTS 4
+#define DEFAULT_SERVICE_SLOTS 4
+
+static const int PLANES[] = {PLANE_Y, PLANE_CB, PLANE_CR};
+
+typedef struct _cli_options
+{
+    const char* input_path;
+    const char* output_path;
+    const char* param_string;
+
+    bool raw_input;
+    int raw_width;
+    int raw_height;
+    int raw_chroma_width_subsampling;
+    int raw_chroma_height_subsampling;
+    int raw_depth;
+
+    bool raw_output;
+    bool v210_output;
+    int frame_count;
+    int threads;
+    int queue_length;
+
+    const char* serve_name;
+    const char* connect_name;
+    int client_count;
+} cli_options;
+
+typedef struct _pipeline
+{
+    f3kdb_core_t* core;
+    input_file* input;
+    frame_ring* ring;
+    // frames are processed by this service instead of core if set
+    frame_service* service;
+    bool y4m_input;
+
+    int plane_widths[3];
+    int plane_heights[3];
+    int src_bytes_per_sample;
+    int dst_bytes_per_sample;
+    size_t src_plane_offsets[3];
+    size_t dst_plane_offsets[3];
+    size_t src_frame_size;
+    size_t dst_frame_size;
+    // 0 unless the output is v210
+    int v210_pitch;
+
+    // set by the first stage that fails
+    char error[256];
+} pipeline;
+
+static void print_usage(void)
+{
+    fprintf(stderr, 
+        "Usage: f3kdb [options] [input] [output]\n"
+        "\n"
+        "Debands a Y4M or raw planar YUV stream. Input and output default to \"-\",\n"
+        "which is stdin / stdout.\n"
+        "\n"
+        "Options:\n"
+        "  --params <string>    Filter parameters, e.g. \"range=15/Y=64/output_depth=10\",\n"
+        "                       see flash3kyuu_deband.txt\n"
+        "  --raw <width>x<height>\n"
+        "                       Input is raw planar YUV instead of Y4M\n"
+        "  --csp <420|422|444>  Chroma subsampling of raw input, default 420\n"
+        "  --depth <8~16>       Bit depth of raw input, default 8. Samples of more than\n"
+        "                       8 bits are 16-bit little endian\n"
+        "  --output-raw         Write raw planar YUV instead of Y4M\n"
+        "  --output-v210        Write raw v210 (10-bit 4:2:2, rows padded to 128 bytes),\n"
+        "                       input must be 4:2:2. Implies output_depth=10\n"
+        "  --frames <n>         Number of frames passed to the filter, default 10000.\n"
+        "                       Affects the random seed, set it to the length of the\n"
+        "                       clip to get the same output as the plugins\n"
+        "  --threads <n>        Number of processing threads, default is the number of\n"
+        "                       logical processors\n"
+        "  --queue <n>          Maximum number of frames in flight, default 2x threads\n"
+        "\n"
+        "  --serve <name>       Run as a service that processes frames of other f3kdb\n"
+        "                       processes started with --connect, until Ctrl+C. The frame\n"
+        "                       format is set by --raw, --csp and --depth\n"
+        "  --clients <n>        Number of clients of --serve, default 4. --queue sets\n"
+        "                       the number of frames in flight per client, default 4\n"
+        "  --connect <name>     Send frames to the service of that name. Filter\n"
+        "                       parameters, frame count, threads and queue are the\n"
+        "                       service's\n");
+}
+
+static bool parse_options(int argc, char** argv, cli_options* options)
+{
+    memset(options, 0, sizeof(cli_options));
+    options->input_path = "-";
+    options->output_path = "-";
+    options->param_string = "";
+    options->raw_chroma_width_subsampling = 1;
+    options->raw_chroma_height_subsampling = 1;
+    options->raw_depth = 8;
+    options->threads = (int)std::thread::hardware_concurrency();
+
+    int positional = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (arg[0] != '-' || !strcmp(arg, "-"))
+        {
+            switch (positional++)
+            {
+            case 0:
+                options->input_path = arg;
+                break;
+            case 1:
+                options->output_path = arg;
+                break;
+            default:
+                return false;
+            }
+            continue;
+        }
+        if (!strcmp(arg, "--output-raw"))
+        {
+            options->raw_output = true;
+            continue;
+        }
+        if (!strcmp(arg, "--output-v210"))
+        {
+            options->raw_output = true;
+            options->v210_output = true;
+            continue;
+        }
+        if (!value)
+        {
+            return false;
+        }
+        i++;
+        if (!strcmp(arg, "--params"))
+        {
+            options->param_string = value;
+        } else if (!strcmp(arg, "--raw")) {
+            options->raw_input = true;
+            if (sscanf(value, "%dx%d", &options->raw_width, &options->raw_height) != 2)
+            {
+                return false;
+            }
+        } else if (!strcmp(arg, "--csp")) {
+            if (!strcmp(value, "420"))
+            {
+                options->raw_chroma_width_subsampling = 1;
+                options->raw_chroma_height_subsampling = 1;
+            } else if (!strcmp(value, "422")) {
+                options->raw_chroma_width_subsampling = 1;
+                options->raw_chroma_height_subsampling = 0;
+            } else if (!strcmp(value, "444")) {
+                options->raw_chroma_width_subsampling = 0;
+                options->raw_chroma_height_subsampling = 0;
+            } else {
+                return false;
+            }
+        } else if (!strcmp(arg, "--depth")) {
+            options->raw_depth = atoi(value);
+        } else if (!strcmp(arg, "--frames")) {
+            options->frame_count = atoi(value);
+        } else if (!strcmp(arg, "--threads")) {
+            options->threads = atoi(value);
+        } else if (!strcmp(arg, "--queue")) {
+            options->queue_length = atoi(value);
+        } else if (!strcmp(arg, "--serve")) {
+            options->serve_name = value;
+        } else if (!strcmp(arg, "--connect")) {
+            options->connect_name = value;
+        } else if (!strcmp(arg, "--clients")) {
+            options->client_count = atoi(value);
+        } else {
+            return false;
+        }
+    }
+
+    if (options->threads <= 0)
+    {
+        options->threads = 1;
+    }
+    if (options->serve_name)
+    {
+        if (options->client_count <= 0)
+        {
+            options->client_count = DEFAULT_SERVICE_CLIENTS;
+        }
+        if (options->queue_length <= 0)
+        {
+            options->queue_length = DEFAULT_SERVICE_SLOTS;
+        }
+    }
+    if (options->queue_length <= 0)
+    {
+        options->queue_length = options->threads * 2;
+    }
+    // the service always writes planar frames
+    if (options->v210_output && (options->serve_name || options->connect_name))
+    {
+        return false;
+    }
+    return !(options->serve_name && options->connect_name);
+}
+
+static void fail(pipeline* p, const char* message)
+{
+    if (p->ring->abort())
+    {
+        // only read after all other stages have stopped
+        _snprintf(p->error, sizeof(p->error) - 1, "%s", message);
+    }
+}
+
+static void reader_proc(pipeline* p)
+{
+    char line[Y4M_MAX_LINE];
+
+    for (int frame_number = 0; ; frame_number++)
+    {
+        frame_slot* slot = p->ring->wait(frame_number, SLOT_EMPTY);
+        if (!slot)
+        {
+            break;
+        }
+        if (p->y4m_input)
+        {
+            if (!p->input->read_line(line, sizeof(line)))
+            {
+                p->ring->set_end(frame_number);
+                break;
+            }
+            if (strncmp(line, "FRAME", 5))
+            {
+                fail(p, "Invalid frame header in Y4M input");
+                break;
+            }
+        }
+        const unsigned char* frame = p->input->read(p->src_frame_size, slot->src_buffer);
+        if (!frame)
+        {
+            if (p->y4m_input)
+            {
+                fail(p, "Input ends in the middle of a frame");
+            } else {
+                p->ring->set_end(frame_number);
+            }
+            break;
+        }
+        if (p->service && frame != slot->src_buffer)
+        {
+            // the service can only read frames in its shared memory
+            memcpy(slot->src_buffer, frame, p->src_frame_size);
+            frame = slot->src_buffer;
+        }
+        for (int i = 0; i < 3; i++)
+        {
+            slot->src_planes[i] = frame + p->src_plane_offsets[i];
+        }
+        p->ring->set_state(slot, SLOT_READ);
+    }
+}
+
+static void worker_proc(pipeline* p)
+{
+    int src_pitches[3];
+    for (int i = 0; i < 3; i++)
+    {
+        src_pitches[i] = p->plane_widths[i] * p->src_bytes_per_sample;
+    }
+
+    frame_slot* slot;
+    while ((slot = p->ring->take_next_read()) != NULL)
+    {
+        // all planes are packed together, or processed by the service at once
+        int plane_count = p->v210_pitch || p->service ? 1 : 3;
+        for (int i = 0; i < plane_count; i++)
+        {
+            int result;
+            if (p->service)
+            {
+                // slots of the ring are the slots of this client in the service
+                result = p->service->process(p->service->get_client_slot((int)(slot - p->ring->get_slot(0))), slot->frame_number);
+                if (result < 0)
+                {
+                    fail(p, "Service has stopped");
+                    return;
+                }
+            } else if (p->v210_pitch) {
+                result = f3kdb_process_frame_v210(p->core, slot->frame_number, slot->dst_buffer, p->v210_pitch, slot->src_planes, src_pitches);
+            } else {
+                result = f3kdb_process_plane(p->core, slot->frame_number, PLANES[i], 
+                    slot->dst_buffer + p->dst_plane_offsets[i], p->plane_widths[i] * p->dst_bytes_per_sample, 
+                    slot->src_planes[i], src_pitches[i]);
+            }
+            if (result != F3KDB_SUCCESS)
+            {
+                char message[64];
+                _snprintf(message, sizeof(message) - 1, "Processing failed, code = %d", result);
+                message[sizeof(message) - 1] = 0;
+                fail(p, message);
+                return;
+            }
+        }
+        p->ring->set_state(slot, SLOT_PROCESSED);
+    }
+}
+
+static size_t get_frame_layout(const f3kdb_video_info_t* video_info, int bytes_per_sample, int* widths, int* heights, size_t* offsets)
+{
+    f3kdb_video_info_t vi = *video_info;
+    size_t size = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        widths[i] = vi.get_plane_width(PLANES[i]);
+        heights[i] = vi.get_plane_height(PLANES[i]);
+        offsets[i] = size;
+        size += (size_t)widths[i] * heights[i] * bytes_per_sample;
+    }
+    return size;
+}
+
+static bool check_frame_size(const f3kdb_video_info_t* video_info)
+{
+    if ((video_info->width & ((1 << video_info->chroma_width_subsampling) - 1)) ||
+        (video_info->height & ((1 << video_info->chroma_height_subsampling) - 1)))
+    {
+        fprintf(stderr, "f3kdb: Frame size must be a multiple of chroma subsampling\n");
+        return false;
+    }
+    return true;
+}
+
+// returns NULL after printing the error
+static f3kdb_core_t* create_core(const cli_options* options, const f3kdb_video_info_t* video_info, int* output_depth)
+{
+    f3kdb_params_t params;
+    f3kdb_params_init_defaults(&params);
+    int result;
+    if (options->param_string[0])
+    {
+        result = f3kdb_params_fill_by_string(&params, options->param_string);
+        if (result != F3KDB_SUCCESS)
+        {
+            fprintf(stderr, "f3kdb: Invalid parameter string, code = %d\n", result);
+            return NULL;
+        }
+    }
+    if (options->v210_output)
+    {
+        if (video_info->chroma_width_subsampling != 1 || video_info->chroma_height_subsampling != 0)
+        {
+            fprintf(stderr, "f3kdb: v210 output needs 4:2:2 input\n");
+            return NULL;
+        }
+        params.output_depth = 10;
+    }
+    // same as the VapourSynth plugin, high bit-depth output is always 16-bit little endian
+    params.output_mode = params.output_depth <= 8 ? LOW_BIT_DEPTH : HIGH_BIT_DEPTH_INTERLEAVED;
+    f3kdb_params_sanitize(&params);
+
+    f3kdb_core_t* core;
+    char error_msg[1024];
+    memset(error_msg, 0, sizeof(error_msg));
+    result = f3kdb_create(video_info, &params, &core, error_msg, sizeof(error_msg) - 1);
+    if (result != F3KDB_SUCCESS)
+    {
+        fprintf(stderr, "f3kdb: Core initialization failed, code = %d. %s\n", result, error_msg);
+        return NULL;
+    }
+    *output_depth = params.output_depth;
+    return core;
+}
+
+static void service_worker_proc(pipeline* p)
+{
+    int slot_index;
+    while ((slot_index = p->service->take_next_submitted()) >= 0)
+    {
+        // failures are reported to the client of the frame, the service keeps running
+        p->service->complete(slot_index, p->service->process_slot(p->core, slot_index));
+    }
+}
+
+#ifdef _WIN32
+static HANDLE stop_event;
+
+static BOOL WINAPI console_ctrl_handler(DWORD ctrl_type)
+{
+    SetEvent(stop_event);
+    return TRUE;
+}
+
+static void init_stop_signal(void)
+{
+    stop_event = CreateEvent(NULL, TRUE, FALSE, NULL);
+    SetConsoleCtrlHandler(console_ctrl_handler, TRUE);
+}
+
+static void wait_stop_signal(void)
+{
+    WaitForSingleObject(stop_event, INFINITE);
+    CloseHandle(stop_event);
+}
+#else
+static sigset_t stop_signals;
+
+// called before any thread is started, so that they all inherit the blocked signals
+// and only wait_stop_signal gets them
+static void init_stop_signal(void)
+{
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    sigaddset(&stop_signals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, NULL);
+}
+
+static void wait_stop_signal(void)
+{
+    int signal_number;
+    sigwait(&stop_signals, &signal_number);
+}
+#endif
+
+// All clients share the core (and so its LUTs) and the worker threads of the service
+static int run_service(const cli_options* options)
+{
+    if (!options->raw_input)
+    {
+        fprintf(stderr, "f3kdb: Set the frame format of the service with --raw, --csp and --depth\n");
+        return 1;
+    }
+    f3kdb_video_info_t video_info;
+    memset(&video_info, 0, sizeof(video_info));
+    video_info.width = options->raw_width;
+    video_info.height = options->raw_height;
+    video_info.chroma_width_subsampling = options->raw_chroma_width_subsampling;
+    video_info.chroma_height_subsampling = options->raw_chroma_height_subsampling;
+    video_info.depth = options->raw_depth;
+    video_info.pixel_mode = video_info.depth == 8 ? LOW_BIT_DEPTH : HIGH_BIT_DEPTH_INTERLEAVED;
+    video_info.num_frames = options->frame_count > 0 ? options->frame_count : DEFAULT_FRAME_COUNT;
+    if (!check_frame_size(&video_info))
+    {
+        return 1;
+    }
+
+    pipeline p;
+    memset(&p, 0, sizeof(p));
+    int output_depth;
+    p.core = create_core(options, &video_info, &output_depth);
+    if (!p.core)
+    {
+        return 1;
+    }
+
+    frame_service service;
+    const char* error = service.create(options->serve_name, &video_info, output_depth, options->client_count, options->queue_length);
+    if (error)
+    {
+        fprintf(stderr, "f3kdb: %s\n", error);
+        f3kdb_destroy(p.core);
+        return 1;
+    }
+    p.service = &service;
+
+    init_stop_signal();
+
+    std::thread* threads = new std::thread[options->threads];
+    for (int i = 0; i < options->threads; i++)
+    {
+        threads[i] = std::thread(service_worker_proc, &p);
+    }
+    fprintf(stderr, "f3kdb: Serving \"%s\" for %d clients with %d frames, press Ctrl+C to stop\n", options->serve_name, options->client_count, video_info.num_frames);
+
+    wait_stop_signal();
+    service.stop();
+    for (int i = 0; i < options->threads; i++)
+    {
+        threads[i].join();
+    }
+    delete [] threads;
+    f3kdb_destroy(p.core);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    cli_options options;
+    if (!parse_options(argc, argv, &options))
+    {
+        print_usage();
+        return 1;
+    }
+    if (options.serve_name)
+    {
+        return run_service(&options);
+    }
+
+    input_file input;
+    if (!input.open(options.input_path))
+    {
+        fprintf(stderr, "f3kdb: Unable to open input %s\n", options.input_path);
+        return 1;
+    }
+
+    f3kdb_video_info_t video_info;
+    memset(&video_info, 0, sizeof(video_info));
+    y4m_header header;
+    if (options.raw_input)
+    {
+        video_info.width = options.raw_width;
+        video_info.height = options.raw_height;
+        video_info.chroma_width_subsampling = options.raw_chroma_width_subsampling;
+        video_info.chroma_height_subsampling = options.raw_chroma_height_subsampling;
+        video_info.depth = options.raw_depth;
+    } else {
+        char line[Y4M_MAX_LINE];
+        const char* error = "Unable to read Y4M stream header";
+        if (input.read_line(line, sizeof(line)))
+        {
+            error = y4m_parse_header(line, &header);
+        }
+        if (error)
+        {
+            fprintf(stderr, "f3kdb: %s\n", error);
+            return 1;
+        }
+        video_info.width = header.width;
+        video_info.height = header.height;
+        video_info.chroma_width_subsampling = header.chroma_width_subsampling;
+        video_info.chroma_height_subsampling = header.chroma_height_subsampling;
+        video_info.depth = header.depth;
+    }
+    video_info.pixel_mode = video_info.depth == 8 ? LOW_BIT_DEPTH : HIGH_BIT_DEPTH_INTERLEAVED;
+    if (!check_frame_size(&video_info))
+    {
+        return 1;
+    }
+
+    pipeline p;
+    memset(&p, 0, sizeof(p));
+    p.input = &input;
+    p.y4m_input = !options.raw_input;
+    p.src_bytes_per_sample = video_info.depth == 8 ? 1 : 2;
+    p.src_frame_size = get_frame_layout(&video_info, p.src_bytes_per_sample, p.plane_widths, p.plane_heights, p.src_plane_offsets);
+
+    video_info.num_frames = options.frame_count > 0 ? options.frame_count : DEFAULT_FRAME_COUNT;
+
+    frame_service service;
+    int output_depth;
+    if (options.connect_name)
+    {
+        const char* error = service.connect(options.connect_name);
+        const service_header* header = service.get_header();
+        if (!error && (header->width != video_info.width || header->height != video_info.height ||
+            header->chroma_width_subsampling != video_info.chroma_width_subsampling ||
+            header->chroma_height_subsampling != video_info.chroma_height_subsampling ||
+            header->depth != video_info.depth))
+        {
+            error = "Input format doesn't match the format of the service";
+        }
+        if (error)
+        {
+            fprintf(stderr, "f3kdb: %s\n", error);
+            return 1;
+        }
+        // the frame count seeds the core, a different one would silently change the output
+        if (options.frame_count > 0 && options.frame_count != header->num_frames)
+        {
+            fprintf(stderr, "f3kdb: --frames doesn't match the service, which uses %d frames\n", header->num_frames);
+            return 1;
+        }
+        output_depth = header->output_depth;
+        p.service = &service;
+        // one worker waits for each slot of this client
+        options.threads = options.queue_length = header->slots_per_client;
+    } else {
+        p.core = create_core(&options, &video_info, &output_depth);
+        if (!p.core)
+        {
+            return 1;
+        }
+    }
+
+    int dst_widths[3], dst_heights[3];
+    p.dst_bytes_per_sample = output_depth == 8 ? 1 : 2;
+    p.dst_frame_size = get_frame_layout(&video_info, p.dst_bytes_per_sample, dst_widths, dst_heights, p.dst_plane_offsets);
+    if (options.v210_output)
+    {
+        p.v210_pitch = (video_info.width + 47) / 48 * 128;
+        p.dst_frame_size = (size_t)p.v210_pitch * video_info.height;
+    }
+
+    FILE* output = stdout;
+    if (strcmp(options.output_path, "-"))
+    {
+        output = fopen(options.output_path, "wb");
+        if (!output)
+        {
+            fprintf(stderr, "f3kdb: Unable to open output %s\n", options.output_path);
+            f3kdb_destroy(p.core);
+            return 1;
+        }
+    } else {
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    }
+
+    frame_ring ring(options.queue_length);
+    p.ring = &ring;
+    bool out_of_memory = false;
+    for (int i = 0; i < ring.get_slot_count(); i++)
+    {
+        frame_slot* slot = ring.get_slot(i);
+        if (p.service)
+        {
+            // frames are read into and written from the shared memory of the service
+            slot->src_buffer = service.get_src(service.get_client_slot(i));
+            slot->dst_buffer = service.get_dst(service.get_client_slot(i));
+            continue;
+        }
+        slot->dst_buffer = (unsigned char*)_aligned_malloc(p.dst_frame_size, PLANE_ALIGNMENT);
+        if (slot->dst_buffer && p.v210_pitch)
+        {
+            // padding at the end of v210 rows is never written by the core
+            memset(slot->dst_buffer, 0, p.dst_frame_size);
+        }
+        if (!input.is_mapped())
+        {
+            slot->src_buffer = (unsigned char*)_aligned_malloc(p.src_frame_size, PLANE_ALIGNMENT);
+            out_of_memory |= !slot->src_buffer;
+        }
+        out_of_memory |= !slot->dst_buffer;
+    }
+
+    int thread_count = 0;
+    std::thread* threads = new std::thread[options.threads + 1];
+    if (out_of_memory)
+    {
+        fail(&p, "Out of memory");
+    } else {
+        threads[thread_count++] = std::thread(reader_proc, &p);
+        for (int i = 0; i < options.threads; i++)
+        {
+            threads[thread_count++] = std::thread(worker_proc, &p);
+        }
+    }
+
+    // frames are written on this thread, in order
+    std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+    if (!options.raw_output && !ring.is_aborted())
+    {
+        char line[Y4M_MAX_LINE];
+        if (options.raw_input)
+        {
+            memset(&header, 0, sizeof(header));
+            header.width = video_info.width;
+            header.height = video_info.height;
+            header.chroma_width_subsampling = video_info.chroma_width_subsampling;
+            header.chroma_height_subsampling = video_info.chroma_height_subsampling;
+            // raw input doesn't carry a frame rate
+            strcpy(header.other_tags, " F25:1");
+        }
+        y4m_format_header(&header, output_depth, line, sizeof(line));
+        if (fprintf(output, "%s\n", line) < 0)
+        {
+            fail(&p, "Unable to write output");
+        }
+    }
+    int frames_written = 0;
+    for (; ; frames_written++)
+    {
+        frame_slot* slot = ring.wait(frames_written, SLOT_PROCESSED);
+        if (!slot)
+        {
+            break;
+        }
+        if ((!options.raw_output && fputs("FRAME\n", output) < 0) ||
+            fwrite(slot->dst_buffer, 1, p.dst_frame_size, output) != p.dst_frame_size)
+        {
+            fail(&p, "Unable to write output");
+            break;
+        }
+        ring.set_state(slot, SLOT_EMPTY);
+    }
+    if (fflush(output))
+    {
+        fail(&p, "Unable to write output");
+    }
+
+    for (int i = 0; i < thread_count; i++)
+    {
+        threads[i].join();
+    }
+    delete [] threads;
+
+    for (int i = 0; i < ring.get_slot_count() && !p.service; i++)
+    {
+        _aligned_free(ring.get_slot(i)->src_buffer);
+        _aligned_free(ring.get_slot(i)->dst_buffer);
+    }
+    f3kdb_destroy(p.core);
+    if (output != stdout)
+    {
+        fclose(output);
+    }
+
+    if (ring.is_aborted())
+    {
+        fprintf(stderr, "f3kdb: %s\n", p.error);
+        return 1;
+    }
+
+    long long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count();
+    fprintf(stderr, "f3kdb: %d frames, %.2f fps\n", frames_written, elapsed > 0 ? frames_written * 1000.0 / elapsed : 0.0);
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include "stdafx.h"
+
+#include "y4m.h"
+
+static const char Y4M_SIGNATURE[] = "YUV4MPEG2";
+
+static const char* parse_colorspace(const char* value, y4m_header* header)
+{
+    if (!strncmp(value, "420", 3))
+    {
+        header->chroma_width_subsampling = 1;
+        header->chroma_height_subsampling = 1;
+    } else if (!strncmp(value, "422", 3)) {
+        header->chroma_width_subsampling = 1;
+        header->chroma_height_subsampling = 0;
+    } else if (!strncmp(value, "444", 3)) {
+        header->chroma_width_subsampling = 0;
+        header->chroma_height_subsampling = 0;
+    } else {
+        return "Unsupported colorspace, only 4:2:0, 4:2:2 and 4:4:4 are supported";
+    }
+
+    // 8-bit colorspaces may have chroma siting after the subsampling, e.g. 420jpeg / 420mpeg2
+    const char* suffix = value + 3;
+    header->depth = 8;
+    if (suffix[0] == 'p' && suffix[1] >= '0' && suffix[1] <= '9')
+    {
+        header->depth = atoi(suffix + 1);
+        if (header->depth < 8 || header->depth > 16)
+        {
+            return "Unsupported bit depth, only 8 ~ 16 bits are supported";
+        }
+    }
+
+    if (strlen(value) >= sizeof(header->colorspace))
+    {
+        return "Invalid colorspace";
+    }
+    strcpy(header->colorspace, value);
+    return NULL;
+}
+
+const char* y4m_parse_header(const char* line, y4m_header* header)
+{
+    memset(header, 0, sizeof(y4m_header));
+    strcpy(header->colorspace, "420jpeg");
+    header->chroma_width_subsampling = 1;
+    header->chroma_height_subsampling = 1;
+    header->depth = 8;
+
+    if (strncmp(line, Y4M_SIGNATURE, sizeof(Y4M_SIGNATURE) - 1))
+    {
+        return "Not a YUV4MPEG2 stream";
+    }
+
+    const char* cur = line + sizeof(Y4M_SIGNATURE) - 1;
+    while (*cur)
+    {
+        while (*cur == ' ')
+        {
+            cur++;
+        }
+        if (!*cur)
+        {
+            break;
+        }
+        const char* tag_end = strchr(cur, ' ');
+        if (!tag_end)
+        {
+            tag_end = cur + strlen(cur);
+        }
+
+        char tag[Y4M_MAX_LINE];
+        size_t tag_length = tag_end - cur;
+        if (tag_length >= sizeof(tag))
+        {
+            return "Invalid stream header";
+        }
+        memcpy(tag, cur, tag_length);
+        tag[tag_length] = 0;
+
+        switch (tag[0])
+        {
+        case 'W':
+            header->width = atoi(tag + 1);
+            break;
+        case 'H':
+            header->height = atoi(tag + 1);
+            break;
+        case 'C':
+            {
+                const char* error = parse_colorspace(tag + 1, header);
+                if (error)
+                {
+                    return error;
+                }
+            }
+            break;
+        default:
+            // describes the input format, written again for the output format by y4m_format_header
+            if (!strncmp(tag, "XYSCSS=", 7))
+            {
+                break;
+            }
+            if (strlen(header->other_tags) + tag_length + 2 > sizeof(header->other_tags))
+            {
+                return "Invalid stream header";
+            }
+            strcat(header->other_tags, " ");
+            strcat(header->other_tags, tag);
+            break;
+        }
+        cur = tag_end;
+    }
+
+    if (header->width <= 0 || header->height <= 0)
+    {
+        return "Invalid frame size";
+    }
+    if ((header->width & ((1 << header->chroma_width_subsampling) - 1)) ||
+        (header->height & ((1 << header->chroma_height_subsampling) - 1)))
+    {
+        return "Frame size must be a multiple of chroma subsampling";
+    }
+    return NULL;
+}
+
+void y4m_format_header(const y4m_header* header, int depth, char* line, size_t size)
+{
+    char colorspace[32];
+    if (depth == header->depth)
+    {
+        strcpy(colorspace, header->colorspace);
+    } else {
+        const char* subsampling = header->chroma_width_subsampling ? (header->chroma_height_subsampling ? "420" : "422") : "444";
+        if (depth == 8)
+        {
+            _snprintf(colorspace, sizeof(colorspace), "%s%s", subsampling, header->chroma_height_subsampling ? "jpeg" : "");
+        } else {
+            _snprintf(colorspace, sizeof(colorspace), "%sp%d", subsampling, depth);
+        }
+        colorspace[sizeof(colorspace) - 1] = 0;
+    }
+
+    _snprintf(line, size, "%s W%d H%d C%s%s", Y4M_SIGNATURE, header->width, header->height, colorspace, header->other_tags);
+    line[size - 1] = 0;
+}
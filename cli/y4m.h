@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stddef.h>
+
+#define Y4M_MAX_LINE 1024
+
+typedef struct _y4m_header
+{
+    int width;
+    int height;
+    int chroma_width_subsampling;
+    int chroma_height_subsampling;
+    int depth;
+
+    // value of the C tag, kept as is for 8-bit output so chroma siting isn't lost
+    char colorspace[32];
+
+    // frame rate, interlacing, aspect ratio etc., passed through to the output
+    char other_tags[Y4M_MAX_LINE];
+} y4m_header;
+
+// line is the stream header without line break
+// returns NULL on success, otherwise a description of the problem
+const char* y4m_parse_header(const char* line, y4m_header* header);
+
+// formats the stream header for output of the given depth, without line break
+void y4m_format_header(const y4m_header* header, int depth, char* line, size_t size);
@@ -15,3 +15,66 @@
 #else
 #define __PRAGMA_NOUNROLL__
 #endif
+
+#ifndef _MSC_VER
+// GCC and Clang spellings of the Visual C++ keywords, intrinsics and CRT functions used in the code
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <cpuid.h>
+
+#define __declspec(x) __F3KDB_DECLSPEC_##x
+#define __F3KDB_DECLSPEC_align(n) __attribute__((aligned(n)))
+#define __forceinline inline __attribute__((always_inline))
+#define __int64 long long
+
+#ifndef __cdecl
+#define __cdecl
+#endif
+#ifndef __stdcall
+#define __stdcall
+#endif
+
+#define _stricmp strcasecmp
+#define _strdup strdup
+#define _snprintf snprintf
+
+static inline void* _aligned_malloc(size_t size, size_t alignment)
+{
+    void* ptr;
+    if (posix_memalign(&ptr, alignment < sizeof(void*) ? sizeof(void*) : alignment, size))
+    {
+        return NULL;
+    }
+    return ptr;
+}
+
+static inline void _aligned_free(void* ptr)
+{
+    free(ptr);
+}
+
+// cpuid.h defines a __cpuid macro that takes the registers separately
+#undef __cpuid
+static inline void __cpuid(int cpu_info[4], int function_id)
+{
+    __cpuid_count(function_id, 0, cpu_info[0], cpu_info[1], cpu_info[2], cpu_info[3]);
+}
+
+static inline long _InterlockedCompareExchange(volatile long* destination, long exchange, long comparand)
+{
+    return __sync_val_compare_and_swap(destination, comparand, exchange);
+}
+
+static inline long _InterlockedExchange(volatile long* target, long value)
+{
+    return __atomic_exchange_n(target, value, __ATOMIC_SEQ_CST);
+}
+
+static inline long _InterlockedIncrement(volatile long* addend)
+{
+    return __atomic_add_fetch(addend, 1, __ATOMIC_SEQ_CST);
+}
+#endif
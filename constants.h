@@ -20,3 +20,11 @@
 
 #define VALUE_8BIT(x) ( x >> ( INTERNAL_BIT_DEPTH - 8 ) )
 
+// width of vertical strips that wide planes are processed in, in pixels,
+// multiples of 8 so strip edges are on block boundaries
+#define MIN_STRIP_WIDTH 256
+#define STRIP_WIDTH_ALIGNMENT 64
+
+// rows processed per call by the paths that read source rows through a window, windows hold 
+// these rows and the reference rows above and below them
+#define CHUNK_ROWS 16
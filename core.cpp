@@ -2,29 +2,48 @@
 #include <stdarg.h>
 #include <memory.h>
 #include <assert.h>
+#ifdef _MSC_VER
 #include <intrin.h>
+#endif
+#include <limits.h>
+#include <stdint.h>
+#include <system_error>
+#include <thread>
 
 #include "core.h"
 #include "constants.h"
 #include "random.h"
+#include "lut_alloc.h"
+#include "row_convert.h"
 #include "impl_dispatch.h"
 #include "icc_override.h"
+#include "pixel_proc_c_high_f_s_dithering.h"
 
 void f3kdb_core_t::destroy_frame_luts(void)
 {
-    _aligned_free(_y_info);
-    _aligned_free(_cb_info);
-    _aligned_free(_cr_info);
+    lut_free(_y_info);
+    lut_free(_cb_info);
+    lut_free(_cr_info);
     
     _y_info = NULL;
     _cb_info = NULL;
     _cr_info = NULL;
+
+    lut_free(_y_offset_cache);
+    lut_free(_cb_offset_cache);
+    lut_free(_cr_offset_cache);
+
+    _y_offset_cache = NULL;
+    _cb_offset_cache = NULL;
+    _cr_offset_cache = NULL;
     
-    _aligned_free(_grain_buffer_y);
-    _aligned_free(_grain_buffer_c);
+    lut_free(_grain_buffer_y);
+    lut_free(_grain_buffer_c);
+    lut_free(_grain_buffer_cr);
     
     _grain_buffer_y = NULL;
     _grain_buffer_c = NULL;
+    _grain_buffer_cr = NULL;
 
     free(_grain_buffer_offsets);
     _grain_buffer_offsets = NULL;
@@ -60,9 +79,9 @@ static int get_frame_lut_stride(int width_in_pixels)
     return (((width - 1) | (FRAME_LUT_ALIGNMENT - 1)) + 1);
 }
 
-static short* generate_grain_buffer(size_t item_count, RANDOM_ALGORITHM algo, int& seed, double param, int range)
+static short* generate_grain_buffer(size_t item_count, RANDOM_ALGORITHM algo, int& seed, double param, int range, bool allow_large_page)
 {
-    short* buffer = (short*)_aligned_malloc(item_count * sizeof(short), FRAME_LUT_ALIGNMENT);
+    short* buffer = (short*)lut_alloc(item_count * sizeof(short), allow_large_page);
     for (size_t i = 0; i < item_count; i++)
     {
         *(buffer + i) = random(algo, seed, range, param);
@@ -70,6 +89,60 @@ static short* generate_grain_buffer(size_t item_count, RANDOM_ALGORITHM algo, in
     return buffer;
 }
 
+static int get_offset_cache_stride(int info_stride, int sample_mode)
+{
+    return info_stride * (sample_mode == 2 ? 4 : 1);
+}
+
+// Positions of reference pixels relative to the current pixel, in (row, column) units
+// so that the same cache works for any source pitch. SIMD implementations multiply them 
+// by pitch and pixel step to get byte offsets.
+// sample_mode = 1: 8 bytes per 8 pixels, row offsets
+// sample_mode = 2: 32 bytes per 8 pixels, (row, column) pairs of ref 1 and ref 2, 
+//                  ref 3 and ref 4 are the negation of them
+static signed char* generate_offset_cache(const pixel_dither_info* info, int info_stride, int height, int sample_mode, int width_subsampling, int height_subsampling, bool allow_large_page)
+{
+    int stride = get_offset_cache_stride(info_stride, sample_mode);
+    signed char* cache = (signed char*)lut_alloc(stride * height, allow_large_page);
+
+    for (int y = 0; y < height; y++)
+    {
+        const pixel_dither_info* info_ptr = info + info_stride * y;
+        signed char* cache_ptr = cache + stride * y;
+        for (int x = 0; x < info_stride; x += 8)
+        {
+            for (int i = 0; i < 8; i++)
+            {
+                pixel_dither_info info_item = info_ptr[x + i];
+                if (sample_mode == 2)
+                {
+                    cache_ptr[i * 2] = info_item.ref2 >> height_subsampling;
+                    cache_ptr[i * 2 + 1] = info_item.ref1 >> width_subsampling;
+                    cache_ptr[16 + i * 2] = -(info_item.ref1 >> height_subsampling);
+                    cache_ptr[16 + i * 2 + 1] = info_item.ref2 >> width_subsampling;
+                } else {
+                    cache_ptr[i] = info_item.ref1 >> height_subsampling;
+                }
+            }
+            cache_ptr += (sample_mode == 2 ? 32 : 8);
+        }
+    }
+    return cache;
+}
+
+// runs task on a new thread, or right away on this one if the thread can't be created
+template <typename T>
+static std::thread start_task(T task)
+{
+    try
+    {
+        return std::thread(task);
+    } catch (const std::system_error&) {
+        task();
+        return std::thread();
+    }
+}
+
 static size_t get_grain_buffer_item_count(f3kdb_video_info_t* video_info, int plane)
 {
     int width = get_frame_lut_stride(video_info->get_plane_width(plane));
@@ -77,6 +150,26 @@ static size_t get_grain_buffer_item_count(f3kdb_video_info_t* video_info, int pl
     return width * height;
 }
 
+// grain items of one frame, all planes use the size of the luma plane
+static int get_grain_buffer_frame_item_count(const f3kdb_video_info_t* video_info)
+{
+    int item_count = video_info->width;
+
+    // add some safety margin and align it
+    item_count += 255;
+    item_count &= 0xffffff80;
+
+    item_count *= video_info->height;
+    return item_count;
+}
+
+// Luma has a grain buffer and Cb and Cr share one. For RGB, R has grainY and G and B have grainC,
+// G and B only share a buffer without grain, because correlated grain would tint the output.
+static int get_grain_buffer_count(const f3kdb_video_info_t* video_info, const f3kdb_params_t* params)
+{
+    return video_info->color_family == COLOR_FAMILY_RGB && params->grainC > 0 ? 3 : 2;
+}
+
 void f3kdb_core_t::init_frame_luts(void)
 {
     destroy_frame_luts();
@@ -93,19 +186,25 @@ void f3kdb_core_t::init_frame_luts(void)
     y_stride = get_frame_lut_stride(width_in_pixels);
 
     int y_size = sizeof(pixel_dither_info) * y_stride * height_in_pixels;
-    _y_info = (pixel_dither_info*)_aligned_malloc(y_size, FRAME_LUT_ALIGNMENT);
+    _y_info = (pixel_dither_info*)lut_alloc(y_size, _memory_strategy.large_pages);
 
     // ensure unused items are also initialized
     memset(_y_info, 0, y_size);
 
+    // RGB planes all use the reference positions of the first plane, see init_plane_params
+    bool is_rgb = _video_info.color_family == COLOR_FAMILY_RGB;
+
     int c_stride;
     c_stride = get_frame_lut_stride(_video_info.get_plane_width(PLANE_CB));
     int c_size = sizeof(pixel_dither_info) * c_stride * (_video_info.get_plane_height(PLANE_CB));
-    _cb_info = (pixel_dither_info*)_aligned_malloc(c_size, FRAME_LUT_ALIGNMENT);
-    _cr_info = (pixel_dither_info*)_aligned_malloc(c_size, FRAME_LUT_ALIGNMENT);
+    if (!is_rgb)
+    {
+        _cb_info = (pixel_dither_info*)lut_alloc(c_size, _memory_strategy.large_pages);
+        _cr_info = (pixel_dither_info*)lut_alloc(c_size, _memory_strategy.large_pages);
 
-    memset(_cb_info, 0, c_size);
-    memset(_cr_info, 0, c_size);
+        memset(_cb_info, 0, c_size);
+        memset(_cr_info, 0, c_size);
+    }
 
     pixel_dither_info *y_info_ptr, *cb_info_ptr, *cr_info_ptr;
 
@@ -115,8 +214,8 @@ void f3kdb_core_t::init_frame_luts(void)
     for (int y = 0; y < height_in_pixels; y++)
     {
         y_info_ptr = _y_info + y * y_stride;
-        cb_info_ptr = _cb_info + (y >> height_subsamp) * c_stride;
-        cr_info_ptr = _cr_info + (y >> height_subsamp) * c_stride;
+        cb_info_ptr = is_rgb ? NULL : _cb_info + (y >> height_subsamp) * c_stride;
+        cr_info_ptr = is_rgb ? NULL : _cr_info + (y >> height_subsamp) * c_stride;
 
         for (int x = 0; x < width_in_pixels; x++)
         {
@@ -145,7 +244,7 @@ void f3kdb_core_t::init_frame_luts(void)
             *y_info_ptr = info_y;
 
             bool should_set_c = false;
-            should_set_c = ((x & ( ( 1 << width_subsamp ) - 1)) == 0 && 
+            should_set_c = !is_rgb && ((x & ( ( 1 << width_subsamp ) - 1)) == 0 && 
                 (y & ( ( 1 << height_subsamp ) - 1)) == 0);
 
             if (should_set_c) {
@@ -167,21 +266,32 @@ void f3kdb_core_t::init_frame_luts(void)
         }
     }
 
-    int multiplier = _params.dynamic_grain ? 3 : 1;
-    int item_count = width_in_pixels;
-
-    // add some safety margin and align it
-    item_count += 255;
-    item_count &= 0xffffff80;
+    // The offset caches only depend on the tables above, so each plane's cache is built on its
+    // own thread while this one generates the grain buffers, which have to consume the seed in order.
+    std::thread cache_threads[3];
+    cache_threads[0] = start_task([&]() {
+        _y_offset_cache = generate_offset_cache(_y_info, y_stride, height_in_pixels, _params.sample_mode, 0, 0, _memory_strategy.large_pages);
+    });
+    if (!is_rgb)
+    {
+        cache_threads[1] = start_task([&]() {
+            _cb_offset_cache = generate_offset_cache(_cb_info, c_stride, _video_info.get_plane_height(PLANE_CB), _params.sample_mode, width_subsamp, height_subsamp, _memory_strategy.large_pages);
+        });
+        cache_threads[2] = start_task([&]() {
+            _cr_offset_cache = generate_offset_cache(_cr_info, c_stride, _video_info.get_plane_height(PLANE_CR), _params.sample_mode, width_subsamp, height_subsamp, _memory_strategy.large_pages);
+        });
+    }
 
-    item_count *= height_in_pixels;
+    int multiplier = _params.dynamic_grain ? 3 : 1;
+    int item_count = get_grain_buffer_frame_item_count(&_video_info);
 
     _grain_buffer_y = generate_grain_buffer(
         item_count * multiplier,
         _params.random_algo_grain,
         seed,
         _params.random_param_grain,
-        _params.grainY);
+        _params.grainY,
+        _memory_strategy.large_pages);
 
     // we always generate a full-sized buffer to simplify offset calculation
     _grain_buffer_c = generate_grain_buffer(
@@ -189,7 +299,19 @@ void f3kdb_core_t::init_frame_luts(void)
         _params.random_algo_grain,
         seed,
         _params.random_param_grain,
-        _params.grainC);
+        _params.grainC,
+        _memory_strategy.large_pages);
+
+    if (get_grain_buffer_count(&_video_info, &_params) > 2)
+    {
+        _grain_buffer_cr = generate_grain_buffer(
+            item_count * multiplier,
+            _params.random_algo_grain,
+            seed,
+            _params.random_param_grain,
+            _params.grainC,
+            _memory_strategy.large_pages);
+    }
 
     if (_params.dynamic_grain)
     {
@@ -205,18 +327,34 @@ void f3kdb_core_t::init_frame_luts(void)
             _grain_buffer_offsets[i] = offset;
         }
     }
+
+    for (int i = 0; i < 3; i++)
+    {
+        if (cache_threads[i].joinable())
+        {
+            cache_threads[i].join();
+        }
+    }
 }
 
-f3kdb_core_t::f3kdb_core_t(const f3kdb_video_info_t* video_info, const f3kdb_params_t* params) :
+f3kdb_core_t::f3kdb_core_t(const f3kdb_video_info_t* video_info, const f3kdb_params_t* params, const memory_strategy& strategy) :
     _video_info(*video_info),
     _params(*params),
+    _memory_strategy(strategy),
     _y_info(NULL),
     _cb_info(NULL),
     _cr_info(NULL),
+    _y_offset_cache(NULL),
+    _cb_offset_cache(NULL),
+    _cr_offset_cache(NULL),
     _grain_buffer_y(NULL),
     _grain_buffer_c(NULL),
+    _grain_buffer_cr(NULL),
     _grain_buffer_offsets(NULL),
-    _process_plane_impl(NULL)
+    _strip_width(0),
+    _process_plane_impl(NULL),
+    _process_plane_impl_c(NULL),
+    _row_convert(NULL)
 {
     this->init();
 }
@@ -224,6 +362,9 @@ f3kdb_core_t::f3kdb_core_t(const f3kdb_video_info_t* video_info, const f3kdb_par
 f3kdb_core_t::~f3kdb_core_t()
 {
     destroy_frame_luts();
+    scratch_pool_destroy(&_scratch_pool);
+    scratch_pool_destroy(&_staging_pool);
+    scratch_pool_destroy(&_window_pool);
 }
 
 static __inline int select_impl_index(int sample_mode, bool blur_first)
@@ -232,7 +373,7 @@ static __inline int select_impl_index(int sample_mode, bool blur_first)
 	return sample_mode * 2 + (blur_first ? 0 : 1) - 1;
 }
 
-static process_plane_impl_t get_process_plane_impl(int sample_mode, bool blur_first, int opt, int dither_algo)
+static int detect_opt(int opt)
 {
     if (opt == IMPL_AUTO_DETECT) {
         int cpu_info[4] = {-1};
@@ -247,10 +388,96 @@ static process_plane_impl_t get_process_plane_impl(int sample_mode, bool blur_fi
             opt = IMPL_C;
         }
     }
+    return opt;
+}
+
+static process_plane_impl_t get_process_plane_impl(int sample_mode, bool blur_first, int opt, int dither_algo)
+{
     const process_plane_impl_t* impl_table = process_plane_impls[dither_algo][opt];
     return impl_table[select_impl_index(sample_mode, blur_first)];
 }
 
+// in bytes, 0 if unknown
+static int get_l2_cache_size(void)
+{
+    int cpu_info[4] = {-1};
+    __cpuid(cpu_info, 0x80000000);
+    if ((unsigned int)cpu_info[0] < 0x80000006)
+    {
+        return 0;
+    }
+    __cpuid(cpu_info, 0x80000006);
+    return (int)(((unsigned int)cpu_info[2] >> 16) * 1024);
+}
+
+void f3kdb_core_t::init_strip_width(void)
+{
+    _strip_width = 0;
+
+    // Floyd-Steinberg carries errors along whole rows, other dithering only depends on the position of pixels.
+    // Carrying the error column over to the next strip isn't enough, pixels on the left edge of a strip
+    // also diffuse into the row below in the previous strip, so the output of strips would differ.
+    if (_params.dither_algo == DA_HIGH_FLOYD_STEINBERG_DITHERING)
+    {
+        return;
+    }
+
+    int cache_size = get_l2_cache_size();
+    if (cache_size <= 0)
+    {
+        return;
+    }
+
+    // rows that can be referenced from the current row, 
+    // 8-bit and stacked input is read from staged rows, which are 16-bit and stored twice
+    int window_rows = _params.range * 2 + 1;
+    int bytes_per_column = window_rows * (get_pixel_size(_video_info.pixel_mode) == 2 ? 2 : 4);
+
+    // leave half of the cache for output, offset cache and grain buffer
+    int strip_width = cache_size / 2 / bytes_per_column;
+    strip_width &= ~(STRIP_WIDTH_ALIGNMENT - 1);
+    if (strip_width < MIN_STRIP_WIDTH)
+    {
+        // strips would be too narrow, edge blocks and staged columns around them would cost more than cache misses
+        strip_width = MIN_STRIP_WIDTH;
+    }
+    _strip_width = strip_width;
+}
+
+static int get_window_pitch(int row_size)
+{
+    return (row_size + PLANE_ALIGNMENT - 1) & ~(PLANE_ALIGNMENT - 1);
+}
+
+// window buffers start with the dither contexts of up to 3 planes, rows follow at this offset
+#define WINDOW_BUFFER_ROWS_OFFSET (DITHER_CONTEXT_BUFFER_SIZE * 3)
+
+// Size of the buffers used by process_plane_in_place, process_plane_semi_planar, process_frame_v210
+// and process_plane_float, enough for the largest of them. Luma is the widest plane 
+// and has the most reference rows, so sizes for it fit all planes.
+static size_t get_window_buffer_size(const f3kdb_video_info_t* video_info, const f3kdb_params_t* params)
+{
+    f3kdb_video_info_t vi = *video_info;
+    int width = vi.get_plane_width(PLANE_Y);
+    int window_rows = CHUNK_ROWS + params->range * 2;
+    size_t rows_size;
+    if (vi.pixel_mode == HIGH_BIT_DEPTH_FLOAT || params->output_mode == HIGH_BIT_DEPTH_FLOAT)
+    {
+        // a window of 16-bit source rows and a chunk of 16-bit output rows
+        rows_size = (size_t)get_window_pitch(width * 2) * (window_rows + CHUNK_ROWS);
+    } else {
+        int in_pitch = get_window_pitch(width * get_pixel_size(vi.pixel_mode));
+        int out_pitch = get_window_pitch(width * get_pixel_size(params->output_mode));
+        size_t in_place = (size_t)in_pitch * window_rows;
+        // a window and a chunk per component
+        size_t semi_planar = ((size_t)in_pitch * window_rows + (size_t)out_pitch * CHUNK_ROWS) * 2;
+        size_t v210 = (size_t)get_window_pitch(width * 2) * CHUNK_ROWS * 3;
+        rows_size = in_place > semi_planar ? in_place : semi_planar;
+        rows_size = rows_size > v210 ? rows_size : v210;
+    }
+    return WINDOW_BUFFER_ROWS_OFFSET + rows_size;
+}
+
 void f3kdb_core_t::init(void) 
 {
     ___intel_cpu_indicator_init();
@@ -261,108 +488,964 @@ void f3kdb_core_t::init(void)
 
     init_frame_luts();
 
-    _process_plane_impl = get_process_plane_impl(_params.sample_mode, _params.blur_first, _params.opt, _params.dither_algo);
-}
+    // luma plane is the widest, so buffers sized for it fit all planes
+    scratch_pool_init(&_scratch_pool, 
+        _params.dither_algo == DA_HIGH_FLOYD_STEINBERG_DITHERING ? 
+        pixel_proc_high_f_s_dithering::get_error_buffer_size(_video_info.get_plane_width(PLANE_Y)) : 0);
 
-int f3kdb_core_t::process_plane(int frame_index, int plane, unsigned char* dst_frame_ptr, int dst_pitch, const unsigned char* src_frame_ptr, int src_pitch)
-{
-    process_plane_params params;
+    process_plane_params luma_params;
+    init_plane_params(PLANE_Y, luma_params);
+    scratch_pool_init(&_staging_pool, _memory_strategy.staging ? luma_params.get_staging_buffer_size() : 0);
+    scratch_pool_init(&_window_pool, get_window_buffer_size(&_video_info, &_params));
 
-    memset(&params, 0, sizeof(process_plane_params));
+    init_strip_width();
 
-    params.src_plane_ptr = src_frame_ptr;
-    params.src_pitch = src_pitch;
+    int opt = detect_opt(_params.opt);
+    _process_plane_impl = get_process_plane_impl(_params.sample_mode, _params.blur_first, opt, _params.dither_algo);
+    _row_convert = get_row_convert_impl(opt);
+    _process_plane_impl_c = get_process_plane_impl(_params.sample_mode, _params.blur_first, IMPL_C, _params.dither_algo);
+}
 
-    params.dst_plane_ptr = dst_frame_ptr;
-    params.dst_pitch = dst_pitch;
+process_plane_context* f3kdb_core_t::init_plane_params(int plane, process_plane_params& params)
+{
+    memset(&params, 0, sizeof(process_plane_params));
 
     params.input_mode = _video_info.pixel_mode;
     params.input_depth = _video_info.depth;
     params.output_mode = _params.output_mode;
     params.output_depth = _params.output_depth;
+    if (params.input_mode == HIGH_BIT_DEPTH_FLOAT)
+    {
+        params.input_mode = HIGH_BIT_DEPTH_INTERLEAVED_MSB;
+        params.input_depth = 16;
+    }
+    if (params.output_mode == HIGH_BIT_DEPTH_FLOAT)
+    {
+        params.output_mode = HIGH_BIT_DEPTH_INTERLEAVED_MSB;
+        params.output_depth = 16;
+    }
 
     params.plane = plane;
     
     params.width_subsampling = plane == PLANE_Y ? 0 : _video_info.chroma_width_subsampling;
     params.height_subsampling = plane == PLANE_Y ? 0 : _video_info.chroma_height_subsampling;
 
+    // ref values are not negative and are shifted by subsampling, see generate_offset_cache
+    params.reference_rows = _params.range >> params.height_subsampling;
+    params.reference_columns = _params.sample_mode == 2 ? _params.range >> params.width_subsampling : 0;
+
+    params.disable_staging = !_memory_strategy.staging;
+
     params.plane_width_in_pixels = _video_info.get_plane_width(plane);
     params.plane_height_in_pixels = _video_info.get_plane_height(plane);
 
+    params.row_begin = 0;
+    params.row_end = params.plane_height_in_pixels;
+    params.col_begin = 0;
+    params.col_end = params.plane_width_in_pixels;
+
     params.info_stride = get_frame_lut_stride(params.plane_width_in_pixels);
+    params.offset_cache_stride = get_offset_cache_stride(params.info_stride, _params.sample_mode);
     params.grain_buffer_stride = get_frame_lut_stride(params.plane_width_in_pixels);
 
-    process_plane_context* context;
-
-    int grain_setting = 0;
+    if (_video_info.color_family == COLOR_FAMILY_RGB)
+    {
+        // one LUT for all planes, thresholds and grain are mapped as R = Y, G = Cb and B = Cr
+        params.info_ptr_base = _y_info;
+        params.offset_cache = _y_offset_cache;
+        params.pixel_max = _params.keep_tv_range ? TV_RANGE_Y_MAX : FULL_RANGE_Y_MAX;
+        params.pixel_min = _params.keep_tv_range ? TV_RANGE_Y_MIN : FULL_RANGE_Y_MIN;
+        switch (plane)
+        {
+        case PLANE_R:
+            params.threshold = _params.Y;
+            params.grain_buffer = _grain_buffer_y;
+            return &_y_context;
+        case PLANE_G:
+            params.threshold = _params.Cb;
+            params.grain_buffer = _grain_buffer_c;
+            return &_cb_context;
+        case PLANE_B:
+            params.threshold = _params.Cr;
+            params.grain_buffer = _grain_buffer_cr ? _grain_buffer_cr : _grain_buffer_c;
+            return &_cr_context;
+        default:
+            abort();
+            return NULL;
+        }
+    }
 
     switch (plane)
     {
     case PLANE_Y:
         params.info_ptr_base = _y_info;
+        params.offset_cache = _y_offset_cache;
         params.threshold = _params.Y;
         params.pixel_max = _params.keep_tv_range ? TV_RANGE_Y_MAX : FULL_RANGE_Y_MAX;
         params.pixel_min = _params.keep_tv_range ? TV_RANGE_Y_MIN : FULL_RANGE_Y_MIN;
         params.grain_buffer = _grain_buffer_y;
-        grain_setting = _params.grainY;
-        context = &_y_context;
-        break;
+        return &_y_context;
     case PLANE_CB:
         params.info_ptr_base = _cb_info;
+        params.offset_cache = _cb_offset_cache;
         params.threshold = _params.Cb;
         params.pixel_max = _params.keep_tv_range ? TV_RANGE_C_MAX : FULL_RANGE_C_MAX;
         params.pixel_min = _params.keep_tv_range ? TV_RANGE_C_MIN : FULL_RANGE_C_MIN;
         params.grain_buffer = _grain_buffer_c;
-        grain_setting = _params.grainC;
-        context = &_cb_context;
-        break;
+        return &_cb_context;
     case PLANE_CR:
         params.info_ptr_base = _cr_info;
+        params.offset_cache = _cr_offset_cache;
         params.threshold = _params.Cr;
         params.pixel_max = _params.keep_tv_range ? TV_RANGE_C_MAX : FULL_RANGE_C_MAX;
         params.pixel_min = _params.keep_tv_range ? TV_RANGE_C_MIN : FULL_RANGE_C_MIN;
         params.grain_buffer = _grain_buffer_c;
-        grain_setting = _params.grainC;
-        context = &_cr_context;
-        break;
+        return &_cr_context;
     default:
         abort();
+        return NULL;
     }
-    
+}
+
+process_plane_context* f3kdb_core_t::init_frame_params(int frame_index, int plane, unsigned char* dst_frame_ptr, int dst_pitch, const unsigned char* src_frame_ptr, int src_pitch, process_plane_params& params)
+{
+    process_plane_context* context = init_plane_params(plane, params);
+
+    params.src_plane_ptr = src_frame_ptr;
+    params.src_pitch = src_pitch;
+
+    params.dst_plane_ptr = dst_frame_ptr;
+    params.dst_pitch = dst_pitch;
+
     if (_grain_buffer_offsets)
     {
         params.grain_buffer += _grain_buffer_offsets[frame_index % _video_info.num_frames];
     }
 
-    bool copy_plane = false;
-    if (_video_info.pixel_mode == _params.output_mode &&
-        _video_info.depth == _params.output_depth &&
-        grain_setting == 0 &&
-        params.threshold == 0)
-    {
-        copy_plane = true;
-    }
+    return context;
+}
 
-    if (copy_plane) {
-        // no need to process
-        int line_size = params.get_src_width();
-        auto src = src_frame_ptr;
-        auto dst = dst_frame_ptr;
-        if (line_size == src_pitch && src_pitch == dst_pitch)
+bool f3kdb_core_t::can_copy_plane(const process_plane_params& params)
+{
+    int grain_setting = params.plane == PLANE_Y ? _params.grainY : _params.grainC;
+
+    return _video_info.pixel_mode == _params.output_mode &&
+           _video_info.depth == _params.output_depth &&
+           grain_setting == 0 &&
+           params.threshold == 0;
+}
+
+void f3kdb_core_t::copy_plane_rows(const process_plane_params& params)
+{
+    int pixel_size = get_pixel_size(params.input_mode);
+    int line_offset = params.col_begin * pixel_size;
+    int line_size = (params.col_end - params.col_begin) * pixel_size;
+    int row_count = params.row_end - params.row_begin;
+    // stacked planes have the LSB part below the MSB part
+    int parts = params.input_mode == HIGH_BIT_DEPTH_STACKED ? 2 : 1;
+    for (int part = 0; part < parts; part++)
+    {
+        int first_row = params.row_begin + part * params.plane_height_in_pixels;
+        auto src = params.src_plane_ptr + params.src_pitch * first_row + line_offset;
+        auto dst = params.dst_plane_ptr + params.dst_pitch * first_row + line_offset;
+        if (line_size == params.src_pitch && params.src_pitch == params.dst_pitch)
         {
-            memcpy(dst, src, line_size * params.get_src_height());
+            memcpy(dst, src, line_size * row_count);
         } else {
-            for (int row = 0; row < params.get_src_height(); row++) 
+            for (int row = 0; row < row_count; row++) 
             {
                 memcpy(dst, src, line_size);
-                src += src_pitch;
-                dst += dst_pitch;
+                src += params.src_pitch;
+                dst += params.dst_pitch;
             }
         }
+    }
+}
+
+process_plane_impl_t f3kdb_core_t::select_impl(const process_plane_params& params)
+{
+    if (params.src_pitch < SHRT_MIN || params.src_pitch > SHRT_MAX)
+    {
+        return _process_plane_impl_c;
+    }
+    return _process_plane_impl;
+}
+
+int f3kdb_core_t::process_plane(int frame_index, int plane, unsigned char* dst_frame_ptr, int dst_pitch, const unsigned char* src_frame_ptr, int src_pitch)
+{
+    if (plane == PLANE_CBCR)
+    {
+        if (has_float_planes())
+        {
+            return F3KDB_ERROR_NOT_IMPLEMENTED;
+        }
+        return process_plane_semi_planar(frame_index, dst_frame_ptr, dst_pitch, src_frame_ptr, src_pitch);
+    }
+    if (has_float_planes())
+    {
+        return process_plane_float(frame_index, plane, dst_frame_ptr, dst_pitch, src_frame_ptr, src_pitch);
+    }
+
+    process_plane_params params;
+
+    process_plane_context* context = init_frame_params(frame_index, plane, dst_frame_ptr, dst_pitch, src_frame_ptr, src_pitch, params);
+
+    if (dst_frame_ptr == src_frame_ptr)
+    {
+        return process_plane_in_place(params, context);
+    }
+
+    return process_plane_region(params, context);
+}
+
+bool f3kdb_core_t::is_plane_passthrough(int plane)
+{
+    process_plane_params params;
+    init_plane_params(plane, params);
+    return can_copy_plane(params);
+}
+
+int f3kdb_core_t::process_plane_in_place(process_plane_params& params, process_plane_context* context)
+{
+    if (params.dst_pitch != params.src_pitch)
+    {
+        return F3KDB_ERROR_INVALID_ARGUMENT;
+    }
+    // output rows must have the same layout as input rows, 
+    // stacked planes have their LSB part a whole plane away, which doesn't fit in a window of rows
+    if (params.input_mode != params.output_mode || params.input_mode == HIGH_BIT_DEPTH_STACKED)
+    {
+        return F3KDB_ERROR_NOT_IMPLEMENTED;
+    }
+    if (can_copy_plane(params))
+    {
         return F3KDB_SUCCESS;
     }
 
-    _process_plane_impl(params, context);
+    unsigned char* plane_ptr = params.dst_plane_ptr;
+    int pitch = params.dst_pitch;
+    int height = params.plane_height_in_pixels;
+
+    // Rows are processed in chunks, reading from a window that holds the original rows of the chunk 
+    // and lookaround rows above and below it, so rows can be overwritten as soon as they are processed.
+    // The window slides down by one chunk each time.
+    int lookaround_rows = params.reference_rows;
+    int chunk_rows = CHUNK_ROWS;
+    int window_rows = chunk_rows + lookaround_rows * 2;
+    int row_size = params.get_src_width();
+    int window_pitch = get_window_pitch(row_size);
+
+    unsigned char* buffer = (unsigned char*)scratch_pool_acquire(&_window_pool);
+    if (_params.dither_algo == DA_HIGH_FLOYD_STEINBERG_DITHERING)
+    {
+        params.scratch_buffer = scratch_pool_acquire(&_scratch_pool);
+    }
+    if (!buffer || (_params.dither_algo == DA_HIGH_FLOYD_STEINBERG_DITHERING && !params.scratch_buffer))
+    {
+        scratch_pool_release(&_window_pool, buffer);
+        scratch_pool_release(&_scratch_pool, params.scratch_buffer);
+        return F3KDB_ERROR_INSUFFICIENT_MEMORY;
+    }
+    unsigned char* window = buffer + WINDOW_BUFFER_ROWS_OFFSET;
+
+    // dither state is carried from one chunk to the next
+    params.dither_context = (char*)buffer;
+    params.src_pitch = window_pitch;
+    acquire_staging_buffer(params);
+
+    process_plane_impl_t impl = select_impl(params);
+
+    // window row i holds original row (chunk_begin - lookaround_rows + i), rows outside the plane are never read
+    int copied_rows_end = 0;
+    for (int chunk_begin = 0; chunk_begin < height; chunk_begin += chunk_rows)
+    {
+        int window_first_row = chunk_begin - lookaround_rows;
+        if (chunk_begin > 0)
+        {
+            // rows kept from the previous window are at the same place relative to its end
+            memmove(window, window + window_pitch * chunk_rows, window_pitch * lookaround_rows * 2);
+        }
+        int window_end = window_first_row + window_rows;
+        if (window_end > height)
+        {
+            window_end = height;
+        }
+        for (int row = copied_rows_end; row < window_end; row++)
+        {
+            memcpy(window + window_pitch * (row - window_first_row), plane_ptr + pitch * row, row_size);
+        }
+        copied_rows_end = window_end;
+
+        params.src_plane_ptr = window - window_pitch * window_first_row;
+        params.row_begin = chunk_begin;
+        params.row_end = chunk_begin + chunk_rows < height ? chunk_begin + chunk_rows : height;
+
+        impl(params, context);
+    }
+
+    scratch_pool_release(&_window_pool, buffer);
+    scratch_pool_release(&_scratch_pool, params.scratch_buffer);
+    release_staging_buffer(params);
 
     return F3KDB_SUCCESS;
 }
+
+int f3kdb_core_t::process_plane_semi_planar(int frame_index, unsigned char* dst_frame_ptr, int dst_pitch, const unsigned char* src_frame_ptr, int src_pitch)
+{
+    process_plane_params cb_params, cr_params;
+    process_plane_context* cb_context = init_frame_params(frame_index, PLANE_CB, dst_frame_ptr, dst_pitch, src_frame_ptr, src_pitch, cb_params);
+    process_plane_context* cr_context = init_frame_params(frame_index, PLANE_CR, dst_frame_ptr, dst_pitch, src_frame_ptr, src_pitch, cr_params);
+
+    // components are interleaved sample by sample, stacked planes have no such layout
+    if (cb_params.input_mode == HIGH_BIT_DEPTH_STACKED || cb_params.output_mode == HIGH_BIT_DEPTH_STACKED)
+    {
+        return F3KDB_ERROR_NOT_IMPLEMENTED;
+    }
+    bool in_place = dst_frame_ptr == src_frame_ptr;
+    if (in_place && (dst_pitch != src_pitch || cb_params.input_mode != cb_params.output_mode))
+    {
+        return dst_pitch != src_pitch ? F3KDB_ERROR_INVALID_ARGUMENT : F3KDB_ERROR_NOT_IMPLEMENTED;
+    }
+
+    int width = cb_params.plane_width_in_pixels;
+    int height = cb_params.plane_height_in_pixels;
+    int in_sample_size = get_pixel_size(cb_params.input_mode);
+    int out_sample_size = get_pixel_size(cb_params.output_mode);
+    bool copy_cb = can_copy_plane(cb_params);
+    bool copy_cr = can_copy_plane(cr_params);
+
+    if (copy_cb && copy_cr)
+    {
+        if (!in_place)
+        {
+            for (int row = 0; row < height; row++)
+            {
+                memcpy(dst_frame_ptr + dst_pitch * row, src_frame_ptr + src_pitch * row, width * 2 * in_sample_size);
+            }
+        }
+        return F3KDB_SUCCESS;
+    }
+
+    // Same sliding window as process_plane_in_place, except that the window is split into 
+    // one plane per component while copying source rows into it. Each component is processed 
+    // into a chunk of planar rows, which are interleaved into the destination afterwards.
+    // This is layout support only: the kernels still run on planar rows, and the split and
+    // interleave cost about as much as the caller doing them, just without full-size planes.
+    // A kernel reading interleaved samples would also need component-aware dithering 
+    // (error diffusion and dither patterns follow the pixel column) to keep the output 
+    // identical to separate planes.
+    int lookaround_rows = cb_params.reference_rows;
+    int chunk_rows = CHUNK_ROWS;
+    int window_rows = chunk_rows + lookaround_rows * 2;
+    int window_pitch = get_window_pitch(width * in_sample_size);
+    int chunk_pitch = get_window_pitch(width * out_sample_size);
+    int window_size = window_pitch * window_rows;
+    int chunk_size = chunk_pitch * chunk_rows;
+
+    unsigned char* buffer = (unsigned char*)scratch_pool_acquire(&_window_pool);
+    if (_params.dither_algo == DA_HIGH_FLOYD_STEINBERG_DITHERING)
+    {
+        // error diffusion state belongs to a component, so each needs its own buffer
+        cb_params.scratch_buffer = scratch_pool_acquire(&_scratch_pool);
+        cr_params.scratch_buffer = scratch_pool_acquire(&_scratch_pool);
+    }
+    if (!buffer || 
+        (_params.dither_algo == DA_HIGH_FLOYD_STEINBERG_DITHERING && (!cb_params.scratch_buffer || !cr_params.scratch_buffer)))
+    {
+        scratch_pool_release(&_window_pool, buffer);
+        scratch_pool_release(&_scratch_pool, cb_params.scratch_buffer);
+        scratch_pool_release(&_scratch_pool, cr_params.scratch_buffer);
+        return F3KDB_ERROR_INSUFFICIENT_MEMORY;
+    }
+    unsigned char* window_cb = buffer + WINDOW_BUFFER_ROWS_OFFSET;
+    unsigned char* window_cr = window_cb + window_size;
+    unsigned char* chunk_cb = window_cb + window_size * 2;
+    unsigned char* chunk_cr = window_cb + window_size * 2 + chunk_size;
+
+    cb_params.dither_context = (char*)buffer;
+    cr_params.dither_context = (char*)buffer + DITHER_CONTEXT_BUFFER_SIZE;
+    cb_params.src_pitch = cr_params.src_pitch = window_pitch;
+    cb_params.dst_pitch = cr_params.dst_pitch = chunk_pitch;
+    // components are processed one after the other, the staging buffer is refilled on every call
+    acquire_staging_buffer(cb_params);
+    cr_params.staging_buffer = cb_params.staging_buffer;
+
+    process_plane_impl_t impl = select_impl(cb_params);
+
+    int copied_rows_end = 0;
+    for (int chunk_begin = 0; chunk_begin < height; chunk_begin += chunk_rows)
+    {
+        int window_first_row = chunk_begin - lookaround_rows;
+        if (chunk_begin > 0)
+        {
+            memmove(window_cb, window_cb + window_pitch * chunk_rows, window_pitch * lookaround_rows * 2);
+            memmove(window_cr, window_cr + window_pitch * chunk_rows, window_pitch * lookaround_rows * 2);
+        }
+        int window_end = window_first_row + window_rows;
+        if (window_end > height)
+        {
+            window_end = height;
+        }
+        for (int row = copied_rows_end; row < window_end; row++)
+        {
+            int offset = window_pitch * (row - window_first_row);
+            _row_convert->deinterleave_row[in_sample_size - 1](src_frame_ptr + src_pitch * row, window_cb + offset, window_cr + offset, width);
+        }
+        copied_rows_end = window_end;
+
+        int chunk_end = chunk_begin + chunk_rows < height ? chunk_begin + chunk_rows : height;
+        process_plane_params* component_params[] = {&cb_params, &cr_params};
+        process_plane_context* component_contexts[] = {cb_context, cr_context};
+        unsigned char* windows[] = {window_cb, window_cr};
+        unsigned char* chunks[] = {chunk_cb, chunk_cr};
+        bool copy_component[] = {copy_cb, copy_cr};
+        for (int i = 0; i < 2; i++)
+        {
+            if (copy_component[i])
+            {
+                // output has the same layout as input
+                for (int row = chunk_begin; row < chunk_end; row++)
+                {
+                    memcpy(chunks[i] + chunk_pitch * (row - chunk_begin), windows[i] + window_pitch * (row - window_first_row), width * in_sample_size);
+                }
+                continue;
+            }
+            process_plane_params& params = *component_params[i];
+            params.src_plane_ptr = windows[i] - window_pitch * window_first_row;
+            params.dst_plane_ptr = chunks[i] - chunk_pitch * chunk_begin;
+            params.row_begin = chunk_begin;
+            params.row_end = chunk_end;
+            impl(params, component_contexts[i]);
+        }
+
+        for (int row = chunk_begin; row < chunk_end; row++)
+        {
+            int offset = chunk_pitch * (row - chunk_begin);
+            _row_convert->interleave_row[out_sample_size - 1](chunk_cb + offset, chunk_cr + offset, dst_frame_ptr + dst_pitch * row, width);
+        }
+    }
+
+    scratch_pool_release(&_window_pool, buffer);
+    scratch_pool_release(&_scratch_pool, cb_params.scratch_buffer);
+    scratch_pool_release(&_scratch_pool, cr_params.scratch_buffer);
+    release_staging_buffer(cb_params);
+
+    return F3KDB_SUCCESS;
+}
+
+int f3kdb_core_t::process_frame_v210(int frame_index, unsigned char* dst_frame_ptr, int dst_pitch, const unsigned char* const* src_frame_ptrs, const int* src_pitches)
+{
+    if (_video_info.chroma_width_subsampling != 1 || _video_info.chroma_height_subsampling != 0 || 
+        _video_info.color_family != COLOR_FAMILY_YUV)
+    {
+        return F3KDB_ERROR_INVALID_ARGUMENT;
+    }
+    // samples are packed from 10-bit interleaved output of the kernels
+    if (_params.output_mode != HIGH_BIT_DEPTH_INTERLEAVED || _params.output_depth != 10)
+    {
+        return F3KDB_ERROR_INVALID_ARGUMENT;
+    }
+    if (has_float_planes())
+    {
+        return F3KDB_ERROR_NOT_IMPLEMENTED;
+    }
+    int width = _video_info.width;
+    int height = _video_info.height;
+    if (dst_pitch < (width + 5) / 6 * 16)
+    {
+        return F3KDB_ERROR_INVALID_ARGUMENT;
+    }
+
+    static const int planes[] = {PLANE_Y, PLANE_CB, PLANE_CR};
+    process_plane_params plane_params[3];
+    process_plane_context* contexts[3];
+    bool copy_planes[3];
+    for (int i = 0; i < 3; i++)
+    {
+        // kernels read the source planes directly and write into chunks, dst is set per chunk
+        contexts[i] = init_frame_params(frame_index, planes[i], NULL, 0, src_frame_ptrs[i], src_pitches[i], plane_params[i]);
+        copy_planes[i] = can_copy_plane(plane_params[i]);
+    }
+
+    // Every plane is processed into a chunk of 16-bit rows, which are packed into the destination 
+    // while they are still in cache, so no full-frame intermediate buffer is needed.
+    // Chunks can have any height, since reference rows come from the source planes.
+    int chunk_rows = CHUNK_ROWS;
+    int chunk_pitches[3];
+    int chunk_sizes[3];
+    for (int i = 0; i < 3; i++)
+    {
+        chunk_pitches[i] = get_window_pitch(plane_params[i].plane_width_in_pixels * 2);
+        chunk_sizes[i] = chunk_pitches[i] * chunk_rows;
+    }
+
+    unsigned char* buffer = (unsigned char*)scratch_pool_acquire(&_window_pool);
+    bool scratch_failed = false;
+    if (_params.dither_algo == DA_HIGH_FLOYD_STEINBERG_DITHERING)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            plane_params[i].scratch_buffer = scratch_pool_acquire(&_scratch_pool);
+            scratch_failed = scratch_failed || !plane_params[i].scratch_buffer;
+        }
+    }
+    if (!buffer || scratch_failed)
+    {
+        scratch_pool_release(&_window_pool, buffer);
+        for (int i = 0; i < 3; i++)
+        {
+            scratch_pool_release(&_scratch_pool, plane_params[i].scratch_buffer);
+        }
+        return F3KDB_ERROR_INSUFFICIENT_MEMORY;
+    }
+
+    unsigned char* chunks[3];
+    process_plane_impl_t impls[3];
+    unsigned char* chunk_ptr = buffer + WINDOW_BUFFER_ROWS_OFFSET;
+    for (int i = 0; i < 3; i++)
+    {
+        chunks[i] = chunk_ptr;
+        chunk_ptr += chunk_sizes[i];
+        plane_params[i].dither_context = (char*)buffer + DITHER_CONTEXT_BUFFER_SIZE * i;
+        plane_params[i].dst_pitch = chunk_pitches[i];
+        impls[i] = select_impl(plane_params[i]);
+    }
+    // planes are processed one after the other, the staging buffer is refilled on every call
+    // and the one for luma is large enough for chroma
+    acquire_staging_buffer(plane_params[0]);
+    plane_params[1].staging_buffer = plane_params[2].staging_buffer = plane_params[0].staging_buffer;
+
+    for (int chunk_begin = 0; chunk_begin < height; chunk_begin += chunk_rows)
+    {
+        int chunk_end = chunk_begin + chunk_rows < height ? chunk_begin + chunk_rows : height;
+        for (int i = 0; i < 3; i++)
+        {
+            process_plane_params& params = plane_params[i];
+            params.dst_plane_ptr = chunks[i] - chunk_pitches[i] * chunk_begin;
+            params.row_begin = chunk_begin;
+            params.row_end = chunk_end;
+            if (copy_planes[i])
+            {
+                copy_plane_rows(params);
+            } else {
+                impls[i](params, contexts[i]);
+            }
+        }
+
+        for (int row = chunk_begin; row < chunk_end; row++)
+        {
+            int chunk_row = row - chunk_begin;
+            _row_convert->pack_v210_row(
+                (const unsigned short*)(chunks[0] + chunk_pitches[0] * chunk_row),
+                (const unsigned short*)(chunks[1] + chunk_pitches[1] * chunk_row),
+                (const unsigned short*)(chunks[2] + chunk_pitches[2] * chunk_row),
+                dst_frame_ptr + dst_pitch * row,
+                width);
+        }
+    }
+
+    scratch_pool_release(&_window_pool, buffer);
+    for (int i = 0; i < 3; i++)
+    {
+        scratch_pool_release(&_scratch_pool, plane_params[i].scratch_buffer);
+    }
+    release_staging_buffer(plane_params[0]);
+
+    return F3KDB_SUCCESS;
+}
+
+// float samples are mapped to the full 16-bit range, chroma is centered at 0
+int f3kdb_core_t::process_plane_float(int frame_index, int plane, unsigned char* dst_frame_ptr, int dst_pitch, const unsigned char* src_frame_ptr, int src_pitch)
+{
+    process_plane_params params;
+    process_plane_context* context = init_frame_params(frame_index, plane, dst_frame_ptr, dst_pitch, src_frame_ptr, src_pitch, params);
+
+    bool float_input = _video_info.pixel_mode == HIGH_BIT_DEPTH_FLOAT;
+    bool float_output = _params.output_mode == HIGH_BIT_DEPTH_FLOAT;
+    bool in_place = dst_frame_ptr == src_frame_ptr;
+    if (in_place && dst_pitch != src_pitch)
+    {
+        return F3KDB_ERROR_INVALID_ARGUMENT;
+    }
+    if (in_place && !(float_input && float_output))
+    {
+        return F3KDB_ERROR_NOT_IMPLEMENTED;
+    }
+
+    int width = params.plane_width_in_pixels;
+    int height = params.plane_height_in_pixels;
+    if (can_copy_plane(params))
+    {
+        if (!in_place)
+        {
+            for (int row = 0; row < height; row++)
+            {
+                memcpy(dst_frame_ptr + dst_pitch * row, src_frame_ptr + src_pitch * row, width * sizeof(float));
+            }
+        }
+        return F3KDB_SUCCESS;
+    }
+
+    // chroma is centered on 0, RGB planes are not
+    float offset = plane == PLANE_Y || _video_info.color_family == COLOR_FAMILY_RGB ? 0.0f : 0.5f;
+
+    // Float rows are converted to 16-bit in a window that slides down the plane as in process_plane_in_place, 
+    // and float output is converted from a chunk of 16-bit rows once they are processed, 
+    // so the conversions stay in cache. The other side is read or written directly.
+    int lookaround_rows = params.reference_rows;
+    int chunk_rows = CHUNK_ROWS;
+    int window_rows = chunk_rows + lookaround_rows * 2;
+    int row_pitch = get_window_pitch(width * 2);
+    int window_size = float_input ? row_pitch * window_rows : 0;
+
+    unsigned char* buffer = (unsigned char*)scratch_pool_acquire(&_window_pool);
+    if (_params.dither_algo == DA_HIGH_FLOYD_STEINBERG_DITHERING)
+    {
+        params.scratch_buffer = scratch_pool_acquire(&_scratch_pool);
+    }
+    if (!buffer || (_params.dither_algo == DA_HIGH_FLOYD_STEINBERG_DITHERING && !params.scratch_buffer))
+    {
+        scratch_pool_release(&_window_pool, buffer);
+        scratch_pool_release(&_scratch_pool, params.scratch_buffer);
+        return F3KDB_ERROR_INSUFFICIENT_MEMORY;
+    }
+    unsigned char* window = buffer + WINDOW_BUFFER_ROWS_OFFSET;
+    unsigned char* chunk = window + window_size;
+
+    params.dither_context = (char*)buffer;
+    if (float_input)
+    {
+        params.src_pitch = row_pitch;
+    }
+    if (float_output)
+    {
+        params.dst_pitch = row_pitch;
+    }
+    acquire_staging_buffer(params);
+
+    process_plane_impl_t impl = select_impl(params);
+
+    int copied_rows_end = 0;
+    for (int chunk_begin = 0; chunk_begin < height; chunk_begin += chunk_rows)
+    {
+        int chunk_end = chunk_begin + chunk_rows < height ? chunk_begin + chunk_rows : height;
+        if (float_input)
+        {
+            int window_first_row = chunk_begin - lookaround_rows;
+            if (chunk_begin > 0)
+            {
+                memmove(window, window + row_pitch * chunk_rows, row_pitch * lookaround_rows * 2);
+            }
+            int window_end = window_first_row + window_rows;
+            if (window_end > height)
+            {
+                window_end = height;
+            }
+            for (int row = copied_rows_end; row < window_end; row++)
+            {
+                _row_convert->float_row_to_16bit((const float*)(src_frame_ptr + src_pitch * row), (unsigned short*)(window + row_pitch * (row - window_first_row)), width, offset);
+            }
+            copied_rows_end = window_end;
+            params.src_plane_ptr = window - row_pitch * window_first_row;
+        }
+        if (float_output)
+        {
+            params.dst_plane_ptr = chunk - row_pitch * chunk_begin;
+        }
+        params.row_begin = chunk_begin;
+        params.row_end = chunk_end;
+
+        impl(params, context);
+
+        if (float_output)
+        {
+            for (int row = chunk_begin; row < chunk_end; row++)
+            {
+                _row_convert->row_16bit_to_float((const unsigned short*)(chunk + row_pitch * (row - chunk_begin)), (float*)(dst_frame_ptr + dst_pitch * row), width, offset);
+            }
+        }
+    }
+
+    scratch_pool_release(&_window_pool, buffer);
+    scratch_pool_release(&_scratch_pool, params.scratch_buffer);
+    release_staging_buffer(params);
+
+    return F3KDB_SUCCESS;
+}
+
+void f3kdb_core_t::acquire_staging_buffer(process_plane_params& params)
+{
+    // interleaved input is already laid out like staged rows, and the C implementation reads the source directly
+    if (get_pixel_size(params.input_mode) == 1 && !params.disable_staging && select_impl(params) != _process_plane_impl_c)
+    {
+        // if this fails, the implementation allocates by itself
+        params.staging_buffer = scratch_pool_acquire(&_staging_pool);
+    }
+}
+
+void f3kdb_core_t::release_staging_buffer(process_plane_params& params)
+{
+    scratch_pool_release(&_staging_pool, params.staging_buffer);
+    params.staging_buffer = NULL;
+}
+
+int f3kdb_core_t::process_plane_rect(int frame_index, int plane, unsigned char* dst_frame_ptr, int dst_pitch, const unsigned char* src_frame_ptr, int src_pitch, int x, int y, int width, int height)
+{
+    if (has_float_planes())
+    {
+        return F3KDB_ERROR_NOT_IMPLEMENTED;
+    }
+
+    process_plane_params params;
+
+    process_plane_context* context = init_frame_params(frame_index, plane, dst_frame_ptr, dst_pitch, src_frame_ptr, src_pitch, params);
+
+    if (x < 0 || y < 0 || width <= 0 || height <= 0 ||
+        x + width > params.plane_width_in_pixels || y + height > params.plane_height_in_pixels)
+    {
+        return F3KDB_ERROR_INVALID_ARGUMENT;
+    }
+
+    params.row_begin = y;
+    params.row_end = y + height;
+    params.col_begin = x;
+    params.col_end = x + width;
+
+    return process_plane_region(params, context);
+}
+
+int f3kdb_core_t::process_plane_region(process_plane_params& params, process_plane_context* context)
+{
+    if (can_copy_plane(params)) {
+        // no need to process
+        copy_plane_rows(params);
+        return F3KDB_SUCCESS;
+    }
+
+    if (_params.dither_algo == DA_HIGH_FLOYD_STEINBERG_DITHERING)
+    {
+        // if this fails, the dithering context falls back to allocate by itself
+        params.scratch_buffer = scratch_pool_acquire(&_scratch_pool);
+    }
+
+    acquire_staging_buffer(params);
+
+    process_plane_impl_t impl = select_impl(params);
+    if (_strip_width > 0 && params.col_end - params.col_begin > _strip_width)
+    {
+        // Wide planes are processed in vertical strips from top to bottom, so that the rows around 
+        // the current row stay in cache. Strip edges are on multiples of the strip width.
+        int col_begin = params.col_begin;
+        int col_end = params.col_end;
+        for (int strip_begin = col_begin; strip_begin < col_end; strip_begin = params.col_end)
+        {
+            int strip_end = (strip_begin / _strip_width + 1) * _strip_width;
+            params.col_begin = strip_begin;
+            params.col_end = strip_end < col_end ? strip_end : col_end;
+            impl(params, context);
+        }
+        params.col_begin = col_begin;
+        params.col_end = col_end;
+    } else {
+        impl(params, context);
+    }
+
+    scratch_pool_release(&_scratch_pool, params.scratch_buffer);
+    release_staging_buffer(params);
+
+    return F3KDB_SUCCESS;
+}
+
+// [begin, end) of the bytes of rows rows of row_size bytes, pitch may be negative
+static void get_rows_extent(const unsigned char* ptr, int pitch, int row_size, int rows, uintptr_t* begin, uintptr_t* end)
+{
+    intptr_t last_row_offset = (intptr_t)pitch * (rows - 1);
+    *begin = (uintptr_t)ptr + (last_row_offset < 0 ? last_row_offset : 0);
+    *end = (uintptr_t)ptr + (last_row_offset > 0 ? last_row_offset : 0) + row_size;
+}
+
+static bool are_planes_overlapping(const process_plane_params& params)
+{
+    uintptr_t src_begin, src_end, dst_begin, dst_end;
+    get_rows_extent(params.src_plane_ptr, params.src_pitch, params.get_src_width(), params.get_src_height(), &src_begin, &src_end);
+    get_rows_extent(params.dst_plane_ptr, params.dst_pitch, params.get_dst_width(), params.get_dst_height(), &dst_begin, &dst_end);
+    return src_begin < dst_end && dst_begin < src_end;
+}
+
+int f3kdb_core_t::stream_begin(int frame_index, int plane, unsigned char* dst_frame_ptr, int dst_pitch, const unsigned char* src_frame_ptr, int src_pitch, f3kdb_stream_t** stream_out)
+{
+    if (has_float_planes())
+    {
+        return F3KDB_ERROR_NOT_IMPLEMENTED;
+    }
+
+    f3kdb_stream_t* stream = new f3kdb_stream_t();
+    stream->core = this;
+    stream->context = init_frame_params(frame_index, plane, dst_frame_ptr, dst_pitch, src_frame_ptr, src_pitch, stream->params);
+    stream->params.row_end = 0;
+    // Output rows are written while rows below them are still read as references, so unlike
+    // f3kdb_process_plane, streams can't work in place
+    if (are_planes_overlapping(stream->params))
+    {
+        delete stream;
+        return F3KDB_ERROR_INVALID_ARGUMENT;
+    }
+    stream->copy_plane = can_copy_plane(stream->params);
+
+    stream->lookahead_rows = stream->params.reference_rows;
+
+    if (!stream->copy_plane)
+    {
+        // dither state has to survive between calls, window buffers start with room for it
+        stream->params.dither_context = (char*)scratch_pool_acquire(&_window_pool);
+        if (_params.dither_algo == DA_HIGH_FLOYD_STEINBERG_DITHERING)
+        {
+            stream->params.scratch_buffer = scratch_pool_acquire(&_scratch_pool);
+        }
+        if (!stream->params.dither_context ||
+            (_params.dither_algo == DA_HIGH_FLOYD_STEINBERG_DITHERING && !stream->params.scratch_buffer))
+        {
+            stream_end(stream);
+            return F3KDB_ERROR_INSUFFICIENT_MEMORY;
+        }
+        acquire_staging_buffer(stream->params);
+    }
+
+    *stream_out = stream;
+    return F3KDB_SUCCESS;
+}
+
+int f3kdb_core_t::stream_push_rows(f3kdb_stream_t* stream, int available_rows, int* rows_done_out)
+{
+    process_plane_params& params = stream->params;
+    if (available_rows < 0 || available_rows > params.plane_height_in_pixels)
+    {
+        return F3KDB_ERROR_INVALID_ARGUMENT;
+    }
+
+    int row_end = params.plane_height_in_pixels;
+    if (available_rows < params.plane_height_in_pixels)
+    {
+        row_end = available_rows - (stream->copy_plane ? 0 : stream->lookahead_rows);
+    }
+
+    if (row_end > params.row_end)
+    {
+        params.row_begin = params.row_end;
+        params.row_end = row_end;
+        if (stream->copy_plane)
+        {
+            copy_plane_rows(params);
+        } else {
+            select_impl(params)(params, stream->context);
+        }
+    }
+
+    if (rows_done_out)
+    {
+        *rows_done_out = params.row_end;
+    }
+    return F3KDB_SUCCESS;
+}
+
+int f3kdb_core_t::stream_end(f3kdb_stream_t* stream)
+{
+    // the dither context may still be alive if the stream is ended early, 
+    // but everything it uses is owned by the stream, so it can simply be released
+    scratch_pool_release(&_window_pool, stream->params.dither_context);
+    scratch_pool_release(&_scratch_pool, stream->params.scratch_buffer);
+    release_staging_buffer(stream->params);
+    delete stream;
+    return F3KDB_SUCCESS;
+}
+
+LUT_BACKING f3kdb_core_t::get_lut_backing(void) const
+{
+    const void* luts[] = {
+        _y_info, _cb_info, _cr_info,
+        _y_offset_cache, _cb_offset_cache, _cr_offset_cache,
+        _grain_buffer_y, _grain_buffer_c, _grain_buffer_cr,
+    };
+    int lut_count = 0;
+    int large_page_count = 0;
+    for (int i = 0; i < sizeof(luts) / sizeof(luts[0]); i++)
+    {
+        // some are not allocated, depending on color family
+        if (!luts[i])
+        {
+            continue;
+        }
+        lut_count++;
+        if (lut_is_large_page(luts[i]))
+        {
+            large_page_count++;
+        }
+    }
+    if (large_page_count == 0)
+    {
+        return LUT_BACKING_REGULAR_PAGES;
+    }
+    return large_page_count == lut_count ? LUT_BACKING_LARGE_PAGES : LUT_BACKING_MIXED;
+}
+
+void f3kdb_core_t::get_memory_usage(f3kdb_memory_usage_t* usage)
+{
+    memset(usage, 0, sizeof(f3kdb_memory_usage_t));
+
+    usage->pixel_info = lut_get_allocated_size(_y_info) + lut_get_allocated_size(_cb_info) + lut_get_allocated_size(_cr_info);
+    usage->offset_cache = lut_get_allocated_size(_y_offset_cache) + lut_get_allocated_size(_cb_offset_cache) + lut_get_allocated_size(_cr_offset_cache);
+    usage->grain_buffer = lut_get_allocated_size(_grain_buffer_y) + lut_get_allocated_size(_grain_buffer_c) + lut_get_allocated_size(_grain_buffer_cr);
+    if (_grain_buffer_offsets)
+    {
+        usage->frame_offsets = sizeof(int) * _video_info.num_frames;
+    }
+    usage->scratch_buffer = scratch_pool_get_allocated_size(&_scratch_pool) + scratch_pool_get_allocated_size(&_window_pool);
+    usage->staging_buffer = scratch_pool_get_allocated_size(&_staging_pool);
+
+    usage->total = usage->pixel_info + usage->offset_cache + usage->grain_buffer + usage->frame_offsets + 
+                   usage->scratch_buffer + usage->staging_buffer;
+}
+
+void f3kdb_core_t::estimate_memory_usage(f3kdb_video_info_t* video_info, const f3kdb_params_t* params, const memory_strategy& strategy, f3kdb_memory_usage_t* usage)
+{
+    memset(usage, 0, sizeof(f3kdb_memory_usage_t));
+
+    // same sizes as init_frame_luts
+    static const int planes[] = {PLANE_Y, PLANE_CB, PLANE_CR};
+    int lut_planes = video_info->color_family == COLOR_FAMILY_RGB ? 1 : sizeof(planes) / sizeof(planes[0]);
+    for (int i = 0; i < lut_planes; i++)
+    {
+        int info_stride = get_frame_lut_stride(video_info->get_plane_width(planes[i]));
+        int height = video_info->get_plane_height(planes[i]);
+        usage->pixel_info += lut_estimate_allocated_size(sizeof(pixel_dither_info) * info_stride * height, strategy.large_pages);
+        usage->offset_cache += lut_estimate_allocated_size(get_offset_cache_stride(info_stride, params->sample_mode) * height, strategy.large_pages);
+    }
+
+    size_t grain_buffer_size = sizeof(short) * get_grain_buffer_frame_item_count(video_info) * (params->dynamic_grain ? 3 : 1);
+    usage->grain_buffer = lut_estimate_allocated_size(grain_buffer_size, strategy.large_pages) * get_grain_buffer_count(video_info, params);
+    if (params->dynamic_grain)
+    {
+        usage->frame_offsets = sizeof(int) * video_info->num_frames;
+    }
+
+    // one buffer of each kind, as used by a single caller, see init
+    if (params->dither_algo == DA_HIGH_FLOYD_STEINBERG_DITHERING)
+    {
+        usage->scratch_buffer = scratch_pool_get_item_allocated_size(
+            pixel_proc_high_f_s_dithering::get_error_buffer_size(video_info->get_plane_width(PLANE_Y)));
+    }
+    // float planes are always processed through a window, other formats whenever a caller
+    // processes in place, semi-planar or v210, or uses a stream, which any caller may do
+    usage->scratch_buffer += scratch_pool_get_item_allocated_size(get_window_buffer_size(video_info, params));
+    if (strategy.staging && get_pixel_size(video_info->pixel_mode) == 1 && params->opt != IMPL_C)
+    {
+        process_plane_params luma_params;
+        memset(&luma_params, 0, sizeof(process_plane_params));
+        luma_params.plane_width_in_pixels = video_info->get_plane_width(PLANE_Y);
+        luma_params.reference_rows = params->range;
+        usage->staging_buffer = scratch_pool_get_item_allocated_size(luma_params.get_staging_buffer_size());
+    }
+
+    usage->total = usage->pixel_info + usage->offset_cache + usage->grain_buffer + usage->frame_offsets + 
+                   usage->scratch_buffer + usage->staging_buffer;
+}
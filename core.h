@@ -1,13 +1,26 @@
 #pragma once
 
 #include "include/f3kdb.h"
+#include "compiler_compat.h"
 #include "process_plane_context.h"
+#include "scratch_pool.h"
+#include "row_convert.h"
 
 typedef __declspec(align(4)) struct _pixel_dither_info {
     signed char ref1, ref2;
     signed short change;
 } pixel_dither_info;
 
+// bytes of a pixel in a row, stacked planes have their LSB part in separate rows
+static inline int get_pixel_size(int mode)
+{
+    if (mode == HIGH_BIT_DEPTH_FLOAT)
+    {
+        return 4;
+    }
+    return mode == HIGH_BIT_DEPTH_INTERLEAVED || mode == HIGH_BIT_DEPTH_INTERLEAVED_MSB ? 2 : 1;
+}
+
 typedef struct _process_plane_params
 {
     const unsigned char *src_plane_ptr;
@@ -19,6 +32,15 @@ typedef struct _process_plane_params
     int plane_width_in_pixels;
     int plane_height_in_pixels;
 
+    // only pixels in rows [row_begin, row_end) and columns [col_begin, col_end) are processed
+    // pixels outside are still used as references
+    int row_begin;
+    int row_end;
+    int col_begin;
+    int col_end;
+
+    // modes of the rows that implementations read and write, 
+    // float planes are converted to and from HIGH_BIT_DEPTH_INTERLEAVED_MSB rows by the core
     PIXEL_MODE input_mode;
     int input_depth;
     PIXEL_MODE output_mode;
@@ -27,6 +49,10 @@ typedef struct _process_plane_params
     unsigned short threshold;
     pixel_dither_info *info_ptr_base;
     int info_stride;
+
+    // reference pixel positions in (row, column) units, see generate_offset_cache in core.cpp
+    const signed char *offset_cache;
+    int offset_cache_stride;
     
     short* grain_buffer;
     int grain_buffer_stride;
@@ -38,31 +64,83 @@ typedef struct _process_plane_params
     
     int pixel_max;
     int pixel_min;
+
+    // source rows are read directly instead of being staged, to save memory
+    bool disable_staging;
+
+    // reference pixels are at most this many rows above or below the current pixel,
+    // and this many columns left or right of it
+    int reference_rows;
+    int reference_columns;
+
+    // borrowed from the core, used as error buffer by Floyd-Steinberg dithering
+    // may be NULL
+    void* scratch_buffer;
+
+    // optional, DITHER_CONTEXT_BUFFER_SIZE bytes aligned to 16-byte boundary, kept by the caller
+    // when a plane is processed in several calls with consecutive row ranges.
+    // It is initialized in the call with row_begin = 0 and destroyed after the last row.
+    // If NULL, the implementation uses its own context for the rows in this call.
+    char* dither_context;
+
+    // borrowed from the core, get_staging_buffer_size() bytes aligned to 16-byte boundary,
+    // used by SIMD implementations to convert source rows to 16-bit once before they are read
+    // may be NULL
+    void* staging_buffer;
     
     // Helper functions
     inline int get_dst_width() const {
-        return output_mode == HIGH_BIT_DEPTH_INTERLEAVED ? plane_width_in_pixels * 2 : plane_width_in_pixels;
+        return plane_width_in_pixels * get_pixel_size(output_mode);
     }
     inline int get_dst_height() const {
         return output_mode == HIGH_BIT_DEPTH_STACKED ? plane_height_in_pixels * 2 : plane_height_in_pixels;
     }
     inline int get_src_width() const {
-        return input_mode == HIGH_BIT_DEPTH_INTERLEAVED ? plane_width_in_pixels * 2 : plane_width_in_pixels;
+        return plane_width_in_pixels * get_pixel_size(input_mode);
     }
     inline int get_src_height() const {
         return input_mode == HIGH_BIT_DEPTH_STACKED ? plane_height_in_pixels * 2 : plane_height_in_pixels;
     }
+    // staged rows are 16-bit and padded to whole blocks of 8 pixels
+    inline int get_staging_pitch() const {
+        return (((plane_width_in_pixels - 1) | 7) + 1) * 2;
+    }
+    // all rows that can be referenced from a row, stored twice, see stage_source_rows in flash3kyuu_deband_sse_base.h
+    inline int get_staging_buffer_size() const {
+        return get_staging_pitch() * (reference_rows * 2 + 1) * 2;
+    }
 } process_plane_params;
 
+// ways of trading speed for memory, f3kdb_create turns them off to fit in memory_budget
+typedef struct _memory_strategy
+{
+    // lookup tables can be put in large pages, which rounds their size up to whole pages
+    bool large_pages;
+    // SIMD implementations convert 8-bit and stacked source rows into a staging buffer
+    bool staging;
+} memory_strategy;
+
 typedef void (__cdecl *process_plane_impl_t)(const process_plane_params& params, process_plane_context* context);
 
+class f3kdb_stream_t;
+
 class f3kdb_core_t {
 private:
     process_plane_impl_t _process_plane_impl;
+
+    // used when src_pitch doesn't fit in the offset calculation of SIMD implementations
+    process_plane_impl_t _process_plane_impl_c;
+
+    // row layout conversions of the window paths, SIMD unless opt is IMPL_C
+    const row_convert_impl* _row_convert;
         
     pixel_dither_info *_y_info;
     pixel_dither_info *_cb_info;
     pixel_dither_info *_cr_info;
+
+    signed char *_y_offset_cache;
+    signed char *_cb_offset_cache;
+    signed char *_cr_offset_cache;
     
     process_plane_context _y_context;
     process_plane_context _cb_context;
@@ -70,23 +148,85 @@ private:
     
     short* _grain_buffer_y;
     short* _grain_buffer_c;
+    // only for the B plane of COLOR_FAMILY_RGB with grainC, see get_grain_buffer_count
+    short* _grain_buffer_cr;
 
     int* _grain_buffer_offsets;
 
+    scratch_pool _scratch_pool;
+    scratch_pool _staging_pool;
+    // dither contexts and rows of the paths that process through a window, see get_window_buffer_size
+    scratch_pool _window_pool;
+
+    // planes wider than this are processed in vertical strips, 0 = disabled
+    int _strip_width;
+
     f3kdb_video_info_t _video_info;
     f3kdb_params_t _params;
+    memory_strategy _memory_strategy;
 
     void init(void);
     void init_frame_luts(void);
 
+    process_plane_context* init_plane_params(int plane, process_plane_params& params);
+    process_plane_context* init_frame_params(int frame_index, int plane, unsigned char* dst_frame_ptr, int dst_pitch, const unsigned char* src_frame_ptr, int src_pitch, process_plane_params& params);
+
+    bool can_copy_plane(const process_plane_params& params);
+    void copy_plane_rows(const process_plane_params& params);
+    process_plane_impl_t select_impl(const process_plane_params& params);
+    int process_plane_region(process_plane_params& params, process_plane_context* context);
+    int process_plane_in_place(process_plane_params& params, process_plane_context* context);
+    int process_plane_float(int frame_index, int plane, unsigned char* dst_frame_ptr, int dst_pitch, const unsigned char* src_frame_ptr, int src_pitch);
+    int process_plane_semi_planar(int frame_index, unsigned char* dst_frame_ptr, int dst_pitch, const unsigned char* src_frame_ptr, int src_pitch);
+
+    // float input or output, only supported by process_plane
+    bool has_float_planes(void) const
+    {
+        return _video_info.pixel_mode == HIGH_BIT_DEPTH_FLOAT || _params.output_mode == HIGH_BIT_DEPTH_FLOAT;
+    }
+
+    void init_strip_width(void);
+    void acquire_staging_buffer(process_plane_params& params);
+    void release_staging_buffer(process_plane_params& params);
+
     void destroy_frame_luts(void);
 
     f3kdb_core_t(const f3kdb_core_t&);
     f3kdb_core_t operator=(const f3kdb_core_t&);
     
 public:
-    f3kdb_core_t(const f3kdb_video_info_t* video_info, const f3kdb_params_t* params);
+    f3kdb_core_t(const f3kdb_video_info_t* video_info, const f3kdb_params_t* params, const memory_strategy& strategy);
     virtual ~f3kdb_core_t();
 
-    int f3kdb_core_t::process_plane(int frame_index, int plane, unsigned char* dst_frame_ptr, int dst_pitch, const unsigned char* src_frame_ptr, int src_pitch);
-};
\ No newline at end of file
+    int process_plane(int frame_index, int plane, unsigned char* dst_frame_ptr, int dst_pitch, const unsigned char* src_frame_ptr, int src_pitch);
+    int process_plane_rect(int frame_index, int plane, unsigned char* dst_frame_ptr, int dst_pitch, const unsigned char* src_frame_ptr, int src_pitch, int x, int y, int width, int height);
+
+    // all planes of a 4:2:2 frame, packed into v210
+    int process_frame_v210(int frame_index, unsigned char* dst_frame_ptr, int dst_pitch, const unsigned char* const* src_frame_ptrs, const int* src_pitches);
+
+    // output of the plane would be an exact copy of the input, see can_copy_plane
+    bool is_plane_passthrough(int plane);
+
+    int stream_begin(int frame_index, int plane, unsigned char* dst_frame_ptr, int dst_pitch, const unsigned char* src_frame_ptr, int src_pitch, f3kdb_stream_t** stream_out);
+    int stream_push_rows(f3kdb_stream_t* stream, int available_rows, int* rows_done_out);
+    int stream_end(f3kdb_stream_t* stream);
+
+    LUT_BACKING get_lut_backing(void) const;
+
+    void get_memory_usage(f3kdb_memory_usage_t* usage);
+
+    // memory a core would hold right after creation, with one buffer of each kind borrowed by a caller
+    static void estimate_memory_usage(f3kdb_video_info_t* video_info, const f3kdb_params_t* params, const memory_strategy& strategy, f3kdb_memory_usage_t* usage);
+};
+
+// state of a plane that is processed incrementally, see f3kdb_stream_begin
+class f3kdb_stream_t {
+public:
+    f3kdb_core_t* core;
+    process_plane_params params;
+    process_plane_context* context;
+
+    // source rows below the current one that need to be available before it can be processed
+    int lookahead_rows;
+    bool copy_plane;
+};
@@ -1,10 +1,12 @@
 
-#include <Windows.h>
-
 #include <stdio.h>
 
 #include <emmintrin.h>
 
+// dumps are only supported on Windows
+#ifdef _WIN32
+#include <Windows.h>
+
 void dump_init(const TCHAR* dump_base_name, int plane, int items_per_line);
 
 void dump_next_line();
@@ -14,6 +16,7 @@ void dump_value(const TCHAR* dump_name, int value);
 void dump_value(const TCHAR* dump_name, __m128i value, int word_size_in_bytes, bool is_signed);
 
 void dump_finish();
+#endif
 
 #ifdef ENABLE_DEBUG_DUMP
 
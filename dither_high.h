@@ -9,57 +9,72 @@
 
 #include <assert.h>
 #include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 namespace dither_high
 {
     static __m128i _ordered_dithering_threshold_map[16] [2];
     static __m128i _ordered_dithering_threshold_map_yuy2[16] [8];
-    static volatile bool _threshold_map_initialized = false;
+
+    // 0: not initialized, 1: initialization in progress, 2: ready
+    // process_plane may be called from multiple threads at once, so only one
+    // of them is allowed to fill the maps, the others wait until it is done
+    static volatile long _threshold_map_state = 0;
 
     static __inline void init_ordered_dithering()
     {
-        if (UNLIKELY(!_threshold_map_initialized)) {
-            __m128i threhold_row;
-            __m128i zero = _mm_setzero_si128();
-            for (int i = 0; i < 16; i++) 
-            {
-                threhold_row = *(__m128i*)pixel_proc_high_ordered_dithering::THRESHOLD_MAP[i];
-                    
-                __m128i part_0 = _mm_unpacklo_epi8(threhold_row, zero);
-                __m128i part_1 = _mm_unpackhi_epi8(threhold_row, zero);
-
-                if (INTERNAL_BIT_DEPTH < 16)
-                {
-                    part_0 = _mm_srli_epi16(part_0, 16 - INTERNAL_BIT_DEPTH);
-                    part_1 = _mm_srli_epi16(part_1, 16 - INTERNAL_BIT_DEPTH);
-                }
-                _ordered_dithering_threshold_map[i][0] = part_0;
-                _ordered_dithering_threshold_map[i][1] = part_1;
+        if (LIKELY(_threshold_map_state == 2)) {
+            return;
+        }
+        if (_InterlockedCompareExchange(&_threshold_map_state, 1, 0) != 0) {
+            while (_threshold_map_state != 2) {
+                _mm_pause();
+            }
+            return;
+        }
+        __m128i threhold_row;
+        __m128i zero = _mm_setzero_si128();
+        for (int i = 0; i < 16; i++) 
+        {
+            threhold_row = *(__m128i*)pixel_proc_high_ordered_dithering::THRESHOLD_MAP[i];
                 
-                __m128i tmp = _mm_unpacklo_epi8(part_0, part_0);
-                _ordered_dithering_threshold_map_yuy2[i][0] = _mm_unpacklo_epi16(part_0, tmp);
-                _ordered_dithering_threshold_map_yuy2[i][1] = _mm_unpackhi_epi16(part_0, tmp);
-
-                tmp = _mm_unpackhi_epi8(part_0, part_0);
-                _ordered_dithering_threshold_map_yuy2[i][2] = _mm_unpacklo_epi16(part_1, tmp);
-                _ordered_dithering_threshold_map_yuy2[i][3] = _mm_unpackhi_epi16(part_1, tmp);
+            __m128i part_0 = _mm_unpacklo_epi8(threhold_row, zero);
+            __m128i part_1 = _mm_unpackhi_epi8(threhold_row, zero);
 
-                tmp = _mm_unpacklo_epi8(part_1, part_1);
-                _ordered_dithering_threshold_map_yuy2[i][4] = _mm_unpacklo_epi16(part_0, tmp);
-                _ordered_dithering_threshold_map_yuy2[i][5] = _mm_unpackhi_epi16(part_0, tmp);
-
-                tmp = _mm_unpackhi_epi8(part_1, part_1);
-                _ordered_dithering_threshold_map_yuy2[i][6] = _mm_unpacklo_epi16(part_1, tmp);
-                _ordered_dithering_threshold_map_yuy2[i][7] = _mm_unpackhi_epi16(part_1, tmp);
+            if (INTERNAL_BIT_DEPTH < 16)
+            {
+                part_0 = _mm_srli_epi16(part_0, 16 - INTERNAL_BIT_DEPTH);
+                part_1 = _mm_srli_epi16(part_1, 16 - INTERNAL_BIT_DEPTH);
             }
-            _mm_mfence();
-            _threshold_map_initialized = true;
+            _ordered_dithering_threshold_map[i][0] = part_0;
+            _ordered_dithering_threshold_map[i][1] = part_1;
+            
+            __m128i tmp = _mm_unpacklo_epi8(part_0, part_0);
+            _ordered_dithering_threshold_map_yuy2[i][0] = _mm_unpacklo_epi16(part_0, tmp);
+            _ordered_dithering_threshold_map_yuy2[i][1] = _mm_unpackhi_epi16(part_0, tmp);
+
+            tmp = _mm_unpackhi_epi8(part_0, part_0);
+            _ordered_dithering_threshold_map_yuy2[i][2] = _mm_unpacklo_epi16(part_1, tmp);
+            _ordered_dithering_threshold_map_yuy2[i][3] = _mm_unpackhi_epi16(part_1, tmp);
+
+            tmp = _mm_unpacklo_epi8(part_1, part_1);
+            _ordered_dithering_threshold_map_yuy2[i][4] = _mm_unpacklo_epi16(part_0, tmp);
+            _ordered_dithering_threshold_map_yuy2[i][5] = _mm_unpackhi_epi16(part_0, tmp);
+
+            tmp = _mm_unpackhi_epi8(part_1, part_1);
+            _ordered_dithering_threshold_map_yuy2[i][6] = _mm_unpacklo_epi16(part_1, tmp);
+            _ordered_dithering_threshold_map_yuy2[i][7] = _mm_unpackhi_epi16(part_1, tmp);
         }
+        // _InterlockedExchange is a full barrier, so other threads see the filled maps
+        // once they see the state change to 2
+        _InterlockedExchange(&_threshold_map_state, 2);
     }
 
     static void init_ordered_dithering_with_output_depth(char context_buffer[CONTEXT_BUFFER_SIZE], int output_depth)
     {
-        assert(_threshold_map_initialized);
+        assert(_threshold_map_state == 2);
 
         __m128i shift = _mm_set_epi32(0, 0, 0, output_depth - 8);
 
@@ -75,11 +90,11 @@ namespace dither_high
     }
 
     template <int dither_algo>
-    static __inline void init(char context_buffer[CONTEXT_BUFFER_SIZE], int frame_width, int output_depth) 
+    static __inline void init(char context_buffer[CONTEXT_BUFFER_SIZE], int frame_width, int output_depth, void* scratch_buffer = NULL) 
     {
         if (dither_algo == DA_HIGH_FLOYD_STEINBERG_DITHERING)
         {
-            pixel_proc_high_f_s_dithering::init_context(context_buffer, frame_width, output_depth);
+            pixel_proc_high_f_s_dithering::init_context(context_buffer, frame_width, output_depth, scratch_buffer);
         } else if (dither_algo == DA_HIGH_ORDERED_DITHERING) {
             init_ordered_dithering();
             init_ordered_dithering_with_output_depth(context_buffer, output_depth);
@@ -95,8 +110,10 @@ namespace dither_high
         }
     }
     
+    // skip_pixels: leading pixels that are outside the processed region, 
+    //              they don't take part in error diffusion
     template <int dither_algo>
-    static __forceinline __m128i dither(void* context, __m128i pixels, int row, int column)
+    static __forceinline __m128i dither(void* context, __m128i pixels, int row, int column, int skip_pixels = 0)
     {
         switch (dither_algo)
         {
@@ -118,7 +135,7 @@ namespace dither_high
             unsigned short buffer[8];
             _mm_store_si128((__m128i*)buffer, pixels);
             __PRAGMA_NOUNROLL__
-            for (int i = 0; i < 8; i++)
+            for (int i = skip_pixels; i < 8; i++)
             {
                 buffer[i] = (unsigned short)pixel_proc_high_f_s_dithering::dither(context, buffer[i], row, column + i);
                 pixel_proc_high_f_s_dithering::next_pixel(context);
@@ -47,6 +47,9 @@ static __inline int read_pixel(const process_plane_params& params, void* context
     case HIGH_BIT_DEPTH_INTERLEAVED:
         ret = *(unsigned short*)ptr;
         break;
+    case HIGH_BIT_DEPTH_INTERLEAVED_MSB:
+        // already in the internal precision
+        return *(unsigned short*)ptr;
     default:
         // shouldn't happen!
         abort();
@@ -61,7 +64,8 @@ template <int sample_mode, bool blur_first, int mode, int output_mode>
 static __forceinline void __cdecl process_plane_plainc_mode12_high(const process_plane_params& params, process_plane_context*)
 {
     pixel_dither_info* info_ptr;
-    char context[CONTEXT_BUFFER_SIZE];
+    char local_context[CONTEXT_BUFFER_SIZE];
+    char* context = params.dither_context ? params.dither_context : local_context;
 
     unsigned short threshold = params.threshold;
 
@@ -70,9 +74,13 @@ static __forceinline void __cdecl process_plane_plainc_mode12_high(const process
 
     int width_subsamp = params.width_subsampling;
 
-    pixel_proc_init_context<mode>(context, params.plane_width_in_pixels, params.output_depth);
+    if (!params.dither_context || params.row_begin == 0)
+    {
+        pixel_proc_init_context<mode>(context, params.col_end - params.col_begin, params.output_depth, params.scratch_buffer);
+    }
 
-    int pixel_step = params.input_mode == HIGH_BIT_DEPTH_INTERLEAVED ? 2 : 1;
+    int pixel_step = get_pixel_size(params.input_mode);
+    int dst_pixel_step = get_pixel_size(output_mode);
 
     int process_width = params.plane_width_in_pixels;
 
@@ -80,17 +88,17 @@ static __forceinline void __cdecl process_plane_plainc_mode12_high(const process
 
 
 
-    for (int i = 0; i < params.plane_height_in_pixels; i++)
+    for (int i = params.row_begin; i < params.row_end; i++)
     {
-        const unsigned char* src_px = params.src_plane_ptr + params.src_pitch * i;
-        unsigned char* dst_px = params.dst_plane_ptr + params.dst_pitch * i;
+        const unsigned char* src_px = params.src_plane_ptr + params.src_pitch * i + params.col_begin * pixel_step;
+        unsigned char* dst_px = params.dst_plane_ptr + params.dst_pitch * i + params.col_begin * dst_pixel_step;
 
-        const short* grain_buffer_ptr = params.grain_buffer + params.grain_buffer_stride * i;
+        const short* grain_buffer_ptr = params.grain_buffer + params.grain_buffer_stride * i + params.col_begin;
 
-        info_ptr = params.info_ptr_base + params.info_stride * i;
+        info_ptr = params.info_ptr_base + params.info_stride * i + params.col_begin;
 
 
-        for (int j = 0; j < process_width; j++)
+        for (int j = params.col_begin; j < params.col_end; j++)
         {
             pixel_dither_info info = *info_ptr;
             int src_px_up = read_pixel<mode>(params, context, src_px);
@@ -209,6 +217,10 @@ static __forceinline void __cdecl process_plane_plainc_mode12_high(const process
                 *((unsigned short*)dst_px) = (unsigned short)(new_pixel & 0xFFFF);
                 dst_px++;
                 break;
+            case HIGH_BIT_DEPTH_INTERLEAVED_MSB:
+                *((unsigned short*)dst_px) = (unsigned short)((new_pixel << (INTERNAL_BIT_DEPTH - params.output_depth)) & 0xFFFF);
+                dst_px++;
+                break;
             default:
                 abort();
             }
@@ -225,7 +237,10 @@ static __forceinline void __cdecl process_plane_plainc_mode12_high(const process
 
     DUMP_FINISH();
 
-    pixel_proc_destroy_context<mode>(context);
+    if (!params.dither_context || params.row_end == params.plane_height_in_pixels)
+    {
+        pixel_proc_destroy_context<mode>(context);
+    }
 }
 
 template <int sample_mode, bool blur_first, int mode>
@@ -246,6 +261,10 @@ void __cdecl process_plane_plainc(const process_plane_params& params, process_pl
         process_plane_plainc_mode12_high<sample_mode, blur_first, mode, HIGH_BIT_DEPTH_INTERLEAVED>(params, context);
         break;
 
+    case HIGH_BIT_DEPTH_INTERLEAVED_MSB:
+        process_plane_plainc_mode12_high<sample_mode, blur_first, mode, HIGH_BIT_DEPTH_INTERLEAVED_MSB>(params, context);
+        break;
+
     default:
         abort();
     }
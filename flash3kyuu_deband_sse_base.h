@@ -12,21 +12,6 @@
  *       for generating code in multiple SSE versions.                      *
  ****************************************************************************/
 
-typedef struct _info_cache
-{
-    int pitch;
-    char* data_stream;
-} info_cache;
-
-static void destroy_cache(void* data)
-{
-    assert(data);
-
-    info_cache* cache = (info_cache*) data;
-    _aligned_free(cache->data_stream);
-    free(data);
-}
-
 #ifdef ENABLE_DEBUG_DUMP
 
 static void __forceinline _dump_value_group(const TCHAR* name, __m128i part1, bool is_signed=false)
@@ -43,89 +28,34 @@ static void __forceinline _dump_value_group(const TCHAR* name, __m128i part1, bo
 #endif
 
 
-template <int sample_mode, int ref_part_index>
-static __forceinline void process_plane_info_block(
-    pixel_dither_info *&info_ptr, 
-    const unsigned char* src_addr_start, 
-    const __m128i &src_pitch_vector, 
-    const __m128i &minus_one, 
-    const __m128i &width_subsample_vector,
-    const __m128i &height_subsample_vector,
-    const __m128i &pixel_step_shift_bits,
-    char*& info_data_stream)
+// converts the (row, column) offsets of 8 pixels in the offset cache to byte offsets
+// pitch_step_vector: each dword is (pixel step << 16 | src_pitch)
+// output layout: [1 1 1 1] [1 1 1 1] for sample_mode = 1
+//                [1 1 1 1] [2 2 2 2] [1 1 1 1] [2 2 2 2] for sample_mode = 2
+template <int sample_mode>
+static __forceinline void expand_ref_offsets(
+    const signed char* offset_cache,
+    const __m128i& pitch_step_vector,
+    char* info_data_stream)
 {
-    assert(ref_part_index <= 2);
-
-    __m128i info_block = _mm_load_si128((__m128i*)info_ptr);
-
-    // ref1: bit 0-7
-    // left-shift & right-shift 24bits to remove other elements and preserve sign
-    __m128i ref1 = info_block;
-    ref1 = _mm_slli_epi32(ref1, 24); // << 24
-    ref1 = _mm_srai_epi32(ref1, 24); // >> 24
-
-    DUMP_VALUE("ref1", ref1, 4, true);
-
-    __m128i ref_offset1;
-    __m128i ref_offset2;
-
-    __m128i temp_ref1;
-    switch (sample_mode)
+    if (sample_mode == 1)
     {
-    case 0:
-        // ref1 = (abs(ref1) >> height_subsampling) * (sign(ref1))
-        temp_ref1 = _mm_abs_epi32(ref1);
-        temp_ref1 = _mm_sra_epi32(temp_ref1, height_subsample_vector);
-        temp_ref1 = _cmm_mullo_limit16_epi32(temp_ref1, _mm_srai_epi32(ref1, 31));
-        ref_offset1 = _cmm_mullo_limit16_epi32(src_pitch_vector, temp_ref1); // packed DWORD multiplication
-        DUMP_VALUE("ref_pos", ref_offset1, 4, true);
-        break;
-    case 1:
-        // ref1 is guarenteed to be postive
-        temp_ref1 = _mm_sra_epi32(ref1, height_subsample_vector);
-        ref_offset1 = _cmm_mullo_limit16_epi32(src_pitch_vector, temp_ref1); // packed DWORD multiplication
-        DUMP_VALUE("ref_pos", ref_offset1, 4, true);
-
-        ref_offset2 = _cmm_negate_all_epi32(ref_offset1, minus_one); // negates all offsets
-        break;
-    case 2:
-        // ref2: bit 8-15
-        // similar to above
-        __m128i ref2;
-        ref2 = info_block;
-        ref2 = _mm_slli_epi32(ref2, 16); // << 16
-        ref2 = _mm_srai_epi32(ref2, 24); // >> 24
-
-        __m128i ref1_fix, ref2_fix;
-        // ref_px = src_pitch * info.ref2 + info.ref1;
-        ref1_fix = _mm_sra_epi32(ref1, width_subsample_vector);
-        ref2_fix = _mm_sra_epi32(ref2, height_subsample_vector);
-        ref_offset1 = _cmm_mullo_limit16_epi32(src_pitch_vector, ref2_fix); // packed DWORD multiplication
-        ref_offset1 = _mm_add_epi32(ref_offset1, _mm_sll_epi32(ref1_fix, pixel_step_shift_bits));
-        DUMP_VALUE("ref_pos", ref_offset1, 4, true);
-
-        // ref_px_2 = info.ref2 - src_pitch * info.ref1;
-        ref1_fix = _mm_sra_epi32(ref1, height_subsample_vector);
-        ref2_fix = _mm_sra_epi32(ref2, width_subsample_vector);
-        ref_offset2 = _cmm_mullo_limit16_epi32(src_pitch_vector, ref1_fix); // packed DWORD multiplication
-        ref_offset2 = _mm_sub_epi32(_mm_sll_epi32(ref2_fix, pixel_step_shift_bits), ref_offset2);
-        DUMP_VALUE("ref_pos_2", ref_offset2, 4, true);
-        break;
-    default:
-        abort();
-    }
-
-    if (info_data_stream){
-        _mm_store_si128((__m128i*)info_data_stream, ref_offset1);
-        info_data_stream += 16;
-
-        if (sample_mode == 2) {
-            _mm_store_si128((__m128i*)info_data_stream, ref_offset2);
-            info_data_stream += 16;
-        }
+        // row offsets only, pair them with zero column offsets
+        __m128i ref1 = _mm_loadl_epi64((const __m128i*)offset_cache);
+        ref1 = _mm_srai_epi16(_mm_unpacklo_epi8(ref1, ref1), 8);
+        __m128i zero = _mm_setzero_si128();
+        _mm_store_si128((__m128i*)info_data_stream, _mm_madd_epi16(_mm_unpacklo_epi16(ref1, zero), pitch_step_vector));
+        _mm_store_si128((__m128i*)(info_data_stream + 16), _mm_madd_epi16(_mm_unpackhi_epi16(ref1, zero), pitch_step_vector));
+    } else {
+        // (row, column) pairs, sign-extend to words and
+        // offset = row * src_pitch + column * pixel_step
+        __m128i ref1 = _mm_load_si128((const __m128i*)offset_cache);
+        __m128i ref2 = _mm_load_si128((const __m128i*)(offset_cache + 16));
+        _mm_store_si128((__m128i*)info_data_stream, _mm_madd_epi16(_mm_srai_epi16(_mm_unpacklo_epi8(ref1, ref1), 8), pitch_step_vector));
+        _mm_store_si128((__m128i*)(info_data_stream + 16), _mm_madd_epi16(_mm_srai_epi16(_mm_unpacklo_epi8(ref2, ref2), 8), pitch_step_vector));
+        _mm_store_si128((__m128i*)(info_data_stream + 32), _mm_madd_epi16(_mm_srai_epi16(_mm_unpackhi_epi8(ref1, ref1), 8), pitch_step_vector));
+        _mm_store_si128((__m128i*)(info_data_stream + 48), _mm_madd_epi16(_mm_srai_epi16(_mm_unpackhi_epi8(ref2, ref2), 8), pitch_step_vector));
     }
-
-    info_ptr += 4;
 }
 
 static __forceinline __m128i generate_blend_mask_high(__m128i a, __m128i b, __m128i threshold)
@@ -225,6 +155,7 @@ static __m128i __forceinline process_pixels(
     bool need_clamping,
     int row,
     int column,
+    int skip_pixels,
     void* dither_context)
 {
     __m128i ret = process_pixels_mode12_high_part<sample_mode, blur_first>
@@ -244,7 +175,7 @@ static __m128i __forceinline process_pixels(
     case DA_HIGH_NO_DITHERING:
     case DA_HIGH_ORDERED_DITHERING:
     case DA_HIGH_FLOYD_STEINBERG_DITHERING:
-        ret = dither_high::dither<dither_algo>(dither_context, ret, row, column);
+        ret = dither_high::dither<dither_algo>(dither_context, ret, row, column, skip_pixels);
         break;
     default:
         break;
@@ -258,13 +189,17 @@ static __m128i __forceinline process_pixels(
     return ret;
 }
 
+// output_bits: shift count down to output depth, or mask of the output bits for HIGH_BIT_DEPTH_INTERLEAVED_MSB
+// dst_aligned: dst is aligned to 16-byte boundary, only matters for interleaved output, 
+//              other modes store 8 bytes at a time which has no alignment requirement
 template <PIXEL_MODE output_mode>
 static int __forceinline store_pixels(
     __m128i pixels,
-    __m128i downshift_bits,
+    __m128i output_bits,
     unsigned char* dst,
     int dst_pitch,
-    int height_in_pixels)
+    int height_in_pixels,
+    bool dst_aligned = true)
 {
     switch (output_mode)
     {
@@ -278,7 +213,7 @@ static int __forceinline store_pixels(
         }
     case HIGH_BIT_DEPTH_STACKED:
         {
-            pixels = _mm_srl_epi16(pixels, downshift_bits);
+            pixels = _mm_srl_epi16(pixels, output_bits);
             __m128i msb = _mm_srli_epi16(pixels, 8);
             msb = _mm_packus_epi16(msb, msb);
             _mm_storel_epi64((__m128i*)dst, msb);
@@ -291,8 +226,20 @@ static int __forceinline store_pixels(
         }
         break;
     case HIGH_BIT_DEPTH_INTERLEAVED:
-        pixels = _mm_srl_epi16(pixels, downshift_bits);
-        _mm_store_si128((__m128i*)dst, pixels);
+    case HIGH_BIT_DEPTH_INTERLEAVED_MSB:
+        if (output_mode == HIGH_BIT_DEPTH_INTERLEAVED_MSB)
+        {
+            // internal precision is MSB-aligned, only the bits below output depth are cleared
+            pixels = _mm_and_si128(pixels, output_bits);
+        } else {
+            pixels = _mm_srl_epi16(pixels, output_bits);
+        }
+        if (LIKELY(dst_aligned))
+        {
+            _mm_store_si128((__m128i*)dst, pixels);
+        } else {
+            _mm_storeu_si128((__m128i*)dst, pixels);
+        }
         return 16;
         break;
     default:
@@ -301,6 +248,30 @@ static int __forceinline store_pixels(
     return 0;
 }
 
+// only stores pixels [first_pixel, last_pixel) of the 8 pixels, 
+// for blocks on the edges of a region that doesn't cover the whole row
+template <PIXEL_MODE output_mode>
+static void store_partial_pixels(
+    __m128i pixels,
+    __m128i output_bits,
+    unsigned char* dst,
+    int dst_pitch,
+    int height_in_pixels,
+    int first_pixel,
+    int last_pixel)
+{
+    // stacked: MSB in the first 8 bytes, LSB in the last 8 bytes
+    __declspec(align(16))
+    unsigned char buffer[32];
+    store_pixels<output_mode>(pixels, output_bits, buffer, 16, 1);
+
+    int pixel_size = get_pixel_size(output_mode);
+    memcpy(dst + first_pixel * pixel_size, buffer + first_pixel * pixel_size, (last_pixel - first_pixel) * pixel_size);
+    if (output_mode == HIGH_BIT_DEPTH_STACKED)
+    {
+        memcpy(dst + dst_pitch * height_in_pixels + first_pixel, buffer + 16 + first_pixel, last_pixel - first_pixel);
+    }
+}
 
 template<bool aligned>
 static __m128i load_m128(const unsigned char *ptr)
@@ -339,6 +310,9 @@ static __m128i __forceinline read_pixels(
     case HIGH_BIT_DEPTH_INTERLEAVED:
         ret = load_m128<aligned>(ptr);
         break;
+    case HIGH_BIT_DEPTH_INTERLEAVED_MSB:
+        // already in the internal precision
+        return load_m128<aligned>(ptr);
     default:
         abort();
     }
@@ -364,6 +338,7 @@ static unsigned short __forceinline read_pixel(
         return *ptr << 8 | *(ptr + plane_height_in_pixels * src_pitch);
         break;
     case HIGH_BIT_DEPTH_INTERLEAVED:
+    case HIGH_BIT_DEPTH_INTERLEAVED_MSB:
         return *(unsigned short*)ptr;
         break;
     default:
@@ -374,18 +349,22 @@ static unsigned short __forceinline read_pixel(
 
 }
 
-template <int dither_algo>
+template <int dither_algo, PIXEL_MODE input_mode>
 static __m128i __forceinline load_reference_pixels(
     __m128i shift,
     const unsigned short src[8])
 {
     __m128i ret = _mm_load_si128((const __m128i*)src);
-    ret = _mm_sll_epi16(ret, shift);
+    if (input_mode != HIGH_BIT_DEPTH_INTERLEAVED_MSB)
+    {
+        ret = _mm_sll_epi16(ret, shift);
+    }
     return ret;
 }
 
 
-template<int sample_mode, int dither_algo, PIXEL_MODE input_mode>
+// partial: only the first pixel_count pixels are read, the others are set to 0
+template<int sample_mode, int dither_algo, PIXEL_MODE input_mode, bool partial>
 static void __forceinline read_reference_pixels(
     const process_plane_params& params,
     __m128i shift,
@@ -394,7 +373,8 @@ static void __forceinline read_reference_pixels(
     __m128i& ref_pixels_1_0,
     __m128i& ref_pixels_2_0,
     __m128i& ref_pixels_3_0,
-    __m128i& ref_pixels_4_0)
+    __m128i& ref_pixels_4_0,
+    int pixel_count)
 {
     __declspec(align(16))
     unsigned short tmp_1[8];
@@ -420,10 +400,16 @@ static void __forceinline read_reference_pixels(
     int src_pitch = params.src_pitch;
 
     int i_fix = 0;
-    int i_fix_step = (input_mode != HIGH_BIT_DEPTH_INTERLEAVED ? 1 : 2);
+    int i_fix_step = get_pixel_size(input_mode);
     
     for (int i = 0; i < 8; i++)
     {
+        if (partial && i >= pixel_count)
+        {
+            // pixels outside the plane use offset 0, which would read past the end of the row
+            tmp_1[i] = tmp_2[i] = tmp_3[i] = tmp_4[i] = 0;
+            continue;
+        }
         switch (sample_mode)
         {
         case 0:
@@ -446,50 +432,243 @@ static void __forceinline read_reference_pixels(
     switch (sample_mode)
     {
     case 0:
-        ref_pixels_1_0 = load_reference_pixels<dither_algo>(shift, tmp_1);
+        ref_pixels_1_0 = load_reference_pixels<dither_algo, input_mode>(shift, tmp_1);
         break;
     case 1:
-        ref_pixels_1_0 = load_reference_pixels<dither_algo>(shift, tmp_1);
-        ref_pixels_2_0 = load_reference_pixels<dither_algo>(shift, tmp_2);
+        ref_pixels_1_0 = load_reference_pixels<dither_algo, input_mode>(shift, tmp_1);
+        ref_pixels_2_0 = load_reference_pixels<dither_algo, input_mode>(shift, tmp_2);
         break;
     case 2:
-        ref_pixels_1_0 = load_reference_pixels<dither_algo>(shift, tmp_1);
-        ref_pixels_2_0 = load_reference_pixels<dither_algo>(shift, tmp_2);
-        ref_pixels_3_0 = load_reference_pixels<dither_algo>(shift, tmp_3);
-        ref_pixels_4_0 = load_reference_pixels<dither_algo>(shift, tmp_4);
+        ref_pixels_1_0 = load_reference_pixels<dither_algo, input_mode>(shift, tmp_1);
+        ref_pixels_2_0 = load_reference_pixels<dither_algo, input_mode>(shift, tmp_2);
+        ref_pixels_3_0 = load_reference_pixels<dither_algo, input_mode>(shift, tmp_3);
+        ref_pixels_4_0 = load_reference_pixels<dither_algo, input_mode>(shift, tmp_4);
         break;
     }
 }
 
+// reads the first pixel_count pixels of a block without touching anything beyond them
+template<PIXEL_MODE input_mode>
+static __m128i read_partial_pixels(
+    const process_plane_params& params,
+    const unsigned char *ptr, 
+    __m128i upsample_shift,
+    int pixel_count)
+{
+    __declspec(align(16))
+    unsigned short buffer[8] = {0};
+
+    int pixel_step = get_pixel_size(input_mode);
+    for (int i = 0; i < pixel_count; i++)
+    {
+        buffer[i] = read_pixel<input_mode>(params.plane_height_in_pixels, params.src_pitch, ptr, i * pixel_step);
+    }
+    __m128i ret = _mm_load_si128((const __m128i*)buffer);
+    if (input_mode != HIGH_BIT_DEPTH_INTERLEAVED_MSB)
+    {
+        ret = _mm_sll_epi16(ret, upsample_shift);
+    }
+    return ret;
+}
+
+// reads source and reference pixels of a block
+// pixel_count < 8 only for the last block of rows where reading a whole block would go past the end of the plane
+template<int sample_mode, int dither_algo, PIXEL_MODE input_mode, bool aligned>
+static __m128i __forceinline read_block(
+    const process_plane_params& params,
+    __m128i upsample_shift,
+    const unsigned char* src_px,
+    const char* info_data_start,
+    __m128i& ref_pixels_1_0,
+    __m128i& ref_pixels_2_0,
+    __m128i& ref_pixels_3_0,
+    __m128i& ref_pixels_4_0,
+    int pixel_count)
+{
+    if (LIKELY(pixel_count == 8))
+    {
+        read_reference_pixels<sample_mode, dither_algo, input_mode, false>(
+            params, upsample_shift, src_px, info_data_start, ref_pixels_1_0, ref_pixels_2_0, ref_pixels_3_0, ref_pixels_4_0, 8);
+        return read_pixels<input_mode, aligned>(params, src_px, upsample_shift);
+    }
+    read_reference_pixels<sample_mode, dither_algo, input_mode, true>(
+        params, upsample_shift, src_px, info_data_start, ref_pixels_1_0, ref_pixels_2_0, ref_pixels_3_0, ref_pixels_4_0, pixel_count);
+    return read_partial_pixels<input_mode>(params, src_px, upsample_shift, pixel_count);
+}
+
+// first row whose last block can't be read as a whole block, because it would go past the end of the plane.
+// Other rows may read a few bytes past their end, those are still inside the plane (padding or the next row)
+// and only affect pixels outside the plane, so input planes don't need any guard bytes.
+static int get_first_partial_read_row(const process_plane_params& params)
+{
+    int pixel_size = get_pixel_size(params.input_mode);
+    int row_size = params.plane_width_in_pixels * pixel_size;
+    int over_read = (((params.plane_width_in_pixels - 1) | 7) + 1) * pixel_size - row_size;
+    if (over_read == 0)
+    {
+        return params.plane_height_in_pixels;
+    }
+    if (params.src_pitch <= 0)
+    {
+        return 0;
+    }
+    // bytes after the end of row r: (height - 1 - r) * pitch
+    int partial_rows = (over_read + params.src_pitch - 1) / params.src_pitch;
+    int first_row = params.plane_height_in_pixels - partial_rows;
+    return first_row > 0 ? first_row : 0;
+}
+
+// Source rows converted to 16-bit, MSB-aligned pixels, so each source pixel is converted once instead of 
+// on every read, and all reads use the interleaved layout. 
+// The buffer is a ring of the 2 * reference_rows + 1 rows that can be referenced from the current row.
+// Every row is stored twice, in slot (row % ring_rows) and slot (row % ring_rows + ring_rows), so the rows 
+// around the current row are always in consecutive slots and reference offsets can use the staging pitch.
+typedef struct _source_staging
+{
+    unsigned char* buffer;
+    int pitch;
+    int ring_rows;
+    // rows before this are staged
+    int staged_end;
+    // only columns that can be read when processing [col_begin, col_end) are staged,
+    // column_begin is a multiple of 8
+    int column_begin;
+    int column_end;
+    bool own_buffer;
+} source_staging;
+
+// input_mode is LOW_BIT_DEPTH or HIGH_BIT_DEPTH_STACKED
+template<PIXEL_MODE input_mode>
+static void stage_source_row(const process_plane_params& params, __m128i upsample_shift, const source_staging& staging, int row, unsigned char* dst_1, unsigned char* dst_2)
+{
+    const unsigned char* src = params.src_plane_ptr + params.src_pitch * row;
+    int width = staging.column_end;
+    int x = staging.column_begin;
+    for (; x + 8 <= width; x += 8)
+    {
+        __m128i pixels = read_pixels<input_mode, false>(params, src + x, upsample_shift);
+        _mm_store_si128((__m128i*)(dst_1 + x * 2), pixels);
+        _mm_store_si128((__m128i*)(dst_2 + x * 2), pixels);
+    }
+    if (x < width)
+    {
+        // the rest of the block is cleared, it is either padding of the last block or never read
+        __m128i pixels = read_partial_pixels<input_mode>(params, src + x, upsample_shift, width - x);
+        _mm_store_si128((__m128i*)(dst_1 + x * 2), pixels);
+        _mm_store_si128((__m128i*)(dst_2 + x * 2), pixels);
+    }
+}
+
+// returns false if rows can't be staged, reads go to the source plane in that case
+static bool init_source_staging(const process_plane_params& params, source_staging& staging)
+{
+    staging.buffer = NULL;
+    staging.own_buffer = false;
+    staging.pitch = params.get_staging_pitch();
+    staging.ring_rows = params.reference_rows * 2 + 1;
+    staging.staged_end = params.row_begin - params.reference_rows;
+    if (staging.staged_end < 0)
+    {
+        staging.staged_end = 0;
+    }
+    staging.column_begin = ((params.col_begin & ~7) - params.reference_columns) & ~7;
+    if (staging.column_begin < 0)
+    {
+        staging.column_begin = 0;
+    }
+    staging.column_end = (((params.col_end - 1) | 7) + 1) + params.reference_columns;
+    if (staging.column_end > params.plane_width_in_pixels)
+    {
+        staging.column_end = params.plane_width_in_pixels;
+    }
+
+    if (get_pixel_size(params.input_mode) == 2 || staging.pitch > 32767 || params.disable_staging)
+    {
+        // already in the staged layout / pitch doesn't fit in the offset calculation / not enough memory budget
+        return false;
+    }
+    staging.buffer = (unsigned char*)params.staging_buffer;
+    if (!staging.buffer)
+    {
+        staging.buffer = (unsigned char*)_aligned_malloc(params.get_staging_buffer_size(), FRAME_LUT_ALIGNMENT);
+        staging.own_buffer = true;
+    }
+    return staging.buffer != NULL;
+}
+
+static void destroy_source_staging(source_staging& staging)
+{
+    if (staging.own_buffer)
+    {
+        _aligned_free(staging.buffer);
+    }
+}
+
+// stages all rows that can be referenced from row, returns the staged row
+static __forceinline const unsigned char* stage_source_rows(const process_plane_params& params, __m128i upsample_shift, source_staging& staging, int row)
+{
+    int last_row = row + params.reference_rows;
+    if (last_row >= params.plane_height_in_pixels)
+    {
+        last_row = params.plane_height_in_pixels - 1;
+    }
+    for (; staging.staged_end <= last_row; staging.staged_end++)
+    {
+        int slot = staging.staged_end % staging.ring_rows;
+        unsigned char* dst_1 = staging.buffer + staging.pitch * slot;
+        unsigned char* dst_2 = dst_1 + staging.pitch * staging.ring_rows;
+        if (params.input_mode == LOW_BIT_DEPTH)
+        {
+            stage_source_row<LOW_BIT_DEPTH>(params, upsample_shift, staging, staging.staged_end, dst_1, dst_2);
+        } else {
+            stage_source_row<HIGH_BIT_DEPTH_STACKED>(params, upsample_shift, staging, staging.staged_end, dst_1, dst_2);
+        }
+    }
+    // slots of rows (row - reference_rows) ~ (row + reference_rows) are consecutive from the first one
+    int first_slot = (row - params.reference_rows + staging.ring_rows) % staging.ring_rows;
+    return staging.buffer + staging.pitch * (first_slot + params.reference_rows);
+}
 
 template<int sample_mode, bool blur_first, int dither_algo, bool aligned, PIXEL_MODE output_mode>
 static void __cdecl _process_plane_sse_impl(const process_plane_params& params, process_plane_context* context)
 {
     assert(sample_mode > 0);
 
-    DUMP_INIT("sse", params.plane, params.plane_width_in_pixels);
+    __m128i upsample_to_16_shift_bits;
+
+    // unused for MSB-aligned input
+    upsample_to_16_shift_bits = _mm_set_epi32(0, 0, 0, 16 - params.input_depth);
 
-    pixel_dither_info* info_ptr = params.info_ptr_base;
+    source_staging staging;
+    bool staged = init_source_staging(params, staging);
 
-    __m128i src_pitch_vector = _mm_set1_epi32(params.src_pitch);
+    // madd works on signed words
+    assert(params.src_pitch >= -32768 && params.src_pitch <= 32767);
+    int pixel_step = get_pixel_size(params.input_mode);
+    int read_pitch = params.src_pitch;
+    if (staged)
+    {
+        pixel_step = 2;
+        read_pitch = staging.pitch;
+    }
+    __m128i pitch_step_vector = _mm_set1_epi32((pixel_step << 16) | (read_pitch & 0xffff));
            
     __m128i threshold_vector = _mm_set1_epi16(params.threshold);
 
-    __m128i sign_convert_vector = _mm_set1_epi8(0x80u);
+    __declspec(align(16))
+    char info_data_block[64];
 
-    // general-purpose constant
-    __m128i minus_one = _mm_set1_epi32(-1);
+    DUMP_INIT("sse", params.plane, params.plane_width_in_pixels);
 
-    __m128i one_i8 = _mm_set1_epi8(1);
-    
     __declspec(align(16))
-    char context_buffer[DITHER_CONTEXT_BUFFER_SIZE];
+    char local_context_buffer[DITHER_CONTEXT_BUFFER_SIZE];
+    char* context_buffer = params.dither_context ? params.dither_context : local_context_buffer;
 
-    dither_high::init<dither_algo>(context_buffer, params.plane_width_in_pixels, params.output_depth);
+    if (!params.dither_context || params.row_begin == 0)
+    {
+        dither_high::init<dither_algo>(context_buffer, params.col_end - params.col_begin, params.output_depth, params.scratch_buffer);
+    }
 
-    
-    __m128i width_subsample_vector = _mm_set_epi32(0, 0, 0, params.width_subsampling);
-    __m128i height_subsample_vector = _mm_set_epi32(0, 0, 0, params.height_subsampling);
 
     bool need_clamping =  INTERNAL_BIT_DEPTH < 16 || 
                           params.pixel_min > 0 || 
@@ -503,64 +682,56 @@ static void __cdecl _process_plane_sse_impl(const process_plane_params& params,
         clamp_high_add = _mm_sub_epi16(_mm_set1_epi16((short)0xffff), _mm_set1_epi16((short)params.pixel_max));
         clamp_high_sub = _mm_add_epi16(clamp_high_add, clamp_low);
     }
-    
-    __m128i pixel_step_shift_bits;
-    __m128i upsample_to_16_shift_bits;
 
-    if (params.input_mode == HIGH_BIT_DEPTH_INTERLEAVED)
+    __m128i output_bits;
+    if (output_mode == HIGH_BIT_DEPTH_INTERLEAVED_MSB)
     {
-        pixel_step_shift_bits = _mm_set_epi32(0, 0, 0, 1);
+        output_bits = _mm_set1_epi16((short)(0xffff << (16 - params.output_depth)));
     } else {
-        pixel_step_shift_bits = _mm_setzero_si128();
+        output_bits = _mm_set_epi32(0, 0, 0, 16 - params.output_depth);
     }
-    upsample_to_16_shift_bits = _mm_set_epi32(0, 0, 0, 16 - params.input_depth);
 
-    __m128i downshift_bits = _mm_set_epi32(0, 0, 0, 16 - params.output_depth);
+    const int offset_cache_block_size = (sample_mode == 2 ? 32 : 8);
 
-    bool use_cached_info = false;
-    info_cache *cache = NULL;
-    char* info_data_stream = NULL;
+    int input_mode = params.input_mode;
 
-    __declspec(align(16))
-    char dummy_info_buffer[128];
-
-    // initialize storage for pre-calculated pixel offsets
-    if (context->data) {
-        cache = (info_cache*) context->data;
-        // we need to ensure src_pitch is the same, otherwise offsets will be completely wrong
-        // also, if pitch changes, don't waste time to update the cache since it is likely to change again
-        if (cache->pitch == params.src_pitch) {
-            info_data_stream = cache->data_stream;
-            use_cached_info = true;
-        } else {
-            // info_data_stream can be NULL, in this case dummy_info_buffer will be used for temporary storage
-        }
-        cache = NULL;
-    } else {
-        // set up buffer for cache
-        cache = (info_cache*)malloc(sizeof(info_cache));
-        // 4 offsets (2 bytes per item) + 2-byte change
-        info_data_stream = (char*)_aligned_malloc(params.info_stride * (4 * 2 + 2) * params.get_src_height(), FRAME_LUT_ALIGNMENT);
-        cache->data_stream = info_data_stream;
-        cache->pitch = params.src_pitch;
-    }
+    // blocks start on multiples of 8 pixels so LUTs and the grain buffer stay aligned,
+    // pixels of the edge blocks that are outside [col_begin, col_end) are processed but not stored,
+    // so nothing is written past the end of the rows and dst doesn't need any padding
+    int first_block_column = params.col_begin & ~7;
+    int head_pixels = params.col_begin - first_block_column;
+    bool mask_tail = (params.col_end & 7) != 0;
+    int tail_block_column = params.col_end & ~7;
+    int tail_pixels = params.col_end & 7;
 
-    const int info_cache_block_size = (sample_mode == 2 ? 64 : 32);
+    bool dst_aligned = ((POINTER_INT)params.dst_plane_ptr & (PLANE_ALIGNMENT - 1)) == 0 && 
+                       (params.dst_pitch & (PLANE_ALIGNMENT - 1)) == 0;
 
-    int input_mode = params.input_mode;
+    int dst_pixel_step = get_pixel_size(output_mode);
 
-    for (int row = 0; row < params.plane_height_in_pixels; row++)
+    int last_block_column = (params.plane_width_in_pixels - 1) & ~7;
+    int last_block_pixels = params.plane_width_in_pixels - last_block_column;
+    // staged rows are padded to whole blocks
+    int first_partial_read_row = staged ? params.plane_height_in_pixels : get_first_partial_read_row(params);
+
+    for (int row = params.row_begin; row < params.row_end; row++)
     {
-        const unsigned char* src_px = params.src_plane_ptr + params.src_pitch * row;
-        unsigned char* dst_px = params.dst_plane_ptr + params.dst_pitch * row;
+        const unsigned char* src_px;
+        if (staged)
+        {
+            src_px = stage_source_rows(params, upsample_to_16_shift_bits, staging, row) + first_block_column * 2;
+        } else {
+            src_px = params.src_plane_ptr + params.src_pitch * row + first_block_column * pixel_step;
+        }
+        unsigned char* dst_px = params.dst_plane_ptr + params.dst_pitch * row + first_block_column * dst_pixel_step;
 
-        info_ptr = params.info_ptr_base + params.info_stride * row;
+        const signed char* offset_cache_ptr = params.offset_cache + params.offset_cache_stride * row + first_block_column / 8 * offset_cache_block_size;
 
-        const short* grain_buffer_ptr = params.grain_buffer + params.grain_buffer_stride * row;
+        const short* grain_buffer_ptr = params.grain_buffer + params.grain_buffer_stride * row + first_block_column;
 
-        int processed_pixels = 0;
+        int processed_pixels = first_block_column;
 
-        while (processed_pixels < params.plane_width_in_pixels)
+        while (processed_pixels < params.col_end)
         {
             __m128i change_1;
             
@@ -569,7 +740,7 @@ static void __cdecl _process_plane_sse_impl(const process_plane_params& params,
             __m128i ref_pixels_3_0;
             __m128i ref_pixels_4_0;
 
-#define READ_REFS(data_stream, inp_mode) read_reference_pixels<sample_mode, dither_algo, inp_mode>( \
+#define READ_BLOCK(data_stream, inp_mode, pixel_count) read_block<sample_mode, dither_algo, inp_mode, aligned>( \
                     params, \
                     upsample_to_16_shift_bits, \
                     src_px, \
@@ -577,54 +748,37 @@ static void __cdecl _process_plane_sse_impl(const process_plane_params& params,
                     ref_pixels_1_0, \
                     ref_pixels_2_0, \
                     ref_pixels_3_0, \
-                    ref_pixels_4_0)
-
-            char * data_stream_block_start;
-
-            if (LIKELY(use_cached_info)) {
-                data_stream_block_start = info_data_stream;
-                info_data_stream += info_cache_block_size;
-            } else {
-                // we need to process the info block
+                    ref_pixels_4_0, \
+                    pixel_count)
 
-                char * data_stream_ptr = info_data_stream;
-                if (!data_stream_ptr)
-                {
-                    data_stream_ptr = dummy_info_buffer;
-                }
-
-                data_stream_block_start = data_stream_ptr;
-            
-    #define PROCESS_INFO_BLOCK(n) \
-                process_plane_info_block<sample_mode, n>(info_ptr, src_px, src_pitch_vector, minus_one, width_subsample_vector, height_subsample_vector, pixel_step_shift_bits, data_stream_ptr);
-            
-                PROCESS_INFO_BLOCK(0);
-                PROCESS_INFO_BLOCK(1);
-
-    #undef PROCESS_INFO_BLOCK
-                
-                if (info_data_stream) {
-                    info_data_stream += info_cache_block_size;
-                    assert(info_data_stream == data_stream_ptr);
-                }
+            expand_ref_offsets<sample_mode>(offset_cache_ptr, pitch_step_vector, info_data_block);
+            offset_cache_ptr += offset_cache_block_size;
 
+            int read_pixel_count = 8;
+            if (UNLIKELY(row >= first_partial_read_row && processed_pixels == last_block_column))
+            {
+                read_pixel_count = last_block_pixels;
             }
 
             __m128i src_pixels;
-            // abuse the guard bytes on the end of frame, as long as they are present there won't be segfault
-            // garbage data is not a problem
-            if (LIKELY(input_mode == LOW_BIT_DEPTH))
+            if (LIKELY(staged))
             {
-                READ_REFS(data_stream_block_start, LOW_BIT_DEPTH);
-                src_pixels = read_pixels<LOW_BIT_DEPTH, aligned>(params, src_px, upsample_to_16_shift_bits);
+                // staging buffer is always aligned, staged pixels are already MSB-aligned
+                src_pixels = read_block<sample_mode, dither_algo, HIGH_BIT_DEPTH_INTERLEAVED_MSB, true>(
+                    params, upsample_to_16_shift_bits, src_px, info_data_block, 
+                    ref_pixels_1_0, ref_pixels_2_0, ref_pixels_3_0, ref_pixels_4_0, read_pixel_count);
+            } else if (input_mode == LOW_BIT_DEPTH)
+            {
+                src_pixels = READ_BLOCK(info_data_block, LOW_BIT_DEPTH, read_pixel_count);
             } else if (input_mode == HIGH_BIT_DEPTH_INTERLEAVED)
             {
-                READ_REFS(data_stream_block_start, HIGH_BIT_DEPTH_INTERLEAVED);
-                src_pixels = read_pixels<HIGH_BIT_DEPTH_INTERLEAVED, aligned>(params, src_px, upsample_to_16_shift_bits);
+                src_pixels = READ_BLOCK(info_data_block, HIGH_BIT_DEPTH_INTERLEAVED, read_pixel_count);
+            } else if (input_mode == HIGH_BIT_DEPTH_INTERLEAVED_MSB)
+            {
+                src_pixels = READ_BLOCK(info_data_block, HIGH_BIT_DEPTH_INTERLEAVED_MSB, read_pixel_count);
             } else if (input_mode == HIGH_BIT_DEPTH_STACKED)
             {
-                READ_REFS(data_stream_block_start, HIGH_BIT_DEPTH_STACKED);
-                src_pixels = read_pixels<HIGH_BIT_DEPTH_STACKED, aligned>(params, src_px, upsample_to_16_shift_bits);
+                src_pixels = READ_BLOCK(info_data_block, HIGH_BIT_DEPTH_STACKED, read_pixel_count);
             } else {
                 abort();
                 return;
@@ -654,30 +808,40 @@ static void __cdecl _process_plane_sse_impl(const process_plane_params& params,
                                      need_clamping, 
                                      row, 
                                      processed_pixels, 
+                                     processed_pixels == first_block_column ? head_pixels : 0,
                                      context_buffer);
 
-            dst_px += store_pixels<output_mode>(dst_pixels, downshift_bits, dst_px, params.dst_pitch, params.plane_height_in_pixels);
+            bool is_head = processed_pixels == first_block_column && head_pixels != 0;
+            bool is_tail = mask_tail && processed_pixels == tail_block_column;
+            if (UNLIKELY(is_head || is_tail))
+            {
+                store_partial_pixels<output_mode>(
+                    dst_pixels, 
+                    output_bits, 
+                    dst_px, 
+                    params.dst_pitch, 
+                    params.plane_height_in_pixels,
+                    is_head ? head_pixels : 0,
+                    is_tail ? tail_pixels : 8);
+            } else {
+                store_pixels<output_mode>(dst_pixels, output_bits, dst_px, params.dst_pitch, params.plane_height_in_pixels, dst_aligned);
+            }
+            dst_px += 8 * dst_pixel_step;
             processed_pixels += 8;
-            src_px += params.input_mode != HIGH_BIT_DEPTH_INTERLEAVED ? 8 : 16;
+            src_px += 8 * pixel_step;
             grain_buffer_ptr += 8;
         }
         DUMP_NEXT_LINE();
         dither_high::next_row<dither_algo>(context_buffer);
     }
     
-    dither_high::complete<dither_algo>(context_buffer);
-
-    // for thread-safety, save context after all data is processed
-    if (!use_cached_info && !context->data && cache)
+    if (!params.dither_context || params.row_end == params.plane_height_in_pixels)
     {
-        context->destroy = destroy_cache;
-        if (InterlockedCompareExchangePointer(&context->data, cache, NULL) != NULL)
-        {
-            // other thread has completed first, so we can destroy our copy
-            destroy_cache(cache);
-        }
+        dither_high::complete<dither_algo>(context_buffer);
     }
 
+    destroy_source_staging(staging);
+
     DUMP_FINISH();
 }
 
@@ -696,6 +860,9 @@ static void process_plane_sse_impl_stub1(const process_plane_params& params, pro
     case HIGH_BIT_DEPTH_INTERLEAVED:
         _process_plane_sse_impl<sample_mode, blur_first, dither_algo, aligned, HIGH_BIT_DEPTH_INTERLEAVED>(params, context);
         break;
+    case HIGH_BIT_DEPTH_INTERLEAVED_MSB:
+        _process_plane_sse_impl<sample_mode, blur_first, dither_algo, aligned, HIGH_BIT_DEPTH_INTERLEAVED_MSB>(params, context);
+        break;
     default:
         abort();
     }
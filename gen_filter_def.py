@@ -34,6 +34,9 @@ def generate_output():
           default_value="DEFAULT_RANDOM_PARAM"),
         p("f", "random_param_grain",
           default_value="DEFAULT_RANDOM_PARAM"),
+        p("i", "prefetch", scope=["avisynth"]),
+        p("i", "memory_budget", default_value=0),
+        p("b", "large_pages", default_value="false"),
     )
 
     def _generate(file_name, template, scope):
@@ -193,7 +196,7 @@ OUTPUT_TEMPLATE_VAPOURSYNTH = """
 #include "plugin.h"
 #include "VapourSynth.h"
 
-static const char* F3KDB_VAPOURSYNTH_PARAMS = "clip:clip;{vapoursynth_params}";
+static const char* F3KDB_VAPOURSYNTH_PARAMS = "clip:clip;{vapoursynth_params}planes:int[]:opt;";
 
 static bool f3kdb_params_from_vs(f3kdb_params_t* f3kdb_params, const VSMap* in, VSMap* out, const VSAPI* vsapi)
 {{
@@ -3,14 +3,26 @@
 #include "f3kdb_enums.h"
 #include "f3kdb_params.h"
 
-// Input plane can be unaligned, but all output planes need to be aligned to 16-byte boundary
+// Planes can be unaligned and don't need any padding after their rows, 
+// nothing past the end of the rows is read or written.
+// Processing is faster if planes and pitches are aligned to PLANE_ALIGNMENT.
 static const int PLANE_ALIGNMENT = 16;
 
 enum {
     // Supposed to be the same as corresponding values in avisynth
     PLANE_Y = 1<<0,
     PLANE_CB = 1<<1,
-    PLANE_CR = 1<<2
+    PLANE_CR = 1<<2,
+    // planes of COLOR_FAMILY_RGB video
+    PLANE_R = PLANE_Y,
+    PLANE_G = PLANE_CB,
+    PLANE_B = PLANE_CR,
+    // Semi-planar chroma (NV12, P010, P016...), Cb and Cr samples alternate in one plane.
+    // Each component is processed as if it were PLANE_CB or PLANE_CR, with the same output.
+    // Only accepted by f3kdb_process_plane, pitch is in bytes of the whole interleaved row.
+    // Rows are split into planar components and interleaved again a few rows at a time, 
+    // which saves the caller full-size planar copies but isn't faster than processing them.
+    PLANE_CBCR = PLANE_CB | PLANE_CR
 };
 typedef struct _f3kdb_video_info_t
 {
@@ -28,6 +40,10 @@ typedef struct _f3kdb_video_info_t
     // Can be set to an estimated number if unknown when initializing
     int num_frames;
 
+    // RGB planes share the reference positions of the R plane, thresholds are Y, Cb and Cr for R, G and B,
+    // grain is grainY for R and grainC for G and B, independent for each plane
+    COLOR_FAMILY color_family;
+
     inline int get_plane_width(int plane)
     {
         return plane == PLANE_Y ? width : width >> chroma_width_subsampling;
@@ -39,9 +55,28 @@ typedef struct _f3kdb_video_info_t
     }
 } f3kdb_video_info_t;
 
+// Memory held by a core in bytes, see f3kdb_get_memory_usage
+typedef struct _f3kdb_memory_usage_t
+{
+    // reference positions and grain of every pixel
+    size_t pixel_info;
+    // reference positions in the layout read by SIMD implementations
+    size_t offset_cache;
+    // grain of every pixel, 3 frames worth with dynamic_grain
+    size_t grain_buffer;
+    // grain position of every frame, only with dynamic_grain
+    size_t frame_offsets;
+    // buffers lent to processing calls, one of each kind for every call that ran concurrently
+    size_t scratch_buffer;
+    size_t staging_buffer;
+
+    size_t total;
+} f3kdb_memory_usage_t;
+
 static const int F3KDB_INTERFACE_VERSION = 2 << 16 | sizeof(f3kdb_params_t) << 8 | sizeof(f3kdb_video_info_t);
 
 class f3kdb_core_t;
+class f3kdb_stream_t;
 
 enum
 {
@@ -59,10 +94,16 @@ enum
     F3KDB_ERROR_MAX
 };
 
+#ifdef _WIN32
 #define F3KDB_CC __stdcall
+#define F3KDB_EXPORT __declspec(dllexport)
+#else
+#define F3KDB_CC
+#define F3KDB_EXPORT __attribute__((visibility("default")))
+#endif
 
 #ifdef FLASH3KYUU_DEBAND_EXPORTS
-#define F3KDB_API(ret) extern "C" __declspec(dllexport) ret F3KDB_CC
+#define F3KDB_API(ret) extern "C" F3KDB_EXPORT ret F3KDB_CC
 #else
 #define F3KDB_API(ret) extern "C" ret F3KDB_CC
 #endif
@@ -73,4 +114,62 @@ F3KDB_API(int) f3kdb_params_sanitize(f3kdb_params_t* params, int interface_versi
 F3KDB_API(int) f3kdb_video_info_sanitize(f3kdb_video_info_t* vi, int interface_version = F3KDB_INTERFACE_VERSION);
 F3KDB_API(int) f3kdb_create(const f3kdb_video_info_t* video_info, const f3kdb_params_t* params, f3kdb_core_t** core_out, char* extra_error_msg = nullptr, size_t error_msg_size = 0, int interface_version = F3KDB_INTERFACE_VERSION);
 F3KDB_API(int) f3kdb_destroy(f3kdb_core_t* core);
+// dst_frame_ptr may be the same as src_frame_ptr (with the same pitch) to process the plane in place,
+// only a few rows of the original plane are kept in a temporary buffer in that case.
+// In-place processing needs output_mode to be the same as the pixel mode of the input, and doesn't support stacked planes.
+// Other functions need separate source and destination planes.
 F3KDB_API(int) f3kdb_process_plane(f3kdb_core_t* core, int frame_index, int plane, unsigned char* dst_frame_ptr, int dst_pitch, const unsigned char* src_frame_ptr, int src_pitch);
+
+// Processes only the pixels inside the rectangle (x, y, width, height) of the plane, in pixels of the plane.
+// src_frame_ptr and dst_frame_ptr point to the whole planes as in f3kdb_process_plane, 
+// pixels around the rectangle are used as references and pixels outside it in dst are left untouched.
+// Output is identical to the corresponding part of f3kdb_process_plane, except with Floyd-Steinberg dithering,
+// whose error diffusion starts at the top-left corner of the rectangle.
+// Float input or output (HIGH_BIT_DEPTH_FLOAT) is not supported.
+F3KDB_API(int) f3kdb_process_plane_rect(f3kdb_core_t* core, int frame_index, int plane, unsigned char* dst_frame_ptr, int dst_pitch, const unsigned char* src_frame_ptr, int src_pitch, int x, int y, int width, int height);
+
+// Processes the Y, Cb and Cr planes of a 4:2:2 frame and writes them packed as v210 (6 pixels in 16 bytes).
+// Needs output_mode = HIGH_BIT_DEPTH_INTERLEAVED and output_depth = 10, the input can be in any integer pixel mode.
+// src_frame_ptrs and src_pitches hold the Y, Cb and Cr planes, as in f3kdb_process_plane.
+// dst_pitch must be at least (width + 5) / 6 * 16, the usual v210 pitch is (width + 47) / 48 * 128.
+// Samples past the width in the last group of a row are written as 0, the rest of the pitch is left untouched.
+// Output is the same as packing the planes from f3kdb_process_plane, without a full-frame intermediate buffer.
+F3KDB_API(int) f3kdb_process_frame_v210(f3kdb_core_t* core, int frame_index, unsigned char* dst_frame_ptr, int dst_pitch, const unsigned char* const* src_frame_ptrs, const int* src_pitches);
+
+// Sets *passthrough_out to 1 if processing the plane would only copy it, i.e. its threshold and grain are 0
+// and the output format is the same as the input. Callers that can share planes between frames
+// may use the source plane instead of calling f3kdb_process_plane.
+F3KDB_API(int) f3kdb_get_plane_passthrough(f3kdb_core_t* core, int plane, int* passthrough_out);
+
+// Reports whether the lookup tables of the core ended up in large pages.
+// They are used when the large_pages param is set, the tables are big enough and the host 
+// has enabled SeLockMemoryPrivilege in the process token (on Linux, huge pages are reserved 
+// in vm.nr_hugepages), otherwise regular pages are used.
+F3KDB_API(int) f3kdb_get_lut_backing(f3kdb_core_t* core, LUT_BACKING* backing_out);
+
+// Memory currently held by the core, per category. Buffers borrowed by a call (e.g. the row window 
+// of in-place processing) stay in the core once the call returns and are included, one set for 
+// each thread that has called the core concurrently.
+// If memory_budget is set, the total is bounded by it as long as one thread at a time uses the core.
+F3KDB_API(int) f3kdb_get_memory_usage(f3kdb_core_t* core, f3kdb_memory_usage_t* usage_out);
+
+
+// Streaming interface, processes a plane while its source rows are still arriving.
+// src_frame_ptr and dst_frame_ptr point to complete planes as in f3kdb_process_plane,
+// but only the top rows of the source plane need to be filled when f3kdb_stream_push_rows is called.
+// Output is identical to f3kdb_process_plane. The destination plane must not overlap the source plane,
+// F3KDB_ERROR_INVALID_ARGUMENT is returned otherwise.
+// A stream must not be used by more than one thread at the same time, 
+// different streams of the same core can be used concurrently.
+// Float input or output (HIGH_BIT_DEPTH_FLOAT) is not supported.
+F3KDB_API(int) f3kdb_stream_begin(f3kdb_core_t* core, int frame_index, int plane, unsigned char* dst_frame_ptr, int dst_pitch, const unsigned char* src_frame_ptr, int src_pitch, f3kdb_stream_t** stream_out);
+
+// available_rows: number of rows at the top of the source plane that are ready, never decreases.
+//                 For stacked high bit-depth input, the LSB part of these rows must be ready as well.
+// rows_done_out: optional, receives the number of rows at the top of the destination plane that are complete.
+// A row is processed once range rows below it are available, the remaining rows are processed
+// when available_rows reaches the plane height.
+F3KDB_API(int) f3kdb_stream_push_rows(f3kdb_stream_t* stream, int available_rows, int* rows_done_out);
+
+// Frees the stream, it can be called before all rows are pushed
+F3KDB_API(int) f3kdb_stream_end(f3kdb_stream_t* stream);
@@ -6,9 +6,23 @@ typedef enum _PIXEL_MODE
     LOW_BIT_DEPTH = 0,
     HIGH_BIT_DEPTH_STACKED,
     HIGH_BIT_DEPTH_INTERLEAVED,
+    // 16-bit little-endian like HIGH_BIT_DEPTH_INTERLEAVED, but samples of depth bits 
+    // are stored in the high bits (P010-style), the low bits are 0 in output
+    HIGH_BIT_DEPTH_INTERLEAVED_MSB,
+    // 32-bit float samples with depth 32, luma in [0, 1] and chroma in [-0.5, 0.5].
+    // Processing is done in 16-bit, so output has 16-bit precision.
+    HIGH_BIT_DEPTH_FLOAT,
     PIXEL_MODE_COUNT
 } PIXEL_MODE;
 
+typedef enum _COLOR_FAMILY
+{
+    COLOR_FAMILY_YUV = 0,
+    // planar RGB without subsampling, R, G and B planes take the place of Y, Cb and Cr
+    COLOR_FAMILY_RGB,
+    COLOR_FAMILY_COUNT
+} COLOR_FAMILY;
+
 typedef enum _DITHER_ALGORITHM
 {
     // _DEPRECATED_DA_LOW = 0,
@@ -37,4 +51,14 @@ typedef enum _OPTIMIZATION_MODE {
     IMPL_SSE4,
 
     IMPL_COUNT
-} OPTIMIZATION_MODE;
\ No newline at end of file
+} OPTIMIZATION_MODE;
+
+// memory pages that the lookup tables of a core are allocated from, see f3kdb_get_lut_backing
+typedef enum _LUT_BACKING {
+    LUT_BACKING_REGULAR_PAGES = 0,
+    // the bigger tables are in large pages, the others are smaller than a large page
+    LUT_BACKING_MIXED,
+    LUT_BACKING_LARGE_PAGES,
+
+    LUT_BACKING_COUNT
+} LUT_BACKING;
\ No newline at end of file
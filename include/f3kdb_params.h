@@ -29,5 +29,7 @@ typedef struct _f3kdb_params_t
     RANDOM_ALGORITHM random_algo_grain; 
     double random_param_ref; 
     double random_param_grain; 
+    int memory_budget; 
+    bool large_pages; 
 } f3kdb_params_t;
 
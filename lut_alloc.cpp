@@ -0,0 +1,219 @@
+#include "stdafx.h"
+
+#include "lut_alloc.h"
+#include "constants.h"
+
+#include <assert.h>
+#include <malloc.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+// blocks are laid out as [header][table], the header is padded so the table stays aligned
+#define LUT_HEADER_SIZE FRAME_LUT_ALIGNMENT
+
+typedef struct _lut_header
+{
+    size_t allocated_size;
+    bool large_page;
+} lut_header;
+
+static_assert(sizeof(lut_header) <= LUT_HEADER_SIZE, "lut_header doesn't fit in header");
+
+// 0 = large pages are unavailable, (size_t)-1 = not checked yet
+static volatile size_t _large_page_size = (size_t)-1;
+
+#ifdef _WIN32
+// Large pages need SeLockMemoryPrivilege to be enabled in the process token. 
+// Enabling it is left to the host application, since it affects the whole process.
+static bool is_lock_memory_privilege_enabled(void)
+{
+    LUID lock_memory_luid;
+    if (!LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME, &lock_memory_luid))
+    {
+        return false;
+    }
+    HANDLE token;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY, &token))
+    {
+        return false;
+    }
+
+    bool ret = false;
+    DWORD size = 0;
+    GetTokenInformation(token, TokenPrivileges, NULL, 0, &size);
+    TOKEN_PRIVILEGES* privileges = size > 0 ? (TOKEN_PRIVILEGES*)malloc(size) : NULL;
+    if (privileges && GetTokenInformation(token, TokenPrivileges, privileges, size, &size))
+    {
+        for (DWORD i = 0; i < privileges->PrivilegeCount; i++)
+        {
+            const LUID_AND_ATTRIBUTES& privilege = privileges->Privileges[i];
+            if (privilege.Luid.LowPart == lock_memory_luid.LowPart && privilege.Luid.HighPart == lock_memory_luid.HighPart)
+            {
+                ret = (privilege.Attributes & SE_PRIVILEGE_ENABLED) != 0;
+                break;
+            }
+        }
+    }
+
+    free(privileges);
+    CloseHandle(token);
+    return ret;
+}
+
+static size_t get_system_large_page_size(void)
+{
+    size_t size = GetLargePageMinimum();
+    return size > 0 && is_lock_memory_privilege_enabled() ? size : 0;
+}
+
+// fails when physical memory is too fragmented to find free large pages
+static void* alloc_large_pages(size_t size)
+{
+    return VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+}
+
+static void free_large_pages(void* block, size_t size)
+{
+    VirtualFree(block, 0, MEM_RELEASE);
+}
+#else
+// Huge pages come from the pool reserved in vm.nr_hugepages, no privilege is needed.
+// Only the size of the default huge pages is read here, whether the pool has enough 
+// free pages is only known when allocating.
+static size_t get_system_large_page_size(void)
+{
+    size_t size = 0;
+#ifdef MAP_HUGETLB
+    FILE* meminfo = fopen("/proc/meminfo", "r");
+    if (!meminfo)
+    {
+        return 0;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), meminfo))
+    {
+        unsigned long size_kb;
+        if (sscanf(line, "Hugepagesize: %lu kB", &size_kb) == 1)
+        {
+            size = (size_t)size_kb * 1024;
+            break;
+        }
+    }
+    fclose(meminfo);
+#endif
+    return size;
+}
+
+// fails when the pool doesn't have enough free huge pages
+static void* alloc_large_pages(size_t size)
+{
+#ifdef MAP_HUGETLB
+    void* block = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    return block != MAP_FAILED ? block : NULL;
+#else
+    return NULL;
+#endif
+}
+
+static void free_large_pages(void* block, size_t size)
+{
+    munmap(block, size);
+}
+#endif
+
+static size_t get_large_page_size(void)
+{
+    // racing threads come to the same result, so no locking is needed
+    if (_large_page_size == (size_t)-1)
+    {
+        _large_page_size = get_system_large_page_size();
+    }
+    return _large_page_size;
+}
+
+// large page size if a table of size bytes is put in large pages, 0 otherwise
+static size_t get_lut_large_page_size(size_t size, bool allow_large_page)
+{
+    if (!allow_large_page)
+    {
+        return 0;
+    }
+    size_t large_page_size = get_large_page_size();
+    return size >= large_page_size ? large_page_size : 0;
+}
+
+void* lut_alloc(size_t size, bool allow_large_page)
+{
+    size_t block_size = LUT_HEADER_SIZE + size;
+    char* block = NULL;
+    bool large_page = false;
+
+    size_t large_page_size = get_lut_large_page_size(size, allow_large_page);
+    if (large_page_size > 0)
+    {
+        size_t rounded_size = (block_size + large_page_size - 1) & ~(large_page_size - 1);
+        block = (char*)alloc_large_pages(rounded_size);
+        if (block)
+        {
+            large_page = true;
+            block_size = rounded_size;
+        }
+    }
+    if (!block)
+    {
+        block = (char*)_aligned_malloc(block_size, FRAME_LUT_ALIGNMENT);
+        if (!block)
+        {
+            return NULL;
+        }
+    }
+
+    lut_header* header = (lut_header*)block;
+    header->allocated_size = block_size;
+    header->large_page = large_page;
+    return block + LUT_HEADER_SIZE;
+}
+
+void lut_free(void* ptr)
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    lut_header* header = (lut_header*)((char*)ptr - LUT_HEADER_SIZE);
+    if (header->large_page)
+    {
+        free_large_pages(header, header->allocated_size);
+    } else {
+        _aligned_free(header);
+    }
+}
+
+bool lut_is_large_page(const void* ptr)
+{
+    assert(ptr);
+    return ((const lut_header*)((const char*)ptr - LUT_HEADER_SIZE))->large_page;
+}
+
+size_t lut_get_allocated_size(const void* ptr)
+{
+    if (!ptr)
+    {
+        return 0;
+    }
+    return ((const lut_header*)((const char*)ptr - LUT_HEADER_SIZE))->allocated_size;
+}
+
+size_t lut_estimate_allocated_size(size_t size, bool allow_large_page)
+{
+    size_t block_size = LUT_HEADER_SIZE + size;
+    size_t large_page_size = get_lut_large_page_size(size, allow_large_page);
+    if (large_page_size > 0)
+    {
+        block_size = (block_size + large_page_size - 1) & ~(large_page_size - 1);
+    }
+    return block_size;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stddef.h>
+
+// Allocator for the lookup tables of a core (dither info, offset caches, grain buffers).
+// The kernels read them at scattered positions, so on large frames a regular 4 KB page 
+// mapping causes many TLB misses. Tables that are at least one large page big are put 
+// in large pages when the caller asks for it and the system allows it, everything else 
+// silently falls back to regular pages.
+// On Windows, large pages need the "Lock pages in memory" user right (SeLockMemoryPrivilege) 
+// to be enabled in the token of the process by the host, it is never enabled here.
+// On Linux, they are taken from the huge pages reserved in vm.nr_hugepages.
+
+// returns NULL if out of memory, memory is aligned to FRAME_LUT_ALIGNMENT
+void* lut_alloc(size_t size, bool allow_large_page = false);
+
+// ptr may be NULL
+void lut_free(void* ptr);
+
+// ptr must be returned by lut_alloc
+bool lut_is_large_page(const void* ptr);
+
+// bytes taken by the allocation of ptr, including rounding up to whole large pages
+// ptr may be NULL
+size_t lut_get_allocated_size(const void* ptr);
+
+// upper bound of lut_get_allocated_size for an allocation of size bytes
+size_t lut_estimate_allocated_size(size_t size, bool allow_large_page = false);
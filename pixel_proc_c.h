@@ -5,12 +5,12 @@
 #include "impl_dispatch.h"
 
 #define CALL_IMPL(func, ...) \
-	( mode == DA_HIGH_NO_DITHERING ? pixel_proc_high_no_dithering::##func(__VA_ARGS__) : \
-	  mode == DA_HIGH_ORDERED_DITHERING ? pixel_proc_high_ordered_dithering::##func(__VA_ARGS__) : \
-	  mode == DA_HIGH_FLOYD_STEINBERG_DITHERING ? pixel_proc_high_f_s_dithering::##func(__VA_ARGS__) : \
-	  mode == DA_16BIT_STACKED ? pixel_proc_16bit::##func(__VA_ARGS__) : \
-	  mode == DA_16BIT_INTERLEAVED ? pixel_proc_16bit::##func(__VA_ARGS__) : \
-	  (abort(), 0) )
+	( mode == DA_HIGH_NO_DITHERING ? pixel_proc_high_no_dithering::func(__VA_ARGS__) : \
+	  mode == DA_HIGH_ORDERED_DITHERING ? pixel_proc_high_ordered_dithering::func(__VA_ARGS__) : \
+	  mode == DA_HIGH_FLOYD_STEINBERG_DITHERING ? pixel_proc_high_f_s_dithering::func(__VA_ARGS__) : \
+	  mode == DA_16BIT_STACKED ? pixel_proc_16bit::func(__VA_ARGS__) : \
+	  mode == DA_16BIT_INTERLEAVED ? pixel_proc_16bit::func(__VA_ARGS__) : \
+	  (abort(), pixel_proc_16bit::func(__VA_ARGS__)) )
 
 #define CHECK_MODE() if (mode < 0 || mode >= DA_COUNT) abort()
 
@@ -21,10 +21,10 @@
 #include "pixel_proc_c_16bit.h"
 
 template <int mode>
-static inline void pixel_proc_init_context(char context_buffer[CONTEXT_BUFFER_SIZE], int frame_width, int output_depth)
+static inline void pixel_proc_init_context(char context_buffer[CONTEXT_BUFFER_SIZE], int frame_width, int output_depth, void* scratch_buffer = NULL)
 {
 	CHECK_MODE();
-	CALL_IMPL(init_context, context_buffer, frame_width, output_depth);
+	CALL_IMPL(init_context, context_buffer, frame_width, output_depth, scratch_buffer);
 }
 
 template <int mode>
@@ -24,7 +24,15 @@ namespace pixel_proc_high_f_s_dithering {
 #endif
     } context_t;
 
-    static inline void init_context(char context_buffer[CONTEXT_BUFFER_SIZE], int frame_width, int output_depth)
+    // size of the error buffer needed for a plane of the given width
+    // additional 2 items are placed at the beginning and the end of each row
+    static inline size_t get_error_buffer_size(int frame_width)
+    {
+        return (frame_width + 2) * 2 * sizeof(ERROR_TYPE);
+    }
+
+    // scratch_buffer: optional, at least get_error_buffer_size(frame_width) bytes, owned by the caller
+    static inline void init_context(char context_buffer[CONTEXT_BUFFER_SIZE], int frame_width, int output_depth, void* scratch_buffer = NULL)
     {
         context_t* ctx = (context_t*)context_buffer;
         int ctx_size = sizeof(context_t);
@@ -39,9 +47,11 @@ namespace pixel_proc_high_f_s_dithering {
         memset(ctx, 0, ctx_size);
 #endif
 
-        // additional 2 bytes are placed at the beginning and the end
-        int size_needed = (frame_width + 2) * 2 * sizeof(ERROR_TYPE);
-        if (CONTEXT_BUFFER_SIZE - ctx_size < size_needed)
+        int size_needed = (int)get_error_buffer_size(frame_width);
+        if (scratch_buffer)
+        {
+            ctx->error_buffer = (ERROR_TYPE*)scratch_buffer;
+        } else if (CONTEXT_BUFFER_SIZE - ctx_size < size_needed)
         {
             ctx->error_buffer = (ERROR_TYPE*)malloc(size_needed);
             ctx->buffer_needs_dealloc = true;
@@ -27,7 +27,7 @@ namespace pixel_proc_high_ordered_dithering {
     static const int THRESHOLD_MAP_RIGHT_SHIFT_BITS = 16 - INTERNAL_BIT_DEPTH;
 
 
-    static inline void init_context(char context_buffer[CONTEXT_BUFFER_SIZE], int frame_width, int output_depth)
+    static inline void init_context(char context_buffer[CONTEXT_BUFFER_SIZE], int frame_width, int output_depth, void* scratch_buffer = NULL)
     {
         *((int*)context_buffer) = output_depth;
     }
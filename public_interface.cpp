@@ -3,6 +3,7 @@
 #include <exception>
 #include <stdio.h>
 #include <stdarg.h>
+#include <limits.h>
 
 #include "compiler_compat.h"
 #include "core.h"
@@ -87,11 +88,11 @@ F3KDB_API(int) f3kdb_params_fill_by_string(f3kdb_params_t* params, const char* p
 static void sanitize_mode_and_depth(PIXEL_MODE* mode, int* depth) {
     if (*mode == DEFAULT_PIXEL_MODE)
     {
-        *mode = *depth <= 8 ? LOW_BIT_DEPTH : HIGH_BIT_DEPTH_STACKED;
+        *mode = *depth <= 8 ? LOW_BIT_DEPTH : (*depth == 32 ? HIGH_BIT_DEPTH_FLOAT : HIGH_BIT_DEPTH_STACKED);
     }
     if (*depth == -1)
     {
-        *depth = *mode == LOW_BIT_DEPTH ? 8 : 16;
+        *depth = *mode == LOW_BIT_DEPTH ? 8 : (*mode == HIGH_BIT_DEPTH_FLOAT ? 32 : 16);
     }
 }
 
@@ -157,10 +158,13 @@ F3KDB_API(int) f3kdb_create(const f3kdb_video_info_t* video_info_in, const f3kdb
     INVALID_PARAM_IF(video_info.chroma_width_subsampling < 0 || video_info.chroma_width_subsampling > 4);
     INVALID_PARAM_IF(video_info.chroma_height_subsampling < 0 || video_info.chroma_height_subsampling > 4);
     INVALID_PARAM_IF(video_info.num_frames <= 0);
-    INVALID_PARAM_IF(video_info.depth < 8 || video_info.depth > INTERNAL_BIT_DEPTH);
     INVALID_PARAM_IF(video_info.pixel_mode < 0 || video_info.pixel_mode >= PIXEL_MODE_COUNT);
+    INVALID_PARAM_IF(video_info.pixel_mode != HIGH_BIT_DEPTH_FLOAT && (video_info.depth < 8 || video_info.depth > INTERNAL_BIT_DEPTH));
+    INVALID_PARAM_IF(video_info.pixel_mode == HIGH_BIT_DEPTH_FLOAT && video_info.depth != 32);
     INVALID_PARAM_IF(video_info.pixel_mode == LOW_BIT_DEPTH && video_info.depth != 8);
     INVALID_PARAM_IF(video_info.pixel_mode != LOW_BIT_DEPTH && video_info.depth == 8);
+    INVALID_PARAM_IF(video_info.color_family < 0 || video_info.color_family >= COLOR_FAMILY_COUNT);
+    INVALID_PARAM_IF(video_info.color_family == COLOR_FAMILY_RGB && (video_info.chroma_width_subsampling != 0 || video_info.chroma_height_subsampling != 0));
 
     f3kdb_params_t params;
     memcpy(&params, params_in, sizeof(f3kdb_params_t));
@@ -177,12 +181,14 @@ F3KDB_API(int) f3kdb_create(const f3kdb_video_info_t* video_info_in, const f3kdb
         print_error(extra_error_msg, error_msg_size, "%s", "output_mode = 0 is only valid when output_depth = 8");
         return F3KDB_ERROR_INVALID_ARGUMENT;
     }
-    if (params.output_depth == 16)
+    if (params.output_depth == 16 || params.output_mode == HIGH_BIT_DEPTH_FLOAT)
     {
-        // set to appropriate precision mode
+        // set to appropriate precision mode, float output is converted from 16-bit output
         switch (params.output_mode)
         {
         case HIGH_BIT_DEPTH_INTERLEAVED:
+        case HIGH_BIT_DEPTH_INTERLEAVED_MSB:
+        case HIGH_BIT_DEPTH_FLOAT:
             params.dither_algo = DA_16BIT_INTERLEAVED;
             break;
         case HIGH_BIT_DEPTH_STACKED:
@@ -213,9 +219,14 @@ F3KDB_API(int) f3kdb_create(const f3kdb_video_info_t* video_info_in, const f3kdb
     CHECK_PARAM(random_algo_ref, 0, (RANDOM_ALGORITHM_COUNT - 1) );
     CHECK_PARAM(random_algo_grain, 0, (RANDOM_ALGORITHM_COUNT - 1) );
     CHECK_PARAM(output_mode, 0, PIXEL_MODE_COUNT - 1);
+    CHECK_PARAM(memory_budget, 0, INT_MAX);
     
 
-    if (params.output_mode != LOW_BIT_DEPTH)
+    if (params.output_mode == HIGH_BIT_DEPTH_FLOAT)
+    {
+        CHECK_PARAM(output_depth, 32, 32);
+    }
+    else if (params.output_mode != LOW_BIT_DEPTH)
     {
         CHECK_PARAM(output_depth, 9, INTERNAL_BIT_DEPTH);
     }
@@ -228,9 +239,37 @@ F3KDB_API(int) f3kdb_create(const f3kdb_video_info_t* video_info_in, const f3kdb
     params.grainY <<= 2;
     params.grainC <<= 2;
 
+    memory_strategy strategy;
+    strategy.large_pages = params.large_pages;
+    strategy.staging = true;
+
+    if (params.memory_budget > 0)
+    {
+        // turn off the strategies that cost memory one by one until the core fits
+        unsigned __int64 budget = (unsigned __int64)params.memory_budget << 20;
+        f3kdb_memory_usage_t usage;
+        f3kdb_core_t::estimate_memory_usage(&video_info, &params, strategy, &usage);
+        if (usage.total > budget)
+        {
+            strategy.large_pages = false;
+            f3kdb_core_t::estimate_memory_usage(&video_info, &params, strategy, &usage);
+        }
+        if (usage.total > budget)
+        {
+            strategy.staging = false;
+            f3kdb_core_t::estimate_memory_usage(&video_info, &params, strategy, &usage);
+        }
+        if (usage.total > budget)
+        {
+            print_error(extra_error_msg, error_msg_size, "Needs at least %d MB of memory, which exceeds memory_budget (%d MB)", 
+                (int)((usage.total + (1 << 20) - 1) >> 20), params.memory_budget);
+            return F3KDB_ERROR_INSUFFICIENT_MEMORY;
+        }
+    }
+
     try
     {
-        *core_out = new f3kdb_core_t(&video_info, &params);
+        *core_out = new f3kdb_core_t(&video_info, &params, strategy);
     } catch (std::bad_alloc&) {
         return F3KDB_ERROR_INSUFFICIENT_MEMORY;
     }
@@ -251,3 +290,103 @@ F3KDB_API(int) f3kdb_process_plane(f3kdb_core_t* core, int frame_index, int plan
     }
     return core->process_plane(frame_index, plane, dst_frame_ptr, dst_pitch, src_frame_ptr, src_pitch);
 }
+
+F3KDB_API(int) f3kdb_process_plane_rect(f3kdb_core_t* core, int frame_index, int plane, unsigned char* dst_frame_ptr, int dst_pitch, const unsigned char* src_frame_ptr, int src_pitch, int x, int y, int width, int height)
+{
+    if (!core)
+    {
+        return F3KDB_ERROR_INVALID_ARGUMENT;
+    }
+    if (plane != PLANE_Y && plane != PLANE_CB && plane != PLANE_CR)
+    {
+        return F3KDB_ERROR_INVALID_ARGUMENT;
+    }
+    return core->process_plane_rect(frame_index, plane, dst_frame_ptr, dst_pitch, src_frame_ptr, src_pitch, x, y, width, height);
+}
+
+F3KDB_API(int) f3kdb_process_frame_v210(f3kdb_core_t* core, int frame_index, unsigned char* dst_frame_ptr, int dst_pitch, const unsigned char* const* src_frame_ptrs, const int* src_pitches)
+{
+    if (!core || !dst_frame_ptr || !src_frame_ptrs || !src_pitches)
+    {
+        return F3KDB_ERROR_INVALID_ARGUMENT;
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        if (!src_frame_ptrs[i])
+        {
+            return F3KDB_ERROR_INVALID_ARGUMENT;
+        }
+    }
+    return core->process_frame_v210(frame_index, dst_frame_ptr, dst_pitch, src_frame_ptrs, src_pitches);
+}
+
+F3KDB_API(int) f3kdb_get_plane_passthrough(f3kdb_core_t* core, int plane, int* passthrough_out)
+{
+    if (!core || !passthrough_out)
+    {
+        return F3KDB_ERROR_INVALID_ARGUMENT;
+    }
+    if (plane != PLANE_Y && plane != PLANE_CB && plane != PLANE_CR)
+    {
+        return F3KDB_ERROR_INVALID_ARGUMENT;
+    }
+    *passthrough_out = core->is_plane_passthrough(plane) ? 1 : 0;
+    return F3KDB_SUCCESS;
+}
+
+F3KDB_API(int) f3kdb_get_lut_backing(f3kdb_core_t* core, LUT_BACKING* backing_out)
+{
+    if (!core || !backing_out)
+    {
+        return F3KDB_ERROR_INVALID_ARGUMENT;
+    }
+    *backing_out = core->get_lut_backing();
+    return F3KDB_SUCCESS;
+}
+
+F3KDB_API(int) f3kdb_get_memory_usage(f3kdb_core_t* core, f3kdb_memory_usage_t* usage_out)
+{
+    if (!core || !usage_out)
+    {
+        return F3KDB_ERROR_INVALID_ARGUMENT;
+    }
+    core->get_memory_usage(usage_out);
+    return F3KDB_SUCCESS;
+}
+
+
+F3KDB_API(int) f3kdb_stream_begin(f3kdb_core_t* core, int frame_index, int plane, unsigned char* dst_frame_ptr, int dst_pitch, const unsigned char* src_frame_ptr, int src_pitch, f3kdb_stream_t** stream_out)
+{
+    if (!core || !stream_out || !dst_frame_ptr || !src_frame_ptr)
+    {
+        return F3KDB_ERROR_INVALID_ARGUMENT;
+    }
+    if (plane != PLANE_Y && plane != PLANE_CB && plane != PLANE_CR)
+    {
+        return F3KDB_ERROR_INVALID_ARGUMENT;
+    }
+    try
+    {
+        return core->stream_begin(frame_index, plane, dst_frame_ptr, dst_pitch, src_frame_ptr, src_pitch, stream_out);
+    } catch (std::bad_alloc&) {
+        return F3KDB_ERROR_INSUFFICIENT_MEMORY;
+    }
+}
+
+F3KDB_API(int) f3kdb_stream_push_rows(f3kdb_stream_t* stream, int available_rows, int* rows_done_out)
+{
+    if (!stream)
+    {
+        return F3KDB_ERROR_INVALID_ARGUMENT;
+    }
+    return stream->core->stream_push_rows(stream, available_rows, rows_done_out);
+}
+
+F3KDB_API(int) f3kdb_stream_end(f3kdb_stream_t* stream)
+{
+    if (!stream)
+    {
+        return F3KDB_ERROR_INVALID_ARGUMENT;
+    }
+    return stream->core->stream_end(stream);
+}
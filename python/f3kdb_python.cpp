@@ -0,0 +1,383 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/f3kdb.h"
+
+typedef struct {
+    PyObject_HEAD
+    f3kdb_core_t* core;
+    f3kdb_video_info_t video_info;
+    int output_depth;
+} core_object;
+
+static int get_sample_size(int depth)
+{
+    return depth == 8 ? 1 : (depth == 32 ? 4 : 2);
+}
+
+static const char* get_sample_format(int depth)
+{
+    return depth == 8 ? "B" : (depth == 32 ? "f" : "H");
+}
+
+static PyObject* raise_f3kdb_error(const char* what, int code, const char* detail)
+{
+    PyErr_Format(code == F3KDB_ERROR_INSUFFICIENT_MEMORY ? PyExc_MemoryError : PyExc_RuntimeError,
+        "f3kdb: %s, code = %d. %s", what, code, detail ? detail : "");
+    return NULL;
+}
+
+static int core_init(core_object* self, PyObject* args, PyObject* kwargs)
+{
+    static const char* keywords[] = {"width", "height", "depth", "subsampling_w", "subsampling_h", "num_frames", "params", NULL};
+    int width, height;
+    int depth = 8;
+    int subsampling_w = 1;
+    int subsampling_h = 1;
+    int num_frames = 1;
+    const char* param_string = "";
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "ii|iiiis", (char**)keywords,
+        &width, &height, &depth, &subsampling_w, &subsampling_h, &num_frames, &param_string))
+    {
+        return -1;
+    }
+    // other threads may be using the current core
+    if (self->core)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "f3kdb: Core is already initialized");
+        return -1;
+    }
+    if (depth != 32 && (depth < 8 || depth > 16))
+    {
+        PyErr_SetString(PyExc_ValueError, "f3kdb: depth must be 8 ~ 16 or 32");
+        return -1;
+    }
+
+    f3kdb_params_t params;
+    f3kdb_params_init_defaults(&params);
+    int result;
+    if (param_string[0])
+    {
+        result = f3kdb_params_fill_by_string(&params, param_string);
+        if (result != F3KDB_SUCCESS)
+        {
+            PyErr_Format(PyExc_ValueError, "f3kdb: Invalid parameter string, code = %d", result);
+            return -1;
+        }
+    }
+    // arrays keep their sample type unless another depth is asked for
+    if (params.output_depth == -1)
+    {
+        params.output_depth = depth;
+    }
+    if (params.output_depth == 32)
+    {
+        params.output_mode = HIGH_BIT_DEPTH_FLOAT;
+    } else {
+        params.output_mode = params.output_depth <= 8 ? LOW_BIT_DEPTH : HIGH_BIT_DEPTH_INTERLEAVED;
+    }
+    f3kdb_params_sanitize(&params);
+
+    f3kdb_video_info_t video_info;
+    memset(&video_info, 0, sizeof(video_info));
+    video_info.width = width;
+    video_info.height = height;
+    video_info.chroma_width_subsampling = subsampling_w;
+    video_info.chroma_height_subsampling = subsampling_h;
+    video_info.depth = depth;
+    video_info.pixel_mode = depth == 8 ? LOW_BIT_DEPTH : (depth == 32 ? HIGH_BIT_DEPTH_FLOAT : HIGH_BIT_DEPTH_INTERLEAVED);
+    video_info.num_frames = num_frames;
+    video_info.color_family = COLOR_FAMILY_YUV;
+
+    char error_msg[1024];
+    memset(error_msg, 0, sizeof(error_msg));
+    f3kdb_core_t* core = NULL;
+    result = f3kdb_create(&video_info, &params, &core, error_msg, sizeof(error_msg) - 1);
+    if (result != F3KDB_SUCCESS)
+    {
+        raise_f3kdb_error("Core initialization failed", result, error_msg);
+        return -1;
+    }
+
+    self->core = core;
+    self->video_info = video_info;
+    self->output_depth = params.output_depth;
+    return 0;
+}
+
+static void core_dealloc(core_object* self)
+{
+    f3kdb_destroy(self->core);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+// Checks that the buffer is a plane of the given size and sample type.
+// Rows can have any stride, samples within a row are packed if *packed_out is set.
+static bool check_plane_buffer(const Py_buffer* view, const char* name, int width, int height, int depth, bool* packed_out)
+{
+    int sample_size = get_sample_size(depth);
+    const char* format = view->format ? view->format : "B";
+    // native byte order markers are fine
+    if (format[0] == '@' || format[0] == '=' || format[0] == '<')
+    {
+        format++;
+    }
+    bool format_ok = view->itemsize == sample_size && !strcmp(format, get_sample_format(depth));
+    if (!format_ok)
+    {
+        PyErr_Format(PyExc_ValueError, "f3kdb: %s must hold %s samples", name,
+            depth == 8 ? "uint8" : (depth == 32 ? "float32" : "uint16"));
+        return false;
+    }
+    if (view->ndim != 2 || view->shape[0] != height || view->shape[1] != width)
+    {
+        PyErr_Format(PyExc_ValueError, "f3kdb: %s must be a 2-dimensional array of %d rows and %d columns", name, height, width);
+        return false;
+    }
+    // the core takes a positive int pitch
+    if (view->strides[0] <= 0 || view->strides[0] > INT_MAX)
+    {
+        PyErr_Format(PyExc_ValueError, "f3kdb: Rows of %s must have a positive stride", name);
+        return false;
+    }
+    *packed_out = view->strides[1] == sample_size && view->strides[0] >= width * sample_size;
+    return true;
+}
+
+static void copy_strided_plane(const Py_buffer* view, unsigned char* packed, int packed_pitch, int width, int height, int sample_size, bool to_packed)
+{
+    for (int row = 0; row < height; row++)
+    {
+        unsigned char* view_row = (unsigned char*)view->buf + view->strides[0] * row;
+        unsigned char* packed_row = packed + packed_pitch * row;
+        for (int column = 0; column < width; column++)
+        {
+            unsigned char* sample = view_row + view->strides[1] * column;
+            if (to_packed)
+            {
+                memcpy(packed_row + column * sample_size, sample, sample_size);
+            } else {
+                memcpy(sample, packed_row + column * sample_size, sample_size);
+            }
+        }
+    }
+}
+
+// returns a memoryview of a new bytearray, shaped as a plane
+static PyObject* create_plane_array(int width, int height, int depth)
+{
+    PyObject* bytes = PyByteArray_FromStringAndSize(NULL, (Py_ssize_t)width * height * get_sample_size(depth));
+    if (!bytes)
+    {
+        return NULL;
+    }
+    PyObject* view = PyMemoryView_FromObject(bytes);
+    Py_DECREF(bytes);
+    if (!view)
+    {
+        return NULL;
+    }
+    PyObject* shaped = PyObject_CallMethod(view, "cast", "s(ii)", get_sample_format(depth), height, width);
+    Py_DECREF(view);
+    return shaped;
+}
+
+static PyObject* core_process_plane(core_object* self, PyObject* args, PyObject* kwargs)
+{
+    static const char* keywords[] = {"plane", "src", "dst", "frame", NULL};
+    int plane;
+    PyObject* src_object;
+    PyObject* dst_object = Py_None;
+    int frame_index = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "iO|Oi", (char**)keywords, &plane, &src_object, &dst_object, &frame_index))
+    {
+        return NULL;
+    }
+    if (!self->core)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "f3kdb: Core is not initialized");
+        return NULL;
+    }
+    if (plane != PLANE_Y && plane != PLANE_CB && plane != PLANE_CR)
+    {
+        PyErr_SetString(PyExc_ValueError, "f3kdb: plane must be PLANE_Y, PLANE_CB or PLANE_CR");
+        return NULL;
+    }
+    // the core indexes its per-frame tables with it
+    if (frame_index < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "f3kdb: frame must not be negative");
+        return NULL;
+    }
+    int width = self->video_info.get_plane_width(plane);
+    int height = self->video_info.get_plane_height(plane);
+    int src_sample_size = get_sample_size(self->video_info.depth);
+    int dst_sample_size = get_sample_size(self->output_depth);
+
+    Py_buffer src;
+    if (PyObject_GetBuffer(src_object, &src, PyBUF_STRIDES | PyBUF_FORMAT) != 0)
+    {
+        return NULL;
+    }
+    bool src_packed;
+    if (!check_plane_buffer(&src, "src", width, height, self->video_info.depth, &src_packed))
+    {
+        PyBuffer_Release(&src);
+        return NULL;
+    }
+
+    if (dst_object == Py_None)
+    {
+        dst_object = create_plane_array(width, height, self->output_depth);
+        if (!dst_object)
+        {
+            PyBuffer_Release(&src);
+            return NULL;
+        }
+    } else {
+        Py_INCREF(dst_object);
+    }
+    Py_buffer dst;
+    if (PyObject_GetBuffer(dst_object, &dst, PyBUF_STRIDES | PyBUF_FORMAT | PyBUF_WRITABLE) != 0)
+    {
+        PyBuffer_Release(&src);
+        Py_DECREF(dst_object);
+        return NULL;
+    }
+    bool dst_packed;
+    if (!check_plane_buffer(&dst, "dst", width, height, self->output_depth, &dst_packed))
+    {
+        PyBuffer_Release(&src);
+        PyBuffer_Release(&dst);
+        Py_DECREF(dst_object);
+        return NULL;
+    }
+
+    // Planes whose samples are not adjacent within a row are copied to a packed buffer first,
+    // other planes are passed to the core as they are.
+    int src_pitch = (int)src.strides[0];
+    int dst_pitch = (int)dst.strides[0];
+    int src_packed_pitch = (width * src_sample_size + PLANE_ALIGNMENT - 1) & ~(PLANE_ALIGNMENT - 1);
+    int dst_packed_pitch = (width * dst_sample_size + PLANE_ALIGNMENT - 1) & ~(PLANE_ALIGNMENT - 1);
+    unsigned char* src_temp = NULL;
+    unsigned char* dst_temp = NULL;
+    int result;
+
+    Py_BEGIN_ALLOW_THREADS
+    result = F3KDB_SUCCESS;
+    const unsigned char* src_ptr = (const unsigned char*)src.buf;
+    unsigned char* dst_ptr = (unsigned char*)dst.buf;
+    if (!src_packed)
+    {
+        src_temp = (unsigned char*)malloc((size_t)src_packed_pitch * height);
+        if (src_temp)
+        {
+            copy_strided_plane(&src, src_temp, src_packed_pitch, width, height, src_sample_size, true);
+        }
+        src_ptr = src_temp;
+        src_pitch = src_packed_pitch;
+    }
+    if (!dst_packed)
+    {
+        dst_temp = (unsigned char*)malloc((size_t)dst_packed_pitch * height);
+        dst_ptr = dst_temp;
+        dst_pitch = dst_packed_pitch;
+    }
+    if (!src_ptr || !dst_ptr)
+    {
+        result = F3KDB_ERROR_INSUFFICIENT_MEMORY;
+    } else {
+        result = f3kdb_process_plane(self->core, frame_index, plane, dst_ptr, dst_pitch, src_ptr, src_pitch);
+    }
+    if (result == F3KDB_SUCCESS && dst_temp)
+    {
+        copy_strided_plane(&dst, dst_temp, dst_packed_pitch, width, height, dst_sample_size, false);
+    }
+    free(src_temp);
+    free(dst_temp);
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release(&src);
+    PyBuffer_Release(&dst);
+    if (result != F3KDB_SUCCESS)
+    {
+        Py_DECREF(dst_object);
+        return raise_f3kdb_error("Processing failed", result, NULL);
+    }
+    return dst_object;
+}
+
+static PyObject* core_get_output_depth(core_object* self, void* closure)
+{
+    return PyLong_FromLong(self->output_depth);
+}
+
+static PyMethodDef core_methods[] = {
+    {"process_plane", (PyCFunction)core_process_plane, METH_VARARGS | METH_KEYWORDS,
+     "process_plane(plane, src, dst=None, frame=0)\n"
+     "--\n\n"
+     "Debands one plane and returns dst, or a new memoryview if dst is None.\n"
+     "src and dst are 2-dimensional buffers of the plane size (e.g. NumPy arrays), \n"
+     "uint8 for 8-bit, uint16 for 9 ~ 16-bit and float32 for 32-bit samples.\n"
+     "They are used without copying when samples within a row are adjacent, rows can have any stride.\n"
+     "The GIL is released while processing."},
+    {NULL}
+};
+
+static PyGetSetDef core_getset[] = {
+    {"output_depth", (getter)core_get_output_depth, NULL, "Bit depth of the output planes", NULL},
+    {NULL}
+};
+
+static PyTypeObject core_type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "f3kdb.Core",
+};
+
+static PyModuleDef f3kdb_module = {
+    PyModuleDef_HEAD_INIT,
+    "f3kdb",
+    "Python binding of flash3kyuu_deband",
+    -1,
+};
+
+PyMODINIT_FUNC PyInit_f3kdb(void)
+{
+    core_type.tp_basicsize = sizeof(core_object);
+    core_type.tp_flags = Py_TPFLAGS_DEFAULT;
+    core_type.tp_doc =
+        "Core(width, height, depth=8, subsampling_w=1, subsampling_h=1, num_frames=1, params='')\n"
+        "--\n\n"
+        "Debanding core for frames of one format. params uses the syntax of f3kdb_params_fill_by_string, \n"
+        "e.g. 'range=15/Y=64/output_depth=16'. output_depth defaults to depth.\n"
+        "A core can process planes from several threads at the same time.";
+    core_type.tp_new = PyType_GenericNew;
+    core_type.tp_init = (initproc)core_init;
+    core_type.tp_dealloc = (destructor)core_dealloc;
+    core_type.tp_methods = core_methods;
+    core_type.tp_getset = core_getset;
+    if (PyType_Ready(&core_type) < 0)
+    {
+        return NULL;
+    }
+
+    PyObject* module = PyModule_Create(&f3kdb_module);
+    if (!module)
+    {
+        return NULL;
+    }
+    Py_INCREF(&core_type);
+    if (PyModule_AddObject(module, "Core", (PyObject*)&core_type) < 0 ||
+        PyModule_AddIntConstant(module, "PLANE_Y", PLANE_Y) < 0 ||
+        PyModule_AddIntConstant(module, "PLANE_CB", PLANE_CB) < 0 ||
+        PyModule_AddIntConstant(module, "PLANE_CR", PLANE_CR) < 0)
+    {
+        Py_DECREF(&core_type);
+        Py_DECREF(module);
+        return NULL;
+    }
+    return module;
+}
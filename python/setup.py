@@ -0,0 +1,25 @@
+import os
+import struct
+
+from setuptools import Extension, setup
+
+here = os.path.dirname(os.path.abspath(__file__))
+root = os.path.dirname(here)
+
+# Import library of the filter DLL, see README.md
+lib_dir = os.environ.get("F3KDB_LIB_DIR")
+if not lib_dir:
+    lib_dir = os.path.join(root, "x64" if struct.calcsize("P") == 8 else "", "Release")
+
+setup(
+    name="f3kdb",
+    ext_modules=[
+        Extension(
+            "f3kdb",
+            sources=[os.path.join(here, "f3kdb_python.cpp")],
+            include_dirs=[os.path.join(root, "include")],
+            library_dirs=[lib_dir],
+            libraries=["flash3kyuu_deband"],
+        ),
+    ],
+)
@@ -0,0 +1,136 @@
+# Run with "python -m pytest" in this directory, after "python setup.py build_ext --inplace"
+
+import threading
+import time
+
+import pytest
+
+np = pytest.importorskip("numpy")
+f3kdb = pytest.importorskip("f3kdb")
+
+WIDTH = 640
+HEIGHT = 480
+
+
+def gradient(width, height, dtype=np.uint8, scale=1):
+    rows, columns = np.mgrid[0:height, 0:width]
+    plane = (columns // 15 + rows // 9 + (columns * 7 + rows * 13) % 3) % 256
+    return (plane * scale).astype(dtype)
+
+
+@pytest.fixture(scope="module")
+def core():
+    return f3kdb.Core(WIDTH, HEIGHT, params="Y=64")
+
+
+@pytest.fixture(scope="module")
+def src():
+    return gradient(WIDTH, HEIGHT)
+
+
+def test_dst_none(core, src):
+    out = core.process_plane(f3kdb.PLANE_Y, src)
+    assert isinstance(out, memoryview)
+    assert out.format == "B"
+    assert out.shape == (HEIGHT, WIDTH)
+    assert not np.array_equal(np.asarray(out), src)
+
+
+def test_dst_provided(core, src):
+    expected = np.asarray(core.process_plane(f3kdb.PLANE_Y, src))
+    dst = np.zeros((HEIGHT, WIDTH), dtype=np.uint8)
+    assert core.process_plane(f3kdb.PLANE_Y, src, dst) is dst
+    assert np.array_equal(dst, expected)
+
+
+def test_output_depth():
+    core = f3kdb.Core(WIDTH, HEIGHT, params="output_depth=16")
+    assert core.output_depth == 16
+    out = core.process_plane(f3kdb.PLANE_CB, gradient(WIDTH // 2, HEIGHT // 2))
+    assert out.format == "H"
+    assert out.shape == (HEIGHT // 2, WIDTH // 2)
+
+
+def test_high_bit_depth_and_float():
+    core = f3kdb.Core(WIDTH, HEIGHT, depth=16)
+    assert core.process_plane(f3kdb.PLANE_Y, gradient(WIDTH, HEIGHT, np.uint16, 256)).format == "H"
+    core = f3kdb.Core(WIDTH, HEIGHT, depth=32)
+    assert core.process_plane(f3kdb.PLANE_Y, gradient(WIDTH, HEIGHT, np.float32, 1 / 255.0)).format == "f"
+
+
+def test_padded_rows(core, src):
+    # contiguous samples in rows with a larger stride are used without copying
+    expected = np.asarray(core.process_plane(f3kdb.PLANE_Y, src))
+    padded_src = np.zeros((HEIGHT, WIDTH + 64), dtype=np.uint8)
+    padded_src[:, :WIDTH] = src
+    padded_dst = np.zeros((HEIGHT, WIDTH + 64), dtype=np.uint8)
+    core.process_plane(f3kdb.PLANE_Y, padded_src[:, :WIDTH], padded_dst[:, :WIDTH])
+    assert np.array_equal(padded_dst[:, :WIDTH], expected)
+    assert not padded_dst[:, WIDTH:].any()
+
+
+def test_strided_fallback(core, src):
+    # samples that aren't adjacent within a row are copied through a packed buffer
+    expected = np.asarray(core.process_plane(f3kdb.PLANE_Y, src))
+    strided_src = np.zeros((HEIGHT, WIDTH * 2), dtype=np.uint8)
+    strided_src[:, ::2] = src
+    strided_dst = np.zeros((HEIGHT, WIDTH * 2), dtype=np.uint8)
+    core.process_plane(f3kdb.PLANE_Y, strided_src[:, ::2], strided_dst[:, ::2])
+    assert np.array_equal(strided_dst[:, ::2], expected)
+    assert not strided_dst[:, 1::2].any()
+
+    transposed = np.ascontiguousarray(src.T).T
+    assert np.array_equal(np.asarray(core.process_plane(f3kdb.PLANE_Y, transposed)), expected)
+
+
+@pytest.mark.parametrize("bad_src", [
+    np.zeros((HEIGHT, WIDTH), dtype=np.uint16),
+    np.zeros((HEIGHT, WIDTH), dtype=np.int8),
+    np.zeros((HEIGHT, WIDTH + 1), dtype=np.uint8),
+    np.zeros((HEIGHT - 1, WIDTH), dtype=np.uint8),
+    np.zeros(HEIGHT * WIDTH, dtype=np.uint8),
+    np.zeros((HEIGHT, WIDTH), dtype=np.uint8)[::-1],
+])
+def test_bad_src(core, bad_src):
+    with pytest.raises(ValueError):
+        core.process_plane(f3kdb.PLANE_Y, bad_src)
+
+
+def test_bad_dst(core, src):
+    with pytest.raises(ValueError):
+        core.process_plane(f3kdb.PLANE_Y, src, np.zeros((HEIGHT, WIDTH), dtype=np.uint16))
+    with pytest.raises(BufferError):
+        core.process_plane(f3kdb.PLANE_Y, src, bytes(WIDTH * HEIGHT))
+
+
+def test_bad_plane_and_frame(core, src):
+    with pytest.raises(ValueError):
+        core.process_plane(3, src)
+    with pytest.raises(ValueError):
+        core.process_plane(f3kdb.PLANE_CB, src)
+    with pytest.raises(ValueError):
+        core.process_plane(f3kdb.PLANE_Y, src, frame=-1)
+
+
+def test_gil_released():
+    width, height = 3840, 2160
+    core = f3kdb.Core(width, height, params="range=31")
+    src = gradient(width, height)
+    dst = np.empty_like(src)
+
+    start = time.perf_counter()
+    core.process_plane(f3kdb.PLANE_Y, src, dst)
+    duration = time.perf_counter() - start
+
+    # while the GIL is held by a call, this thread can't run Python code for the whole call,
+    # which may already start before start() returns
+    worker = threading.Thread(target=core.process_plane, args=(f3kdb.PLANE_Y, src, dst))
+    longest_gap = 0
+    last = time.perf_counter()
+    worker.start()
+    while worker.is_alive():
+        now = time.perf_counter()
+        longest_gap = max(longest_gap, now - last)
+        last = now
+    worker.join()
+    assert longest_gap < duration / 2
@@ -22,7 +22,7 @@ static const rand_impl_t rand_algorithms[] = {
     rand_gaussian
 };
 
-double round(double r) {
+static double round_nearest(double r) {
     return (r > 0.0) ? floor(r + 0.5) : ceil(r - 0.5);
 }
 
@@ -32,7 +32,7 @@ int random(RANDOM_ALGORITHM algo, int& seed, int range, double param)
 
     double num = rand_algorithms[algo](seed, param);
     assert(num >= -1.0 && num <= 1.0);
-    return (int)round(num * range);
+    return (int)round_nearest(num * range);
 }
 
 // most algorithms below are stolen from AddGrainC
@@ -0,0 +1,262 @@
+#include "stdafx.h"
+
+#include <string.h>
+#include <emmintrin.h>
+
+#include "row_convert.h"
+#include "include/f3kdb.h"
+
+static void deinterleave_row_c_8(const unsigned char* src, unsigned char* dst_cb, unsigned char* dst_cr, int width)
+{
+    for (int i = 0; i < width; i++)
+    {
+        dst_cb[i] = src[i * 2];
+        dst_cr[i] = src[i * 2 + 1];
+    }
+}
+
+static void deinterleave_row_c_16(const unsigned char* src, unsigned char* dst_cb, unsigned char* dst_cr, int width)
+{
+    auto src16 = (const unsigned short*)src;
+    for (int i = 0; i < width; i++)
+    {
+        ((unsigned short*)dst_cb)[i] = src16[i * 2];
+        ((unsigned short*)dst_cr)[i] = src16[i * 2 + 1];
+    }
+}
+
+static void interleave_row_c_8(const unsigned char* src_cb, const unsigned char* src_cr, unsigned char* dst, int width)
+{
+    for (int i = 0; i < width; i++)
+    {
+        dst[i * 2] = src_cb[i];
+        dst[i * 2 + 1] = src_cr[i];
+    }
+}
+
+static void interleave_row_c_16(const unsigned char* src_cb, const unsigned char* src_cr, unsigned char* dst, int width)
+{
+    auto dst16 = (unsigned short*)dst;
+    for (int i = 0; i < width; i++)
+    {
+        dst16[i * 2] = ((const unsigned short*)src_cb)[i];
+        dst16[i * 2 + 1] = ((const unsigned short*)src_cr)[i];
+    }
+}
+
+static void float_row_to_16bit_c(const float* src, unsigned short* dst, int width, float offset)
+{
+    for (int i = 0; i < width; i++)
+    {
+        float value = (src[i] + offset) * 65535.0f + 0.5f;
+        value = value < 0.0f ? 0.0f : (value > 65535.0f ? 65535.0f : value);
+        dst[i] = (unsigned short)value;
+    }
+}
+
+static void row_16bit_to_float_c(const unsigned short* src, float* dst, int width, float offset)
+{
+    for (int i = 0; i < width; i++)
+    {
+        dst[i] = src[i] * (1.0f / 65535.0f) - offset;
+    }
+}
+
+// one group of 6 pixels, 16 bytes
+static inline void pack_v210_group(const unsigned short* y, const unsigned short* cb, const unsigned short* cr, unsigned char* dst)
+{
+    unsigned int words[4];
+    words[0] = cb[0] | (y[0] << 10) | (cr[0] << 20);
+    words[1] = y[1] | (cb[1] << 10) | (y[2] << 20);
+    words[2] = cr[1] | (y[3] << 10) | (cb[2] << 20);
+    words[3] = y[4] | (cr[2] << 10) | (y[5] << 20);
+    // rows of v210 are 128-byte aligned by convention, but not required to be here
+    memcpy(dst, words, sizeof(words));
+}
+
+// packs the groups from first_pixel on, first_pixel is a multiple of 6
+static void pack_v210_row_c_from(const unsigned short* y, const unsigned short* cb, const unsigned short* cr, unsigned char* dst, int first_pixel, int width)
+{
+    int full_groups_end = width - width % 6;
+    for (int x = first_pixel; x < full_groups_end; x += 6)
+    {
+        pack_v210_group(y + x, cb + x / 2, cr + x / 2, dst + x / 6 * 16);
+    }
+    if (full_groups_end < width)
+    {
+        // samples past the end of the row are zero
+        unsigned short tail_y[6] = {0}, tail_cb[3] = {0}, tail_cr[3] = {0};
+        memcpy(tail_y, y + full_groups_end, (width - full_groups_end) * sizeof(unsigned short));
+        memcpy(tail_cb, cb + full_groups_end / 2, (width / 2 - full_groups_end / 2) * sizeof(unsigned short));
+        memcpy(tail_cr, cr + full_groups_end / 2, (width / 2 - full_groups_end / 2) * sizeof(unsigned short));
+        pack_v210_group(tail_y, tail_cb, tail_cr, dst + full_groups_end / 6 * 16);
+    }
+}
+
+static void pack_v210_row_c(const unsigned short* y, const unsigned short* cb, const unsigned short* cr, unsigned char* dst, int width)
+{
+    pack_v210_row_c_from(y, cb, cr, dst, 0, width);
+}
+
+// 16 samples of each component per iteration
+static void deinterleave_row_sse2_8(const unsigned char* src, unsigned char* dst_cb, unsigned char* dst_cr, int width)
+{
+    __m128i low_byte_mask = _mm_set1_epi16(0x00ff);
+    int simd_end = width & ~15;
+    for (int i = 0; i < simd_end; i += 16)
+    {
+        __m128i lo = _mm_loadu_si128((const __m128i*)(src + i * 2));
+        __m128i hi = _mm_loadu_si128((const __m128i*)(src + i * 2 + 16));
+        // words hold cb in the low byte and cr in the high byte, both fit in packus without saturation
+        __m128i cb = _mm_packus_epi16(_mm_and_si128(lo, low_byte_mask), _mm_and_si128(hi, low_byte_mask));
+        __m128i cr = _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+        _mm_storeu_si128((__m128i*)(dst_cb + i), cb);
+        _mm_storeu_si128((__m128i*)(dst_cr + i), cr);
+    }
+    deinterleave_row_c_8(src + simd_end * 2, dst_cb + simd_end, dst_cr + simd_end, width - simd_end);
+}
+
+// 8 samples of each component per iteration
+static void deinterleave_row_sse2_16(const unsigned char* src, unsigned char* dst_cb, unsigned char* dst_cr, int width)
+{
+    int simd_end = width & ~7;
+    for (int i = 0; i < simd_end; i += 8)
+    {
+        __m128i lo = _mm_loadu_si128((const __m128i*)(src + i * 4));
+        __m128i hi = _mm_loadu_si128((const __m128i*)(src + i * 4 + 16));
+        // SSE2 only has a signed 32 -> 16 bit pack, so samples are sign extended first,
+        // which makes the pack exact for the whole 16-bit range
+        __m128i cb = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(lo, 16), 16), _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16));
+        __m128i cr = _mm_packs_epi32(_mm_srai_epi32(lo, 16), _mm_srai_epi32(hi, 16));
+        _mm_storeu_si128((__m128i*)(dst_cb + i * 2), cb);
+        _mm_storeu_si128((__m128i*)(dst_cr + i * 2), cr);
+    }
+    deinterleave_row_c_16(src + simd_end * 4, dst_cb + simd_end * 2, dst_cr + simd_end * 2, width - simd_end);
+}
+
+static void interleave_row_sse2_8(const unsigned char* src_cb, const unsigned char* src_cr, unsigned char* dst, int width)
+{
+    int simd_end = width & ~15;
+    for (int i = 0; i < simd_end; i += 16)
+    {
+        __m128i cb = _mm_loadu_si128((const __m128i*)(src_cb + i));
+        __m128i cr = _mm_loadu_si128((const __m128i*)(src_cr + i));
+        _mm_storeu_si128((__m128i*)(dst + i * 2), _mm_unpacklo_epi8(cb, cr));
+        _mm_storeu_si128((__m128i*)(dst + i * 2 + 16), _mm_unpackhi_epi8(cb, cr));
+    }
+    interleave_row_c_8(src_cb + simd_end, src_cr + simd_end, dst + simd_end * 2, width - simd_end);
+}
+
+static void interleave_row_sse2_16(const unsigned char* src_cb, const unsigned char* src_cr, unsigned char* dst, int width)
+{
+    int simd_end = width & ~7;
+    for (int i = 0; i < simd_end; i += 8)
+    {
+        __m128i cb = _mm_loadu_si128((const __m128i*)(src_cb + i * 2));
+        __m128i cr = _mm_loadu_si128((const __m128i*)(src_cr + i * 2));
+        _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_unpacklo_epi16(cb, cr));
+        _mm_storeu_si128((__m128i*)(dst + i * 4 + 16), _mm_unpackhi_epi16(cb, cr));
+    }
+    interleave_row_c_16(src_cb + simd_end * 2, src_cr + simd_end * 2, dst + simd_end * 4, width - simd_end);
+}
+
+// 8 samples per iteration, same operations as the C version so results are identical
+static void float_row_to_16bit_sse2(const float* src, unsigned short* dst, int width, float offset)
+{
+    __m128 offset_ps = _mm_set1_ps(offset);
+    __m128 scale = _mm_set1_ps(65535.0f);
+    __m128 half = _mm_set1_ps(0.5f);
+    __m128 zero = _mm_setzero_ps();
+    // SSE2 only has a signed 32 -> 16 bit pack, so values are biased into its range and back
+    __m128i bias_epi32 = _mm_set1_epi32(32768);
+    __m128i bias_epi16 = _mm_set1_epi16((short)0x8000);
+    int simd_end = width & ~7;
+    for (int i = 0; i < simd_end; i += 8)
+    {
+        __m128i values[2];
+        for (int j = 0; j < 2; j++)
+        {
+            __m128 value = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_loadu_ps(src + i + j * 4), offset_ps), scale), half);
+            value = _mm_min_ps(_mm_max_ps(value, zero), scale);
+            // truncates like the cast of the C version, rounding is done by adding 0.5
+            values[j] = _mm_sub_epi32(_mm_cvttps_epi32(value), bias_epi32);
+        }
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(_mm_packs_epi32(values[0], values[1]), bias_epi16));
+    }
+    float_row_to_16bit_c(src + simd_end, dst + simd_end, width - simd_end, offset);
+}
+
+static void row_16bit_to_float_sse2(const unsigned short* src, float* dst, int width, float offset)
+{
+    __m128 offset_ps = _mm_set1_ps(offset);
+    __m128 scale = _mm_set1_ps(1.0f / 65535.0f);
+    __m128i zero = _mm_setzero_si128();
+    int simd_end = width & ~7;
+    for (int i = 0; i < simd_end; i += 8)
+    {
+        __m128i samples = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128 lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(samples, zero));
+        __m128 hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(samples, zero));
+        _mm_storeu_ps(dst + i, _mm_sub_ps(_mm_mul_ps(lo, scale), offset_ps));
+        _mm_storeu_ps(dst + i + 4, _mm_sub_ps(_mm_mul_ps(hi, scale), offset_ps));
+    }
+    row_16bit_to_float_c(src + simd_end, dst + simd_end, width - simd_end, offset);
+}
+
+// One group of 6 pixels per iteration. The samples of a group, in the order they are stored, are
+// cb0 y0 cr0 y1 | cb1 y2 cr1 y3 | cb2 y4 cr2 y5 after interleaving the planes, and have to be
+// packed 3 to a word at bits 0, 10 and 20. The dwords of the interleaved samples are picked so
+// that madd with per-lane factors of 0, 1 and 1024 puts each sample in its place.
+static void pack_v210_row_sse2(const unsigned short* y, const unsigned short* cb, const unsigned short* cr, unsigned char* dst, int width)
+{
+    // samples are at most 10 bits, so none of the sums overflow
+    __m128i first_factors = _mm_setr_epi16(1, 1024, 0, 1, 1, 1024, 0, 1);
+    __m128i second_factors = _mm_setr_epi16(0, 0, 1024, 0, 0, 0, 1024, 0);
+    __m128i third_factors = _mm_setr_epi16(1, 0, 0, 1, 1, 0, 0, 1);
+    int x = 0;
+    unsigned char* dst_group = dst;
+    // 8 luma and 4 chroma samples are read for a group, the last ones are left to the C version
+    // so nothing is read past the end of the rows
+    for (; x + 8 <= width; x += 6)
+    {
+        __m128i y_samples = _mm_loadu_si128((const __m128i*)(y + x));
+        __m128i c_samples = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(cb + x / 2)), _mm_loadl_epi64((const __m128i*)(cr + x / 2)));
+        // (cb0 y0) (cr0 y1) (cb1 y2) (cr1 y3) / (cb2 y4) (cr2 y5) ...
+        __m128 lo = _mm_castsi128_ps(_mm_unpacklo_epi16(c_samples, y_samples));
+        __m128 hi = _mm_castsi128_ps(_mm_unpackhi_epi16(c_samples, y_samples));
+
+        // (cb0 y0) (cr0 y1) (cr1 y3) (cb2 y4): cb0 + y0 * 1024, y1, cr1 + y3 * 1024, y4
+        __m128 lo3_hi0 = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(0, 0, 3, 3));
+        __m128i first = _mm_castps_si128(_mm_shuffle_ps(lo, lo3_hi0, _MM_SHUFFLE(2, 0, 1, 0)));
+        // (cr0 y1) (cb1 y2) (cb2 y4) (cr2 y5): nothing, cb1 * 1024, nothing, cr2 * 1024
+        // and cr0, y2, cb2, y5 for bit 20
+        __m128i second = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(1, 0, 2, 1)));
+
+        __m128i words = _mm_add_epi32(_mm_madd_epi16(first, first_factors), _mm_madd_epi16(second, second_factors));
+        words = _mm_or_si128(words, _mm_slli_epi32(_mm_madd_epi16(second, third_factors), 20));
+        _mm_storeu_si128((__m128i*)dst_group, words);
+        dst_group += 16;
+    }
+    pack_v210_row_c_from(y, cb, cr, dst, x, width);
+}
+
+static const row_convert_impl row_convert_impl_c = {
+    {deinterleave_row_c_8, deinterleave_row_c_16},
+    {interleave_row_c_8, interleave_row_c_16},
+    float_row_to_16bit_c,
+    row_16bit_to_float_c,
+    pack_v210_row_c,
+};
+
+static const row_convert_impl row_convert_impl_sse2 = {
+    {deinterleave_row_sse2_8, deinterleave_row_sse2_16},
+    {interleave_row_sse2_8, interleave_row_sse2_16},
+    float_row_to_16bit_sse2,
+    row_16bit_to_float_sse2,
+    pack_v210_row_sse2,
+};
+
+const row_convert_impl* get_row_convert_impl(int opt)
+{
+    return opt == IMPL_C ? &row_convert_impl_c : &row_convert_impl_sse2;
+}
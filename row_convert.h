@@ -0,0 +1,33 @@
+#pragma once
+
+// Conversions between the sample layout of frames and the planar rows that the kernels read
+// and write, used by the paths that copy source rows into a window (see core.cpp).
+// Rows don't need to be aligned, widths are in samples per component.
+
+// sample_size 1 or 2
+typedef void (*deinterleave_row_t)(const unsigned char* src, unsigned char* dst_cb, unsigned char* dst_cr, int width);
+typedef void (*interleave_row_t)(const unsigned char* src_cb, const unsigned char* src_cr, unsigned char* dst, int width);
+
+// offset is added to float samples before they are scaled from [0, 1] to [0, 65535], and subtracted
+// after scaling back, so chroma in [-0.5, 0.5] fits
+typedef void (*float_row_to_16bit_t)(const float* src, unsigned short* dst, int width, float offset);
+typedef void (*row_16bit_to_float_t)(const unsigned short* src, float* dst, int width, float offset);
+
+// packs rows of 10-bit 4:2:2 samples into v210, width is in luma samples
+// samples past the width in the last group of 6 pixels are written as 0
+typedef void (*pack_v210_row_t)(const unsigned short* y, const unsigned short* cb, const unsigned short* cr, unsigned char* dst, int width);
+
+typedef struct _row_convert_impl
+{
+    // indexed by sample size - 1
+    deinterleave_row_t deinterleave_row[2];
+    interleave_row_t interleave_row[2];
+
+    float_row_to_16bit_t float_row_to_16bit;
+    row_16bit_to_float_t row_16bit_to_float;
+
+    pack_v210_row_t pack_v210_row;
+} row_convert_impl;
+
+// opt: detected implementation, IMPL_C doesn't use SSE2 so it runs on any CPU
+const row_convert_impl* get_row_convert_impl(int opt);
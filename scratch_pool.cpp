@@ -0,0 +1,187 @@
+#include "stdafx.h"
+
+#include "scratch_pool.h"
+
+#include <assert.h>
+#include <malloc.h>
+
+#ifndef _WIN32
+#include <new>
+#endif
+
+// items are laid out as [free list entry][buffer], the header is padded so the buffer stays aligned
+#define SCRATCH_ITEM_HEADER_SIZE 16
+// buffers are used by SSE code, MEMORY_ALLOCATION_ALIGNMENT is only 8 on x86
+#define SCRATCH_ITEM_ALIGNMENT 16
+
+static_assert(SCRATCH_ITEM_HEADER_SIZE % SCRATCH_ITEM_ALIGNMENT == 0, "Item header breaks alignment");
+
+#ifdef _WIN32
+static_assert(sizeof(SLIST_ENTRY) <= SCRATCH_ITEM_HEADER_SIZE, "SLIST_ENTRY doesn't fit in item header");
+static_assert(SCRATCH_ITEM_ALIGNMENT % MEMORY_ALLOCATION_ALIGNMENT == 0, "Items don't meet SLIST alignment");
+
+// free_list is NULL if out of memory
+static void free_list_init(scratch_pool* pool)
+{
+    pool->free_list = (PSLIST_HEADER)_aligned_malloc(sizeof(SLIST_HEADER), MEMORY_ALLOCATION_ALIGNMENT);
+    if (pool->free_list)
+    {
+        InitializeSListHead(pool->free_list);
+    }
+}
+
+static void free_list_destroy(scratch_pool* pool)
+{
+    _aligned_free(pool->free_list);
+}
+
+static char* free_list_pop(scratch_pool* pool)
+{
+    return (char*)InterlockedPopEntrySList(pool->free_list);
+}
+
+static void free_list_push(scratch_pool* pool, char* item)
+{
+    InterlockedPushEntrySList(pool->free_list, (PSLIST_ENTRY)item);
+}
+#else
+// Same as the sequence number of SLIST: the head holds the first item and a tag that changes
+// on every push, so a pop that read an item which was popped and pushed back in the meantime
+// fails its compare-and-swap instead of putting a buffer in use back on top (ABA).
+// User space addresses of x86-64 fit in 48 bits, the remaining bits hold the tag.
+#define FREE_LIST_POINTER_BITS (sizeof(void*) == 8 ? 48 : 32)
+#define FREE_LIST_POINTER_MASK ((UINT64_C(1) << FREE_LIST_POINTER_BITS) - 1)
+
+typedef struct _free_list_entry
+{
+    struct _free_list_entry* next;
+} free_list_entry;
+
+static_assert(sizeof(free_list_entry) <= SCRATCH_ITEM_HEADER_SIZE, "free_list_entry doesn't fit in item header");
+
+static free_list_entry* get_head_entry(uint64_t head)
+{
+    return (free_list_entry*)(uintptr_t)(head & FREE_LIST_POINTER_MASK);
+}
+
+static void free_list_init(scratch_pool* pool)
+{
+    pool->free_list = new (std::nothrow) std::atomic<uint64_t>(0);
+}
+
+static void free_list_destroy(scratch_pool* pool)
+{
+    delete pool->free_list;
+}
+
+static char* free_list_pop(scratch_pool* pool)
+{
+    uint64_t head = pool->free_list->load();
+    for (;;)
+    {
+        free_list_entry* entry = get_head_entry(head);
+        if (!entry)
+        {
+            return NULL;
+        }
+        // entries are only freed when the pool is destroyed, so next can be read even if
+        // another thread has taken the entry, the tag makes the exchange fail then
+        uint64_t new_head = (head & ~FREE_LIST_POINTER_MASK) | (uintptr_t)entry->next;
+        if (pool->free_list->compare_exchange_weak(head, new_head))
+        {
+            return (char*)entry;
+        }
+    }
+}
+
+static void free_list_push(scratch_pool* pool, char* item)
+{
+    free_list_entry* entry = (free_list_entry*)item;
+    uint64_t head = pool->free_list->load();
+    for (;;)
+    {
+        entry->next = get_head_entry(head);
+        uint64_t new_head = ((head | FREE_LIST_POINTER_MASK) + 1) | (uintptr_t)entry;
+        if (pool->free_list->compare_exchange_weak(head, new_head))
+        {
+            return;
+        }
+    }
+}
+#endif
+
+void scratch_pool_init(scratch_pool* pool, size_t item_size)
+{
+    assert(pool);
+
+    pool->item_size = item_size;
+    pool->item_count = 0;
+    free_list_init(pool);
+}
+
+void* scratch_pool_acquire(scratch_pool* pool)
+{
+    assert(pool);
+
+    if (!pool->free_list)
+    {
+        return NULL;
+    }
+
+    char* item = free_list_pop(pool);
+    if (!item)
+    {
+        // all buffers are in use, only happens until the pool has warmed up
+        item = (char*)_aligned_malloc(SCRATCH_ITEM_HEADER_SIZE + pool->item_size, SCRATCH_ITEM_ALIGNMENT);
+        if (!item)
+        {
+            return NULL;
+        }
+        _InterlockedIncrement(&pool->item_count);
+    }
+    return item + SCRATCH_ITEM_HEADER_SIZE;
+}
+
+void scratch_pool_release(scratch_pool* pool, void* buffer)
+{
+    assert(pool);
+
+    if (!buffer)
+    {
+        return;
+    }
+    assert(pool->free_list);
+    free_list_push(pool, (char*)buffer - SCRATCH_ITEM_HEADER_SIZE);
+}
+
+void scratch_pool_destroy(scratch_pool* pool)
+{
+    assert(pool);
+
+    if (!pool->free_list)
+    {
+        return;
+    }
+
+    // no buffers are in use anymore
+    char* item;
+    while ((item = free_list_pop(pool)) != NULL)
+    {
+        _aligned_free(item);
+    }
+    free_list_destroy(pool);
+    pool->free_list = NULL;
+    pool->item_count = 0;
+}
+
+size_t scratch_pool_get_allocated_size(const scratch_pool* pool)
+{
+    assert(pool);
+
+    return pool->item_count * scratch_pool_get_item_allocated_size(pool->item_size);
+}
+
+size_t scratch_pool_get_item_allocated_size(size_t item_size)
+{
+    return SCRATCH_ITEM_HEADER_SIZE + item_size;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <stdint.h>
+#include <atomic>
+#endif
+
+// Lock-free pool of equally sized scratch buffers, borrowed by the processing
+// functions so the allocator isn't hit on every call.
+// Buffers are allocated on demand, so the pool grows up to the number of 
+// concurrent callers and stays there until it is destroyed.
+typedef struct _scratch_pool
+{
+#ifdef _WIN32
+    PSLIST_HEADER free_list;
+#else
+    // first free buffer and a tag, see scratch_pool.cpp
+    std::atomic<uint64_t>* free_list;
+#endif
+    size_t item_size;
+    // number of buffers allocated so far, including those in use
+    volatile long item_count;
+} scratch_pool;
+
+void scratch_pool_init(scratch_pool* pool, size_t item_size);
+
+// returns NULL if out of memory
+void* scratch_pool_acquire(scratch_pool* pool);
+
+void scratch_pool_release(scratch_pool* pool, void* buffer);
+
+void scratch_pool_destroy(scratch_pool* pool);
+
+// bytes allocated by the pool, including buffers in use
+size_t scratch_pool_get_allocated_size(const scratch_pool* pool);
+
+// bytes allocated for one buffer of item_size bytes
+size_t scratch_pool_get_item_allocated_size(size_t item_size);
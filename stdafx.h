@@ -7,9 +7,13 @@
 
 #include "targetver.h"
 
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers
 // Windows Header Files:
 #include <windows.h>
+#endif
+
+#include "compiler_compat.h"
 
 
 
@@ -55,8 +55,11 @@ def convert_param_item(item):
 
 
 def generate_param_set():
-    import debugging
-    debugging.setup()
+    try:
+        import debugging
+        debugging.setup()
+    except ImportError:
+        pass
     params = (
         list(product(
             (("y", "cb", "cr",),),
@@ -8,7 +8,11 @@
 #include "targetver.h"
 
 #include <stdio.h>
+#ifdef _WIN32
 #include <tchar.h>
+#endif
+
+#include "../compiler_compat.h"
 
 
 
@@ -1,10 +1,12 @@
 #include "stdafx.h"
 
 #include <memory>
+#include <algorithm>
 
 #include <gtest/gtest.h>
 
 #include "../include/f3kdb.h"
+#include "test_utils.h"
 
 using namespace testing;
 using namespace std;
@@ -53,34 +55,6 @@ typedef struct _case_frame_t {
     const unsigned char* frame_data;
 } case_frame_t;
 
-template <typename T>
-class AlignedMemoryDeleter
-{
-public:
-    void operator() (T*& ptr)
-    {
-        _aligned_free(ptr);
-        ptr = nullptr;
-    }
-};
-
-class F3kdbCoreDeleter
-{
-public:
-    void operator() (f3kdb_core_t*& ptr)
-    {
-        if (!ptr) {
-            return;
-        }
-        int ret = f3kdb_destroy(ptr);
-        ptr = nullptr;
-        assert(ret == F3KDB_SUCCESS);
-    }
-};
-
-typedef unique_ptr< unsigned char, AlignedMemoryDeleter<unsigned char> > aligned_buffer_ptr;
-typedef unique_ptr< f3kdb_core_t, F3kdbCoreDeleter > f3kdb_core_ptr;
-
 class CoreTest : public TestWithParam< tuple<const char*, const case_frame_t*> > {
 protected:
     virtual void SetUp() {
@@ -249,6 +223,564 @@ protected:
         }
     }
 
+    void do_stream_check(int rows_per_push) {
+        const int planes[] = {PLANE_Y, PLANE_CB, PLANE_CR};
+        char scoped_trace_text[2048];
+        memset(scoped_trace_text, 0, sizeof(scoped_trace_text));
+        for (OPTIMIZATION_MODE opt = IMPL_C; opt < IMPL_COUNT; opt = (OPTIMIZATION_MODE)(opt + 1)) {
+            _params.opt = opt;
+            f3kdb_core_t* core_out = nullptr;
+            int result = f3kdb_create(&_video_info, &_params, &core_out);
+            ASSERT_EQ(F3KDB_SUCCESS, result);
+            f3kdb_core_ptr core(core_out);
+            for (int i = 0; i < sizeof(planes) / sizeof(planes[0]); i++) {
+                int plane = planes[i];
+                _snprintf(scoped_trace_text, sizeof(scoped_trace_text) - 1, "opt = %d, plane = 0x%x", opt, plane);
+                SCOPED_TRACE(scoped_trace_text);
+
+                int src_pitch = 0;
+                aligned_buffer_ptr src_buffer;
+                const unsigned char* src_data_start = nullptr;
+                ASSERT_NO_FATAL_FAILURE(prepare_src_data(plane, &src_buffer, &src_data_start, &src_pitch));
+
+                int plane_height = _video_info.get_plane_height(plane);
+                int w_mul = _params.output_mode == HIGH_BIT_DEPTH_INTERLEAVED ? 2 : 1;
+                int h_mul = _params.output_mode == HIGH_BIT_DEPTH_STACKED ? 2 : 1;
+                int plane_height_raw = plane_height * h_mul;
+                int plane_width_raw = _video_info.get_plane_width(plane) * w_mul;
+                int dst_pitch = get_default_pitch(plane_width_raw);
+
+                unsigned char* reference_start = nullptr;
+                aligned_buffer_ptr reference_buffer(create_guarded_buffer(plane_height_raw, dst_pitch, &reference_start));
+                ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane(core.get(), 0, plane, reference_start, dst_pitch, src_data_start, src_pitch));
+
+                // rows that haven't arrived yet are filled with garbage, so reading them would change the output
+                int src_parts = _video_info.pixel_mode == HIGH_BIT_DEPTH_STACKED ? 2 : 1;
+                int src_buffer_size = src_pitch * plane_height * src_parts;
+                aligned_buffer_ptr arriving_buffer((unsigned char*)_aligned_malloc(src_buffer_size, PLANE_ALIGNMENT));
+                memset(arriving_buffer.get(), 0xff, src_buffer_size);
+                auto receive_rows = [&](int first_row, int row_count) {
+                    for (int part = 0; part < src_parts; part++) {
+                        int offset = src_pitch * (first_row + part * plane_height);
+                        memcpy(arriving_buffer.get() + offset, src_data_start + offset, src_pitch * row_count);
+                    }
+                };
+
+                unsigned char* stream_start = nullptr;
+                aligned_buffer_ptr stream_buffer(create_guarded_buffer(plane_height_raw, dst_pitch, &stream_start));
+                f3kdb_stream_t* stream = nullptr;
+                ASSERT_EQ(F3KDB_SUCCESS, f3kdb_stream_begin(core.get(), 0, plane, stream_start, dst_pitch, arriving_buffer.get(), src_pitch, &stream));
+                int rows_done = 0;
+                int available_rows = 0;
+                while (available_rows < plane_height) {
+                    int row_count = min(rows_per_push, plane_height - available_rows);
+                    receive_rows(available_rows, row_count);
+                    available_rows += row_count;
+                    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_stream_push_rows(stream, available_rows, &rows_done));
+                    ASSERT_LE(rows_done, available_rows);
+                    ASSERT_GE(rows_done, available_rows - _params.range);
+                }
+                ASSERT_EQ(plane_height, rows_done);
+                ASSERT_EQ(F3KDB_SUCCESS, f3kdb_stream_end(stream));
+
+                ASSERT_NO_FATAL_FAILURE(check_guard_bytes(stream_buffer.get(), plane_height_raw, dst_pitch));
+                assert_eq_plane(reference_start, stream_start, dst_pitch, plane_width_raw, plane_height_raw);
+                // rows would be overwritten before they are read as references
+                ASSERT_EQ(F3KDB_ERROR_INVALID_ARGUMENT, f3kdb_stream_begin(core.get(), 0, plane, stream_start, dst_pitch, stream_start, dst_pitch, &stream));
+                ASSERT_EQ(F3KDB_ERROR_INVALID_ARGUMENT, f3kdb_stream_begin(core.get(), 0, plane, stream_start + dst_pitch, dst_pitch, stream_start, dst_pitch, &stream));
+            }
+        }
+    }
+
+    // Source planes end right before an inaccessible page and have no padding at all,
+    // the plane is cropped so that rows don't end on a block boundary
+    void do_unpadded_input_check() {
+        f3kdb_video_info_t cropped_info = _video_info;
+        cropped_info.width -= 6;
+
+        f3kdb_core_ptr cores[IMPL_COUNT];
+        for (OPTIMIZATION_MODE opt = IMPL_C; opt < IMPL_COUNT; opt = (OPTIMIZATION_MODE)(opt + 1)) {
+            _params.opt = opt;
+            f3kdb_core_t* core_out = nullptr;
+            ASSERT_EQ(F3KDB_SUCCESS, f3kdb_create(&cropped_info, &_params, &core_out));
+            cores[opt].reset(core_out);
+        }
+
+        size_t page_size = get_page_size();
+
+        const int planes[] = {PLANE_Y, PLANE_CB, PLANE_CR};
+        char scoped_trace_text[2048];
+        memset(scoped_trace_text, 0, sizeof(scoped_trace_text));
+        for (int i = 0; i < sizeof(planes) / sizeof(planes[0]); i++) {
+            int plane = planes[i];
+            _snprintf(scoped_trace_text, sizeof(scoped_trace_text) - 1, "plane = 0x%x", plane);
+            SCOPED_TRACE(scoped_trace_text);
+
+            int src_pitch = 0;
+            aligned_buffer_ptr src_buffer;
+            const unsigned char* src_data_start = nullptr;
+            ASSERT_NO_FATAL_FAILURE(prepare_src_data(plane, &src_buffer, &src_data_start, &src_pitch));
+
+            int w_mul = _video_info.pixel_mode == HIGH_BIT_DEPTH_INTERLEAVED ? 2 : 1;
+            int h_mul = _video_info.pixel_mode == HIGH_BIT_DEPTH_STACKED ? 2 : 1;
+            int plane_height_raw = cropped_info.get_plane_height(plane) * h_mul;
+            int tight_pitch = cropped_info.get_plane_width(plane) * w_mul;
+
+            size_t data_size = tight_pitch * plane_height_raw;
+            size_t alloc_size = (data_size + page_size - 1) / page_size * page_size + page_size;
+            unsigned char* memory = alloc_pages(alloc_size);
+            ASSERT_NE(nullptr, memory);
+            ASSERT_TRUE(protect_pages_no_access(memory + alloc_size - page_size, page_size));
+            unsigned char* tight_data = memory + alloc_size - page_size - data_size;
+            for (int row = 0; row < plane_height_raw; row++) {
+                memcpy(tight_data + tight_pitch * row, src_data_start + src_pitch * row, tight_pitch);
+            }
+
+            int saved_width = _video_info.width;
+            _video_info.width = cropped_info.width;
+            aligned_buffer_ptr reference_buffer;
+            const unsigned char* reference_data_start = nullptr;
+            test_plane_impl(tight_data, tight_pitch, cores[IMPL_C].get(), plane, &reference_buffer, &reference_data_start);
+            for (OPTIMIZATION_MODE opt = (OPTIMIZATION_MODE)(IMPL_C + 1); opt < IMPL_COUNT && !HasFatalFailure(); opt = (OPTIMIZATION_MODE)(opt + 1)) {
+                _snprintf(scoped_trace_text, sizeof(scoped_trace_text) - 1, "opt = %d", opt);
+                SCOPED_TRACE(scoped_trace_text);
+                test_plane_impl(tight_data, tight_pitch, cores[opt].get(), plane, nullptr, &reference_data_start);
+            }
+            _video_info.width = saved_width;
+
+            free_pages(memory, alloc_size);
+            ASSERT_FALSE(HasFatalFailure());
+        }
+    }
+
+    // Output planes with odd addresses and pitch == width, rows don't end on a block boundary
+    void do_packed_output_check() {
+        static const unsigned char GUARD_BYTE = 0xcc;
+        static const int GUARD_SIZE = 64;
+
+        f3kdb_video_info_t cropped_info = _video_info;
+        cropped_info.width -= 6;
+
+        const int planes[] = {PLANE_Y, PLANE_CB, PLANE_CR};
+        char scoped_trace_text[2048];
+        memset(scoped_trace_text, 0, sizeof(scoped_trace_text));
+        for (int i = 0; i < sizeof(planes) / sizeof(planes[0]); i++) {
+            int plane = planes[i];
+
+            int src_pitch = 0;
+            aligned_buffer_ptr src_buffer;
+            const unsigned char* src_data_start = nullptr;
+            ASSERT_NO_FATAL_FAILURE(prepare_src_data(plane, &src_buffer, &src_data_start, &src_pitch));
+
+            int w_mul = _params.output_mode == HIGH_BIT_DEPTH_INTERLEAVED ? 2 : 1;
+            int h_mul = _params.output_mode == HIGH_BIT_DEPTH_STACKED ? 2 : 1;
+            int plane_height_raw = cropped_info.get_plane_height(plane) * h_mul;
+            int dst_pitch = cropped_info.get_plane_width(plane) * w_mul;
+            int data_size = dst_pitch * plane_height_raw;
+
+            vector<unsigned char> reference;
+            for (OPTIMIZATION_MODE opt = IMPL_C; opt < IMPL_COUNT; opt = (OPTIMIZATION_MODE)(opt + 1)) {
+                _snprintf(scoped_trace_text, sizeof(scoped_trace_text) - 1, "plane = 0x%x, opt = %d", plane, opt);
+                SCOPED_TRACE(scoped_trace_text);
+
+                _params.opt = opt;
+                f3kdb_core_t* core_out = nullptr;
+                ASSERT_EQ(F3KDB_SUCCESS, f3kdb_create(&cropped_info, &_params, &core_out));
+                f3kdb_core_ptr core(core_out);
+
+                // odd address, so the output is never aligned
+                aligned_buffer_ptr dst_buffer((unsigned char*)_aligned_malloc(data_size + GUARD_SIZE * 2 + 1, PLANE_ALIGNMENT));
+                unsigned char* dst = dst_buffer.get() + GUARD_SIZE + 1;
+                memset(dst_buffer.get(), GUARD_BYTE, data_size + GUARD_SIZE * 2 + 1);
+                ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane(core.get(), 0, plane, dst, dst_pitch, src_data_start, src_pitch));
+
+                for (int j = 0; j < GUARD_SIZE; j++) {
+                    ASSERT_EQ(GUARD_BYTE, dst[-1 - j]);
+                    ASSERT_EQ(GUARD_BYTE, dst[data_size + j]);
+                }
+                if (opt == IMPL_C) {
+                    reference.assign(dst, dst + data_size);
+                } else {
+                    ASSERT_EQ(0, memcmp(&reference[0], dst, data_size));
+                }
+            }
+        }
+    }
+
+    void do_rect_check() {
+        static const unsigned char UNTOUCHED = 0x5a;
+        f3kdb_core_ptr cores[IMPL_COUNT];
+        for (OPTIMIZATION_MODE opt = IMPL_C; opt < IMPL_COUNT; opt = (OPTIMIZATION_MODE)(opt + 1)) {
+            _params.opt = opt;
+            f3kdb_core_t* core_out = nullptr;
+            ASSERT_EQ(F3KDB_SUCCESS, f3kdb_create(&_video_info, &_params, &core_out));
+            cores[opt].reset(core_out);
+        }
+        // Floyd-Steinberg restarts at the rectangle, so only implementations can be compared with each other
+        bool compare_with_full_plane = _params.dither_algo != DA_HIGH_FLOYD_STEINBERG_DITHERING;
+        const int planes[] = {PLANE_Y, PLANE_CB, PLANE_CR};
+        char scoped_trace_text[2048];
+        memset(scoped_trace_text, 0, sizeof(scoped_trace_text));
+        for (int i = 0; i < sizeof(planes) / sizeof(planes[0]); i++) {
+            int plane = planes[i];
+
+            int src_pitch = 0;
+            aligned_buffer_ptr src_buffer;
+            const unsigned char* src_data_start = nullptr;
+            ASSERT_NO_FATAL_FAILURE(prepare_src_data(plane, &src_buffer, &src_data_start, &src_pitch, 1));
+
+            int plane_height = _video_info.get_plane_height(plane);
+            int plane_width = _video_info.get_plane_width(plane);
+            int w_mul = _params.output_mode == HIGH_BIT_DEPTH_INTERLEAVED ? 2 : 1;
+            int h_mul = _params.output_mode == HIGH_BIT_DEPTH_STACKED ? 2 : 1;
+            int plane_height_raw = plane_height * h_mul;
+            int plane_width_raw = plane_width * w_mul;
+            int dst_pitch = get_default_pitch(plane_width_raw);
+
+            // unaligned edges, edges inside a single block, and rectangles touching the plane borders
+            const int rects[][4] = {
+                {3, 5, plane_width / 2 + 1, plane_height / 3},
+                {9, 1, 3, 2},
+                {16, 2, 16, 3},
+                {plane_width - 5, plane_height - 4, 5, 4},
+                {7, 0, plane_width - 7, plane_height},
+            };
+            for (auto& rect : rects) {
+                int x = rect[0], y = rect[1], width = rect[2], height = rect[3];
+                aligned_buffer_ptr reference_buffer;
+                unsigned char* reference_start = nullptr;
+                for (OPTIMIZATION_MODE opt = IMPL_C; opt < IMPL_COUNT; opt = (OPTIMIZATION_MODE)(opt + 1)) {
+                    _snprintf(scoped_trace_text, sizeof(scoped_trace_text) - 1, "plane = 0x%x, opt = %d, rect = (%d, %d, %d, %d)", plane, opt, x, y, width, height);
+                    SCOPED_TRACE(scoped_trace_text);
+
+                    if (compare_with_full_plane || opt == IMPL_C) {
+                        reference_buffer.reset(create_guarded_buffer(plane_height_raw, dst_pitch, &reference_start));
+                        ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane(cores[opt].get(), 0, plane, reference_start, dst_pitch, src_data_start, src_pitch));
+                    }
+
+                    unsigned char* rect_start = nullptr;
+                    aligned_buffer_ptr rect_buffer(create_guarded_buffer(plane_height_raw, dst_pitch, &rect_start));
+                    memset(rect_start, UNTOUCHED, plane_height_raw * dst_pitch);
+                    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane_rect(cores[opt].get(), 0, plane, rect_start, dst_pitch, src_data_start, src_pitch, x, y, width, height));
+                    ASSERT_NO_FATAL_FAILURE(check_guard_bytes(rect_buffer.get(), plane_height_raw, dst_pitch));
+
+                    for (int row = 0; row < plane_height_raw; row++) {
+                        int plane_row = row % plane_height;
+                        for (int column = 0; column < plane_width_raw; column++) {
+                            int plane_column = column / w_mul;
+                            bool inside = plane_column >= x && plane_column < x + width && plane_row >= y && plane_row < y + height;
+                            int offset = row * dst_pitch + column;
+                            if (!inside) {
+                                ASSERT_EQ(UNTOUCHED, rect_start[offset]) << "row " << row << ", column " << column;
+                            } else if (!compare_with_full_plane && opt == IMPL_C) {
+                                // becomes the reference of other implementations
+                                reference_start[offset] = rect_start[offset];
+                            } else {
+                                ASSERT_EQ(reference_start[offset], rect_start[offset]) << "row " << row << ", column " << column;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    void do_in_place_check() {
+        f3kdb_params_t sanitized_params = _params;
+        ASSERT_EQ(F3KDB_SUCCESS, f3kdb_params_sanitize(&sanitized_params, F3KDB_INTERFACE_VERSION));
+        PIXEL_MODE output_mode = sanitized_params.output_mode;
+        const int planes[] = {PLANE_Y, PLANE_CB, PLANE_CR};
+        char scoped_trace_text[2048];
+        memset(scoped_trace_text, 0, sizeof(scoped_trace_text));
+        for (OPTIMIZATION_MODE opt = IMPL_C; opt < IMPL_COUNT; opt = (OPTIMIZATION_MODE)(opt + 1)) {
+            _params.opt = opt;
+            f3kdb_core_t* core_out = nullptr;
+            ASSERT_EQ(F3KDB_SUCCESS, f3kdb_create(&_video_info, &_params, &core_out));
+            f3kdb_core_ptr core(core_out);
+
+            for (int i = 0; i < sizeof(planes) / sizeof(planes[0]); i++) {
+                int plane = planes[i];
+                _snprintf(scoped_trace_text, sizeof(scoped_trace_text) - 1, "plane = 0x%x, opt = %d", plane, opt);
+                SCOPED_TRACE(scoped_trace_text);
+
+                int src_pitch = 0;
+                aligned_buffer_ptr src_buffer;
+                const unsigned char* src_data_start = nullptr;
+                ASSERT_NO_FATAL_FAILURE(prepare_src_data(plane, &src_buffer, &src_data_start, &src_pitch));
+                unsigned char* plane_data = const_cast<unsigned char*>(src_data_start);
+
+                if (_video_info.pixel_mode != output_mode || _video_info.pixel_mode == HIGH_BIT_DEPTH_STACKED) {
+                    ASSERT_EQ(F3KDB_ERROR_NOT_IMPLEMENTED, f3kdb_process_plane(core.get(), 0, plane, plane_data, src_pitch, plane_data, src_pitch));
+                    continue;
+                }
+
+                int plane_height = _video_info.get_plane_height(plane);
+                int plane_width_raw = _video_info.get_plane_width(plane) * (output_mode == HIGH_BIT_DEPTH_INTERLEAVED ? 2 : 1);
+
+                unsigned char* reference_start = nullptr;
+                aligned_buffer_ptr reference_buffer(create_guarded_buffer(plane_height, src_pitch, &reference_start));
+                ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane(core.get(), 0, plane, reference_start, src_pitch, src_data_start, src_pitch));
+
+                ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane(core.get(), 0, plane, plane_data, src_pitch, plane_data, src_pitch));
+                for (int row = 0; row < plane_height; row++) {
+                    ASSERT_EQ(0, memcmp(reference_start + src_pitch * row, plane_data + src_pitch * row, plane_width_raw)) << "row " << row;
+                }
+            }
+        }
+    }
+
+    void do_semi_planar_check() {
+        f3kdb_params_t sanitized_params = _params;
+        ASSERT_EQ(F3KDB_SUCCESS, f3kdb_params_sanitize(&sanitized_params, F3KDB_INTERFACE_VERSION));
+        PIXEL_MODE output_mode = sanitized_params.output_mode;
+
+        int plane_height = _video_info.get_plane_height(PLANE_CB);
+        int plane_width = _video_info.get_plane_width(PLANE_CB);
+        int in_sample_size = _video_info.pixel_mode == HIGH_BIT_DEPTH_INTERLEAVED ? 2 : 1;
+        int out_sample_size = output_mode == HIGH_BIT_DEPTH_INTERLEAVED ? 2 : 1;
+
+        aligned_buffer_ptr component_buffers[2];
+        const unsigned char* component_starts[2] = {nullptr};
+        int component_pitches[2] = {0};
+        ASSERT_NO_FATAL_FAILURE(prepare_src_data(PLANE_CB, &component_buffers[0], &component_starts[0], &component_pitches[0]));
+        ASSERT_NO_FATAL_FAILURE(prepare_src_data(PLANE_CR, &component_buffers[1], &component_starts[1], &component_pitches[1]));
+
+        // interleave the source planes, with an odd pitch so that rows are unaligned
+        int src_pitch = plane_width * in_sample_size * 2 + 1;
+        aligned_buffer_ptr src_buffer((unsigned char*)_aligned_malloc(src_pitch * plane_height, PLANE_ALIGNMENT));
+        for (int row = 0; row < plane_height; row++) {
+            for (int column = 0; column < plane_width; column++) {
+                for (int component = 0; component < 2; component++) {
+                    memcpy(src_buffer.get() + src_pitch * row + (column * 2 + component) * in_sample_size, 
+                           component_starts[component] + component_pitches[component] * row + column * in_sample_size, 
+                           in_sample_size);
+                }
+            }
+        }
+
+        int plane_width_raw = plane_width * out_sample_size;
+        int component_dst_pitch = get_default_pitch(plane_width_raw);
+        int dst_pitch = get_default_pitch(plane_width_raw * 2);
+
+        char scoped_trace_text[2048];
+        memset(scoped_trace_text, 0, sizeof(scoped_trace_text));
+        for (OPTIMIZATION_MODE opt = IMPL_C; opt < IMPL_COUNT; opt = (OPTIMIZATION_MODE)(opt + 1)) {
+            _snprintf(scoped_trace_text, sizeof(scoped_trace_text) - 1, "opt = %d", opt);
+            SCOPED_TRACE(scoped_trace_text);
+
+            _params.opt = opt;
+            f3kdb_core_t* core_out = nullptr;
+            ASSERT_EQ(F3KDB_SUCCESS, f3kdb_create(&_video_info, &_params, &core_out));
+            f3kdb_core_ptr core(core_out);
+
+            unsigned char* dst_start = nullptr;
+            aligned_buffer_ptr dst_buffer(create_guarded_buffer(plane_height, dst_pitch, &dst_start));
+            if (_video_info.pixel_mode == HIGH_BIT_DEPTH_STACKED || output_mode == HIGH_BIT_DEPTH_STACKED) {
+                ASSERT_EQ(F3KDB_ERROR_NOT_IMPLEMENTED, f3kdb_process_plane(core.get(), 1, PLANE_CBCR, dst_start, dst_pitch, src_buffer.get(), src_pitch));
+                continue;
+            }
+            ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane(core.get(), 1, PLANE_CBCR, dst_start, dst_pitch, src_buffer.get(), src_pitch));
+            ASSERT_NO_FATAL_FAILURE(check_guard_bytes(dst_buffer.get(), plane_height, dst_pitch));
+
+            // every component must be the same as if it was processed as a separate plane
+            const int planes[] = {PLANE_CB, PLANE_CR};
+            for (int component = 0; component < 2; component++) {
+                unsigned char* reference_start = nullptr;
+                aligned_buffer_ptr reference_buffer(create_guarded_buffer(plane_height, component_dst_pitch, &reference_start));
+                ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane(core.get(), 1, planes[component], reference_start, component_dst_pitch, component_starts[component], component_pitches[component]));
+                for (int row = 0; row < plane_height; row++) {
+                    for (int column = 0; column < plane_width; column++) {
+                        ASSERT_EQ(0, memcmp(reference_start + component_dst_pitch * row + column * out_sample_size, 
+                                            dst_start + dst_pitch * row + (column * 2 + component) * out_sample_size, 
+                                            out_sample_size)) << "component " << component << ", row " << row << ", column " << column;
+                    }
+                }
+            }
+
+            if (_video_info.pixel_mode == output_mode) {
+                aligned_buffer_ptr in_place_buffer((unsigned char*)_aligned_malloc(src_pitch * plane_height, PLANE_ALIGNMENT));
+                memcpy(in_place_buffer.get(), src_buffer.get(), src_pitch * plane_height);
+                ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane(core.get(), 1, PLANE_CBCR, in_place_buffer.get(), src_pitch, in_place_buffer.get(), src_pitch));
+                for (int row = 0; row < plane_height; row++) {
+                    ASSERT_EQ(0, memcmp(dst_start + dst_pitch * row, in_place_buffer.get() + src_pitch * row, plane_width_raw * 2)) << "row " << row;
+                }
+            }
+        }
+    }
+
+    // MSB-aligned input and output must be the same as LSB-aligned ones shifted to the high bits
+    void do_msb_aligned_check() {
+        f3kdb_params_t sanitized_params = _params;
+        ASSERT_EQ(F3KDB_SUCCESS, f3kdb_params_sanitize(&sanitized_params, F3KDB_INTERFACE_VERSION));
+        if (_video_info.pixel_mode != HIGH_BIT_DEPTH_INTERLEAVED || sanitized_params.output_mode != HIGH_BIT_DEPTH_INTERLEAVED) {
+            return;
+        }
+        int input_shift = 16 - _video_info.depth;
+        int output_shift = 16 - sanitized_params.output_depth;
+
+        f3kdb_video_info_t msb_video_info = _video_info;
+        msb_video_info.pixel_mode = HIGH_BIT_DEPTH_INTERLEAVED_MSB;
+        f3kdb_params_t msb_params = _params;
+        msb_params.output_mode = HIGH_BIT_DEPTH_INTERLEAVED_MSB;
+
+        const int planes[] = {PLANE_Y, PLANE_CB, PLANE_CR};
+        char scoped_trace_text[2048];
+        memset(scoped_trace_text, 0, sizeof(scoped_trace_text));
+        for (OPTIMIZATION_MODE opt = IMPL_C; opt < IMPL_COUNT; opt = (OPTIMIZATION_MODE)(opt + 1)) {
+            _params.opt = opt;
+            msb_params.opt = opt;
+            f3kdb_core_t* core_out = nullptr;
+            ASSERT_EQ(F3KDB_SUCCESS, f3kdb_create(&_video_info, &_params, &core_out));
+            f3kdb_core_ptr core(core_out);
+            ASSERT_EQ(F3KDB_SUCCESS, f3kdb_create(&msb_video_info, &msb_params, &core_out));
+            f3kdb_core_ptr msb_core(core_out);
+
+            for (int i = 0; i < sizeof(planes) / sizeof(planes[0]); i++) {
+                int plane = planes[i];
+                _snprintf(scoped_trace_text, sizeof(scoped_trace_text) - 1, "plane = 0x%x, opt = %d", plane, opt);
+                SCOPED_TRACE(scoped_trace_text);
+
+                int src_pitch = 0;
+                aligned_buffer_ptr src_buffer;
+                const unsigned char* src_data_start = nullptr;
+                ASSERT_NO_FATAL_FAILURE(prepare_src_data(plane, &src_buffer, &src_data_start, &src_pitch));
+
+                int plane_height = _video_info.get_plane_height(plane);
+                int plane_width = _video_info.get_plane_width(plane);
+                aligned_buffer_ptr msb_src_buffer((unsigned char*)_aligned_malloc(src_pitch * plane_height, PLANE_ALIGNMENT));
+                for (int row = 0; row < plane_height; row++) {
+                    auto src_row = (const unsigned short*)(src_data_start + src_pitch * row);
+                    auto msb_row = (unsigned short*)(msb_src_buffer.get() + src_pitch * row);
+                    for (int column = 0; column < plane_width; column++) {
+                        msb_row[column] = (unsigned short)(src_row[column] << input_shift);
+                    }
+                }
+
+                int dst_pitch = get_default_pitch(plane_width * 2);
+                unsigned char* reference_start = nullptr;
+                aligned_buffer_ptr reference_buffer(create_guarded_buffer(plane_height, dst_pitch, &reference_start));
+                ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane(core.get(), 0, plane, reference_start, dst_pitch, src_data_start, src_pitch));
+                unsigned char* dst_start = nullptr;
+                aligned_buffer_ptr dst_buffer(create_guarded_buffer(plane_height, dst_pitch, &dst_start));
+                ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane(msb_core.get(), 0, plane, dst_start, dst_pitch, msb_src_buffer.get(), src_pitch));
+                ASSERT_NO_FATAL_FAILURE(check_guard_bytes(dst_buffer.get(), plane_height, dst_pitch));
+
+                for (int row = 0; row < plane_height; row++) {
+                    auto reference_row = (const unsigned short*)(reference_start + dst_pitch * row);
+                    auto dst_row = (const unsigned short*)(dst_start + dst_pitch * row);
+                    for (int column = 0; column < plane_width; column++) {
+                        ASSERT_EQ((unsigned short)(reference_row[column] << output_shift), dst_row[column]) << "row " << row << ", column " << column;
+                    }
+                }
+            }
+        }
+    }
+
+    // source plane as MSB-aligned 16-bit samples
+    void prepare_src_data_16bit(int plane, vector<unsigned short>* data_out) {
+        int src_pitch = 0;
+        aligned_buffer_ptr src_buffer;
+        const unsigned char* src_data_start = nullptr;
+        ASSERT_NO_FATAL_FAILURE(prepare_src_data(plane, &src_buffer, &src_data_start, &src_pitch));
+
+        int plane_height = _video_info.get_plane_height(plane);
+        int plane_width = _video_info.get_plane_width(plane);
+        data_out->resize(plane_width * plane_height);
+        for (int row = 0; row < plane_height; row++) {
+            const unsigned char* src_row = src_data_start + src_pitch * row;
+            for (int column = 0; column < plane_width; column++) {
+                int value;
+                switch (_video_info.pixel_mode) {
+                case LOW_BIT_DEPTH:
+                    value = src_row[column] << 8;
+                    break;
+                case HIGH_BIT_DEPTH_STACKED:
+                    value = (src_row[column] << 8 | src_row[column + src_pitch * plane_height]) << (16 - _video_info.depth);
+                    break;
+                default:
+                    value = ((const unsigned short*)src_row)[column] << (16 - _video_info.depth);
+                    break;
+                }
+                (*data_out)[row * plane_width + column] = (unsigned short)value;
+            }
+        }
+    }
+
+    // float input and output must be the same as 16-bit ones mapped to [0, 1] / [-0.5, 0.5]
+    void do_float_check() {
+        f3kdb_params_t sanitized_params = _params;
+        ASSERT_EQ(F3KDB_SUCCESS, f3kdb_params_sanitize(&sanitized_params, F3KDB_INTERFACE_VERSION));
+        if (sanitized_params.output_mode != HIGH_BIT_DEPTH_INTERLEAVED) {
+            return;
+        }
+
+        f3kdb_video_info_t video_info_16 = _video_info;
+        video_info_16.pixel_mode = HIGH_BIT_DEPTH_INTERLEAVED_MSB;
+        video_info_16.depth = 16;
+        f3kdb_video_info_t video_info_float = _video_info;
+        video_info_float.pixel_mode = HIGH_BIT_DEPTH_FLOAT;
+        video_info_float.depth = 32;
+        f3kdb_params_t params_16 = _params;
+        params_16.output_mode = HIGH_BIT_DEPTH_INTERLEAVED_MSB;
+        params_16.output_depth = 16;
+        f3kdb_params_t params_float = _params;
+        params_float.output_mode = HIGH_BIT_DEPTH_FLOAT;
+        params_float.output_depth = 32;
+
+        const int planes[] = {PLANE_Y, PLANE_CB, PLANE_CR};
+        char scoped_trace_text[2048];
+        memset(scoped_trace_text, 0, sizeof(scoped_trace_text));
+        for (OPTIMIZATION_MODE opt = IMPL_C; opt < IMPL_COUNT; opt = (OPTIMIZATION_MODE)(opt + 1)) {
+            _params.opt = params_16.opt = params_float.opt = opt;
+            f3kdb_core_t* core_out = nullptr;
+            // 16-bit to integer output / float to integer output
+            ASSERT_EQ(F3KDB_SUCCESS, f3kdb_create(&video_info_16, &_params, &core_out));
+            f3kdb_core_ptr core_16_int(core_out);
+            ASSERT_EQ(F3KDB_SUCCESS, f3kdb_create(&video_info_float, &_params, &core_out));
+            f3kdb_core_ptr core_float_int(core_out);
+            // 16-bit to 16-bit / float to float
+            ASSERT_EQ(F3KDB_SUCCESS, f3kdb_create(&video_info_16, &params_16, &core_out));
+            f3kdb_core_ptr core_16_16(core_out);
+            ASSERT_EQ(F3KDB_SUCCESS, f3kdb_create(&video_info_float, &params_float, &core_out));
+            f3kdb_core_ptr core_float_float(core_out);
+
+            for (int i = 0; i < sizeof(planes) / sizeof(planes[0]); i++) {
+                int plane = planes[i];
+                _snprintf(scoped_trace_text, sizeof(scoped_trace_text) - 1, "plane = 0x%x, opt = %d", plane, opt);
+                SCOPED_TRACE(scoped_trace_text);
+
+                int plane_height = _video_info.get_plane_height(plane);
+                int plane_width = _video_info.get_plane_width(plane);
+                float offset = plane == PLANE_Y ? 0.0f : 0.5f;
+
+                vector<unsigned short> src_16;
+                ASSERT_NO_FATAL_FAILURE(prepare_src_data_16bit(plane, &src_16));
+                vector<float> src_float(src_16.size());
+                for (size_t j = 0; j < src_16.size(); j++) {
+                    src_float[j] = src_16[j] / 65535.0f - offset;
+                }
+                int pitch_16 = plane_width * 2;
+                int pitch_float = plane_width * 4;
+
+                vector<unsigned short> reference(src_16.size());
+                vector<unsigned short> dst_int(src_16.size());
+                ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane(core_16_int.get(), 0, plane, (unsigned char*)&reference[0], pitch_16, (const unsigned char*)&src_16[0], pitch_16));
+                ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane(core_float_int.get(), 0, plane, (unsigned char*)&dst_int[0], pitch_16, (const unsigned char*)&src_float[0], pitch_float));
+                ASSERT_EQ(reference, dst_int);
+
+                ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane(core_16_16.get(), 0, plane, (unsigned char*)&reference[0], pitch_16, (const unsigned char*)&src_16[0], pitch_16));
+                vector<float> dst_float(src_16.size());
+                ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane(core_float_float.get(), 0, plane, (unsigned char*)&dst_float[0], pitch_float, (const unsigned char*)&src_float[0], pitch_float));
+                for (size_t j = 0; j < reference.size(); j++) {
+                    ASSERT_NEAR(reference[j] / 65535.0f - offset, dst_float[j], 1e-6) << "pixel " << j;
+                }
+
+                ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane(core_float_float.get(), 0, plane, (unsigned char*)&src_float[0], pitch_float, (const unsigned char*)&src_float[0], pitch_float));
+                ASSERT_EQ(dst_float, src_float);
+            }
+        }
+    }
+
 };
 
 TEST_P(CoreTest, CoreCheckAligned) {
@@ -263,6 +795,412 @@ TEST_P(CoreTest, CoreCheckUnalignedPitch) {
     do_core_check(0, PLANE_ALIGNMENT - 1);
 }
 
+TEST_P(CoreTest, CoreCheckUnpaddedInput) {
+    do_unpadded_input_check();
+}
+
+TEST_P(CoreTest, CoreCheckPackedOutput) {
+    do_packed_output_check();
+}
+
+TEST_P(CoreTest, StreamCheck) {
+    do_stream_check(7);
+}
+
+TEST_P(CoreTest, RectCheck) {
+    do_rect_check();
+}
+
+TEST_P(CoreTest, InPlaceCheck) {
+    do_in_place_check();
+}
+
+TEST_P(CoreTest, SemiPlanarCheck) {
+    do_semi_planar_check();
+}
+
+TEST_P(CoreTest, MsbAlignedCheck) {
+    do_msb_aligned_check();
+}
+
+TEST_P(CoreTest, FloatCheck) {
+    do_float_check();
+}
+
+TEST(CoreLutTest, LutBacking) {
+    f3kdb_video_info_t video_info;
+    memset(&video_info, 0, sizeof(video_info));
+    video_info.width = 64;
+    video_info.height = 64;
+    video_info.chroma_width_subsampling = 1;
+    video_info.chroma_height_subsampling = 1;
+    video_info.pixel_mode = LOW_BIT_DEPTH;
+    video_info.depth = 8;
+    video_info.num_frames = 1;
+
+    f3kdb_params_t params;
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_params_init_defaults(&params));
+
+    f3kdb_core_t* core_out = nullptr;
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_create(&video_info, &params, &core_out));
+    f3kdb_core_ptr core(core_out);
+
+    ASSERT_EQ(F3KDB_ERROR_INVALID_ARGUMENT, f3kdb_get_lut_backing(core.get(), nullptr));
+    LUT_BACKING backing = LUT_BACKING_COUNT;
+    ASSERT_EQ(F3KDB_ERROR_INVALID_ARGUMENT, f3kdb_get_lut_backing(nullptr, &backing));
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_get_lut_backing(core.get(), &backing));
+    // tables of tiny frames never fill a large page
+    ASSERT_EQ(LUT_BACKING_REGULAR_PAGES, backing);
+
+    // large pages are opt-in
+    video_info.width = 3840;
+    video_info.height = 2160;
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_create(&video_info, &params, &core_out));
+    core.reset(core_out);
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_get_lut_backing(core.get(), &backing));
+    ASSERT_EQ(LUT_BACKING_REGULAR_PAGES, backing);
+}
+
+static void init_memory_test_video_info(f3kdb_video_info_t* video_info, int width, int height) {
+    memset(video_info, 0, sizeof(f3kdb_video_info_t));
+    video_info->width = width;
+    video_info->height = height;
+    video_info->chroma_width_subsampling = 1;
+    video_info->chroma_height_subsampling = 1;
+    video_info->pixel_mode = LOW_BIT_DEPTH;
+    video_info->depth = 8;
+    video_info->num_frames = 10;
+}
+
+TEST(CoreMemoryTest, MemoryUsage) {
+    f3kdb_video_info_t video_info;
+    init_memory_test_video_info(&video_info, 640, 480);
+
+    f3kdb_params_t params;
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_params_init_defaults(&params));
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_params_fill_by_string(&params, "dynamic_grain=true/opt=1"));
+
+    f3kdb_core_t* core_out = nullptr;
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_create(&video_info, &params, &core_out));
+    f3kdb_core_ptr core(core_out);
+
+    ASSERT_EQ(F3KDB_ERROR_INVALID_ARGUMENT, f3kdb_get_memory_usage(core.get(), nullptr));
+
+    f3kdb_memory_usage_t usage;
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_get_memory_usage(core.get(), &usage));
+    // 4 bytes per pixel of each plane
+    ASSERT_GE(usage.pixel_info, 640u * 480 * 4 * 3 / 2);
+    ASSERT_GE(usage.offset_cache, 640u * 480 * 4 * 3 / 2);
+    // luma-sized buffers for luma and chroma, 3 frames worth each
+    ASSERT_GE(usage.grain_buffer, 640u * 480 * 2 * 3 * 2);
+    ASSERT_EQ(sizeof(int) * 10, usage.frame_offsets);
+    ASSERT_EQ(0u, usage.scratch_buffer);
+    ASSERT_EQ(0u, usage.staging_buffer);
+    ASSERT_EQ(usage.pixel_info + usage.offset_cache + usage.grain_buffer + usage.frame_offsets, usage.total);
+
+    int pitch = 640;
+    aligned_buffer_ptr src((unsigned char*)_aligned_malloc(pitch * 480, PLANE_ALIGNMENT));
+    aligned_buffer_ptr dst((unsigned char*)_aligned_malloc(pitch * 480, PLANE_ALIGNMENT));
+    memset(src.get(), 128, pitch * 480);
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane(core.get(), 0, PLANE_Y, dst.get(), pitch, src.get(), pitch));
+
+    // borrowed buffers stay in the core
+    f3kdb_memory_usage_t usage_after;
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_get_memory_usage(core.get(), &usage_after));
+    ASSERT_GT(usage_after.staging_buffer, 0u);
+    ASSERT_EQ(usage.total + usage_after.scratch_buffer + usage_after.staging_buffer, usage_after.total);
+}
+
+TEST(CoreMemoryTest, MemoryBudget) {
+    f3kdb_video_info_t video_info;
+    // DCI 4K, where the staging buffer crosses a MB boundary of the total
+    init_memory_test_video_info(&video_info, 4096, 2160);
+
+    f3kdb_params_t params;
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_params_init_defaults(&params));
+
+    f3kdb_core_t* core_out = nullptr;
+    char error_msg[256] = {0};
+    params.memory_budget = 16;
+    ASSERT_EQ(F3KDB_ERROR_INSUFFICIENT_MEMORY, f3kdb_create(&video_info, &params, &core_out, error_msg, sizeof(error_msg)));
+    ASSERT_EQ(nullptr, core_out);
+    ASSERT_NE(nullptr, strstr(error_msg, "memory_budget"));
+
+    params.memory_budget = -1;
+    ASSERT_EQ(F3KDB_ERROR_INVALID_ARGUMENT, f3kdb_create(&video_info, &params, &core_out));
+
+    params.memory_budget = 0;
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_create(&video_info, &params, &core_out));
+    f3kdb_core_ptr core(core_out);
+
+    int pitch = 4096;
+    aligned_buffer_ptr src((unsigned char*)_aligned_malloc(pitch * 2160, PLANE_ALIGNMENT));
+    aligned_buffer_ptr dst((unsigned char*)_aligned_malloc(pitch * 2160, PLANE_ALIGNMENT));
+    aligned_buffer_ptr budget_dst((unsigned char*)_aligned_malloc(pitch * 2160, PLANE_ALIGNMENT));
+    for (int i = 0; i < pitch * 2160; i++) {
+        src.get()[i] = (unsigned char)(i % 4096 / 15 + i / 4096 / 9);
+    }
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane(core.get(), 0, PLANE_Y, dst.get(), pitch, src.get(), pitch));
+    // in-place processing borrows the row window, which the budget covers as well
+    memcpy(budget_dst.get(), src.get(), pitch * 2160);
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane(core.get(), 0, PLANE_Y, budget_dst.get(), pitch, budget_dst.get(), pitch));
+    ASSERT_EQ(0, memcmp(dst.get(), budget_dst.get(), pitch * 2160));
+    f3kdb_memory_usage_t usage;
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_get_memory_usage(core.get(), &usage));
+    ASSERT_GT(usage.staging_buffer, 0u);
+
+    // a budget that fits everything but the staging buffer turns off staging
+    params.memory_budget = (int)((usage.total - usage.staging_buffer + (1 << 20) - 1) >> 20);
+    ASSERT_LT((size_t)params.memory_budget << 20, usage.total);
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_create(&video_info, &params, &core_out));
+    f3kdb_core_ptr budget_core(core_out);
+
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane(budget_core.get(), 0, PLANE_Y, budget_dst.get(), pitch, src.get(), pitch));
+    ASSERT_EQ(0, memcmp(dst.get(), budget_dst.get(), pitch * 2160));
+    memcpy(budget_dst.get(), src.get(), pitch * 2160);
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane(budget_core.get(), 0, PLANE_Y, budget_dst.get(), pitch, budget_dst.get(), pitch));
+    ASSERT_EQ(0, memcmp(dst.get(), budget_dst.get(), pitch * 2160));
+
+    f3kdb_memory_usage_t budget_usage;
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_get_memory_usage(budget_core.get(), &budget_usage));
+    ASSERT_EQ(0u, budget_usage.staging_buffer);
+    ASSERT_GT(budget_usage.scratch_buffer, 0u);
+    ASSERT_LE(budget_usage.total, (size_t)params.memory_budget << 20);
+}
+
+TEST(CoreRgbTest, SharedLut) {
+    f3kdb_video_info_t video_info;
+    init_memory_test_video_info(&video_info, 640, 480);
+    video_info.color_family = COLOR_FAMILY_RGB;
+
+    f3kdb_params_t params;
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_params_init_defaults(&params));
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_params_fill_by_string(&params, "Y=64/Cb=0/Cr=64/grainY=0/grainC=0"));
+
+    f3kdb_core_t* core_out = nullptr;
+    // RGB planes are never subsampled
+    ASSERT_EQ(F3KDB_ERROR_INVALID_ARGUMENT, f3kdb_create(&video_info, &params, &core_out));
+
+    video_info.chroma_width_subsampling = 0;
+    video_info.chroma_height_subsampling = 0;
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_create(&video_info, &params, &core_out));
+    f3kdb_core_ptr core(core_out);
+
+    video_info.color_family = COLOR_FAMILY_YUV;
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_create(&video_info, &params, &core_out));
+    f3kdb_core_ptr yuv_core(core_out);
+
+    f3kdb_memory_usage_t usage, yuv_usage;
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_get_memory_usage(core.get(), &usage));
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_get_memory_usage(yuv_core.get(), &yuv_usage));
+    ASSERT_EQ(yuv_usage.pixel_info, usage.pixel_info * 3);
+    ASSERT_EQ(yuv_usage.offset_cache, usage.offset_cache * 3);
+    // G and B share a grain buffer without grainC
+    ASSERT_EQ(yuv_usage.grain_buffer, usage.grain_buffer);
+
+    int pitch = 640;
+    aligned_buffer_ptr src((unsigned char*)_aligned_malloc(pitch * 480, PLANE_ALIGNMENT));
+    aligned_buffer_ptr dst_r((unsigned char*)_aligned_malloc(pitch * 480, PLANE_ALIGNMENT));
+    aligned_buffer_ptr dst_g((unsigned char*)_aligned_malloc(pitch * 480, PLANE_ALIGNMENT));
+    aligned_buffer_ptr dst_b((unsigned char*)_aligned_malloc(pitch * 480, PLANE_ALIGNMENT));
+    for (int i = 0; i < pitch * 480; i++) {
+        src.get()[i] = (unsigned char)(i % 640 / 15 + i / 640 / 9);
+    }
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane(core.get(), 0, PLANE_R, dst_r.get(), pitch, src.get(), pitch));
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane(core.get(), 0, PLANE_G, dst_g.get(), pitch, src.get(), pitch));
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane(core.get(), 0, PLANE_B, dst_b.get(), pitch, src.get(), pitch));
+
+    // thresholds are Y, Cb and Cr for R, G and B, G is left alone
+    ASSERT_EQ(0, memcmp(src.get(), dst_g.get(), pitch * 480));
+    ASSERT_NE(0, memcmp(src.get(), dst_r.get(), pitch * 480));
+    // same threshold, same reference positions and no grain
+    ASSERT_EQ(0, memcmp(dst_r.get(), dst_b.get(), pitch * 480));
+
+    // grainC applies to G and B, so R differs from B only by grain
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_params_fill_by_string(&params, "grainC=64"));
+    video_info.color_family = COLOR_FAMILY_RGB;
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_create(&video_info, &params, &core_out));
+    f3kdb_core_ptr grain_c_core(core_out);
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane(grain_c_core.get(), 0, PLANE_R, dst_r.get(), pitch, src.get(), pitch));
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane(grain_c_core.get(), 0, PLANE_B, dst_b.get(), pitch, src.get(), pitch));
+    ASSERT_NE(0, memcmp(dst_r.get(), dst_b.get(), pitch * 480));
+    // one grain buffer per plane with grainC
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_get_memory_usage(grain_c_core.get(), &usage));
+    ASSERT_EQ(yuv_usage.grain_buffer / 2 * 3, usage.grain_buffer);
+
+    // grain of each plane is independent
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_params_fill_by_string(&params, "Cb=64/grainY=64"));
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_create(&video_info, &params, &core_out));
+    f3kdb_core_ptr grain_core(core_out);
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane(grain_core.get(), 0, PLANE_R, dst_r.get(), pitch, src.get(), pitch));
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane(grain_core.get(), 0, PLANE_G, dst_g.get(), pitch, src.get(), pitch));
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane(grain_core.get(), 0, PLANE_B, dst_b.get(), pitch, src.get(), pitch));
+    ASSERT_NE(0, memcmp(dst_r.get(), dst_g.get(), pitch * 480));
+    ASSERT_NE(0, memcmp(dst_g.get(), dst_b.get(), pitch * 480));
+}
+
+TEST(CorePassthroughTest, PlanePassthrough) {
+    f3kdb_video_info_t video_info;
+    init_memory_test_video_info(&video_info, 64, 32);
+
+    f3kdb_params_t params;
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_params_init_defaults(&params));
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_params_fill_by_string(&params, "Cb=0/Cr=0/grainC=0/output_depth=8"));
+    f3kdb_core_t* core_out = nullptr;
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_create(&video_info, &params, &core_out));
+    f3kdb_core_ptr core(core_out);
+
+    int passthrough = -1;
+    ASSERT_EQ(F3KDB_ERROR_INVALID_ARGUMENT, f3kdb_get_plane_passthrough(core.get(), PLANE_CBCR, &passthrough));
+    ASSERT_EQ(F3KDB_ERROR_INVALID_ARGUMENT, f3kdb_get_plane_passthrough(core.get(), PLANE_Y, nullptr));
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_get_plane_passthrough(core.get(), PLANE_Y, &passthrough));
+    ASSERT_EQ(0, passthrough);
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_get_plane_passthrough(core.get(), PLANE_CB, &passthrough));
+    ASSERT_EQ(1, passthrough);
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_get_plane_passthrough(core.get(), PLANE_CR, &passthrough));
+    ASSERT_EQ(1, passthrough);
+
+    // chroma still has to be converted
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_params_fill_by_string(&params, "output_depth=16/output_mode=2"));
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_create(&video_info, &params, &core_out));
+    f3kdb_core_ptr core_16(core_out);
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_get_plane_passthrough(core_16.get(), PLANE_CB, &passthrough));
+    ASSERT_EQ(0, passthrough);
+}
+
+TEST(CoreV210Test, MatchesPlanes) {
+    static const char* const param_strings[] = {
+        "output_depth=10/output_mode=2",
+        "output_depth=10/output_mode=2/dither_algo=2",
+        "output_depth=10/output_mode=2/dither_algo=1/dynamic_grain=true",
+        // nothing to do for luma, which is copied
+        "output_depth=10/output_mode=2/Y=0/grainY=0",
+    };
+    // whole groups of 6 pixels, partial last groups of 2 and 4 pixels, and the narrowest frames
+    static const int widths[] = {96, 98, 100, 16, 20};
+    static const int depths[] = {8, 10};
+    int height = 40;
+
+    char scoped_trace_text[256];
+    for (int w = 0; w < sizeof(widths) / sizeof(widths[0]); w++)
+    for (int d = 0; d < sizeof(depths) / sizeof(depths[0]); d++)
+    for (int s = 0; s < sizeof(param_strings) / sizeof(param_strings[0]); s++)
+    for (OPTIMIZATION_MODE opt = IMPL_C; opt < IMPL_COUNT; opt = (OPTIMIZATION_MODE)(opt + 1)) {
+        int width = widths[w];
+        _snprintf(scoped_trace_text, sizeof(scoped_trace_text) - 1, "width = %d, depth = %d, params = %s, opt = %d", width, depths[d], param_strings[s], opt);
+        SCOPED_TRACE(scoped_trace_text);
+
+        f3kdb_video_info_t video_info;
+        memset(&video_info, 0, sizeof(video_info));
+        video_info.width = width;
+        video_info.height = height;
+        video_info.chroma_width_subsampling = 1;
+        video_info.chroma_height_subsampling = 0;
+        video_info.depth = depths[d];
+        video_info.pixel_mode = depths[d] == 8 ? LOW_BIT_DEPTH : HIGH_BIT_DEPTH_INTERLEAVED;
+        video_info.num_frames = 10;
+
+        f3kdb_params_t params;
+        ASSERT_EQ(F3KDB_SUCCESS, f3kdb_params_init_defaults(&params));
+        ASSERT_EQ(F3KDB_SUCCESS, f3kdb_params_fill_by_string(&params, param_strings[s]));
+        params.opt = opt;
+        f3kdb_core_t* core_out = nullptr;
+        ASSERT_EQ(F3KDB_SUCCESS, f3kdb_create(&video_info, &params, &core_out));
+        f3kdb_core_ptr core(core_out);
+
+        // banded gradients, different in every plane
+        int sample_size = depths[d] == 8 ? 1 : 2;
+        aligned_buffer_ptr src_buffers[3];
+        const unsigned char* src_planes[3];
+        int src_pitches[3];
+        for (int i = 0; i < 3; i++) {
+            int plane_width = i == 0 ? width : width / 2;
+            src_pitches[i] = plane_width * sample_size;
+            src_buffers[i].reset((unsigned char*)_aligned_malloc(src_pitches[i] * height, PLANE_ALIGNMENT));
+            for (int row = 0; row < height; row++) {
+                for (int column = 0; column < plane_width; column++) {
+                    int value = (column / (5 + i) + row / 7 + i * 20) % 200 + 20;
+                    if (sample_size == 1) {
+                        src_buffers[i].get()[src_pitches[i] * row + column] = (unsigned char)value;
+                    } else {
+                        ((unsigned short*)(src_buffers[i].get() + src_pitches[i] * row))[column] = (unsigned short)(value << 2);
+                    }
+                }
+            }
+            src_planes[i] = src_buffers[i].get();
+        }
+
+        int dst_pitch = (width + 47) / 48 * 128;
+        int row_bytes = (width + 5) / 6 * 16;
+        aligned_buffer_ptr dst((unsigned char*)_aligned_malloc(dst_pitch * height, PLANE_ALIGNMENT));
+        memset(dst.get(), 0xcc, dst_pitch * height);
+        ASSERT_EQ(F3KDB_ERROR_INVALID_ARGUMENT, f3kdb_process_frame_v210(core.get(), 1, dst.get(), row_bytes - 1, src_planes, src_pitches));
+        ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_frame_v210(core.get(), 1, dst.get(), dst_pitch, src_planes, src_pitches));
+
+        static const int planes[] = {PLANE_Y, PLANE_CB, PLANE_CR};
+        aligned_buffer_ptr reference[3];
+        int reference_pitches[3];
+        for (int i = 0; i < 3; i++) {
+            reference_pitches[i] = (i == 0 ? width : width / 2) * 2;
+            reference[i].reset((unsigned char*)_aligned_malloc(reference_pitches[i] * height, PLANE_ALIGNMENT));
+            ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane(core.get(), 1, planes[i], reference[i].get(), reference_pitches[i], src_planes[i], src_pitches[i]));
+        }
+
+        for (int row = 0; row < height; row++) {
+            const unsigned char* dst_row = dst.get() + dst_pitch * row;
+            const unsigned short* y = (const unsigned short*)(reference[0].get() + reference_pitches[0] * row);
+            const unsigned short* cb = (const unsigned short*)(reference[1].get() + reference_pitches[1] * row);
+            const unsigned short* cr = (const unsigned short*)(reference[2].get() + reference_pitches[2] * row);
+            for (int group = 0; group < row_bytes / 16; group++) {
+                unsigned int words[4];
+                memcpy(words, dst_row + group * 16, sizeof(words));
+                // samples of a group in the order they are stored, 3 in each word
+                const unsigned short* sources[12] = {
+                    cb, y, cr, y, cb, y, cr, y, cb, y, cr, y
+                };
+                int indices[12] = {0, 0, 0, 1, 1, 2, 1, 3, 2, 4, 2, 5};
+                for (int i = 0; i < 12; i++) {
+                    int sample = (words[i / 3] >> (i % 3 * 10)) & 0x3ff;
+                    int limit = sources[i] == y ? width : width / 2;
+                    int index = sources[i] == y ? group * 6 + indices[i] : group * 3 + indices[i];
+                    int expected = index < limit ? sources[i][index] : 0;
+                    ASSERT_EQ(expected, sample) << "row " << row << ", group " << group << ", sample " << i;
+                }
+                for (int i = 0; i < 4; i++) {
+                    ASSERT_EQ(0u, words[i] >> 30);
+                }
+            }
+            for (int i = row_bytes; i < dst_pitch; i++) {
+                ASSERT_EQ(0xcc, dst_row[i]);
+            }
+        }
+    }
+}
+
+TEST(CoreV210Test, InvalidFormat) {
+    f3kdb_video_info_t video_info;
+    init_memory_test_video_info(&video_info, 96, 32);
+
+    f3kdb_params_t params;
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_params_init_defaults(&params));
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_params_fill_by_string(&params, "output_depth=10/output_mode=2"));
+    f3kdb_core_t* core_out = nullptr;
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_create(&video_info, &params, &core_out));
+    f3kdb_core_ptr core(core_out);
+
+    aligned_buffer_ptr buffer((unsigned char*)_aligned_malloc(256 * 32, PLANE_ALIGNMENT));
+    const unsigned char* src_planes[3] = {buffer.get(), buffer.get(), buffer.get()};
+    int src_pitches[3] = {96, 48, 48};
+    // 4:2:0 can't be packed
+    ASSERT_EQ(F3KDB_ERROR_INVALID_ARGUMENT, f3kdb_process_frame_v210(core.get(), 0, buffer.get(), 256, src_planes, src_pitches));
+
+    video_info.chroma_height_subsampling = 0;
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_params_fill_by_string(&params, "output_depth=16"));
+    ASSERT_EQ(F3KDB_SUCCESS, f3kdb_create(&video_info, &params, &core_out));
+    f3kdb_core_ptr core_16(core_out);
+    ASSERT_EQ(F3KDB_ERROR_INVALID_ARGUMENT, f3kdb_process_frame_v210(core_16.get(), 0, buffer.get(), 256, src_planes, src_pitches));
+}
+
 #include "test_core_param_set.h"
 
 INSTANTIATE_TEST_CASE_P(Core, CoreTest, Combine(
@@ -0,0 +1,171 @@
+#include "stdafx.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <gtest/gtest.h>
+
+#include "../include/f3kdb.h"
+#include "../cli/frame_service.h"
+#include "test_utils.h"
+
+using namespace testing;
+
+static const int PLANES[] = {PLANE_Y, PLANE_CB, PLANE_CR};
+
+static const int FRAME_COUNT = 50;
+static const int SLOTS_PER_CLIENT = 2;
+
+typedef struct _service_worker_t {
+    frame_service* service;
+    f3kdb_core_t* core;
+} service_worker_t;
+
+// same loop as the workers of "f3kdb --serve"
+static void service_worker_proc(service_worker_t* worker)
+{
+    int slot_index;
+    while ((slot_index = worker->service->take_next_submitted()) >= 0)
+    {
+        worker->service->complete(slot_index, worker->service->process_slot(worker->core, slot_index));
+    }
+}
+
+static unsigned long get_process_id(void)
+{
+#ifdef _WIN32
+    return GetCurrentProcessId();
+#else
+    return (unsigned long)getpid();
+#endif
+}
+
+// The test is the client of a service running in the same process, that's enough to go
+// through the shared memory and the events like a client in another process.
+class FrameServiceTest : public Test {
+protected:
+    f3kdb_video_info_t _video_info;
+    f3kdb_core_ptr _core;
+    frame_service _service;
+    service_worker_t _worker;
+    std::thread _worker_thread;
+    char _name[128];
+
+    virtual void SetUp() {
+        memset(&_video_info, 0, sizeof(_video_info));
+        _video_info.width = 320;
+        _video_info.height = 240;
+        _video_info.chroma_width_subsampling = 1;
+        _video_info.chroma_height_subsampling = 1;
+        _video_info.pixel_mode = LOW_BIT_DEPTH;
+        _video_info.depth = 8;
+        _video_info.num_frames = FRAME_COUNT;
+
+        f3kdb_params_t params;
+        f3kdb_params_init_defaults(&params);
+        params.output_depth = 16;
+        params.output_mode = HIGH_BIT_DEPTH_INTERLEAVED;
+        f3kdb_core_t* core = nullptr;
+        ASSERT_EQ(F3KDB_SUCCESS, f3kdb_create(&_video_info, &params, &core));
+        _core.reset(core);
+
+        // services are per session, the name keeps other runs and earlier tests out
+        _snprintf(_name, sizeof(_name) - 1, "test_%lu_%s", get_process_id(), UnitTest::GetInstance()->current_test_info()->name());
+        _name[sizeof(_name) - 1] = 0;
+        const char* error = _service.create(_name, &_video_info, params.output_depth, 1, SLOTS_PER_CLIENT);
+        ASSERT_TRUE(error == NULL) << error;
+
+        _worker.service = &_service;
+        _worker.core = _core.get();
+        _worker_thread = std::thread(service_worker_proc, &_worker);
+    }
+
+    virtual void TearDown() {
+        if (_worker_thread.joinable())
+        {
+            _service.stop();
+            _worker_thread.join();
+        }
+    }
+
+    void fill_source(unsigned char* src, int frame_number) {
+        size_t offset = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            int width = _video_info.get_plane_width(PLANES[i]);
+            int height = _video_info.get_plane_height(PLANES[i]);
+            for (int y = 0; y < height; y++)
+            {
+                for (int x = 0; x < width; x++)
+                {
+                    // gradient with small steps, so there is banding to work on
+                    src[offset++] = (unsigned char)((x / 7 + y / 5 + (x * 3 + y) % 2 + frame_number + i * 40) & 0xff);
+                }
+            }
+        }
+    }
+};
+
+TEST_F(FrameServiceTest, ClientOutputMatchesCore) {
+    frame_service client;
+    const char* error = client.connect(_name);
+    ASSERT_TRUE(error == NULL) << error;
+    const service_header* header = client.get_header();
+    ASSERT_EQ(FRAME_COUNT, header->num_frames);
+    ASSERT_EQ(16, header->output_depth);
+
+    for (int n = 0; n < SLOTS_PER_CLIENT; n++)
+    {
+        int slot_index = client.get_client_slot(n);
+        int frame_number = n * 17 + 3;
+        fill_source(client.get_src(slot_index), frame_number);
+        ASSERT_EQ(F3KDB_SUCCESS, client.process(slot_index, frame_number));
+
+        const unsigned char* src = client.get_src(slot_index);
+        const unsigned char* dst = client.get_dst(slot_index);
+        for (int i = 0; i < 3; i++)
+        {
+            SCOPED_TRACE(i);
+            int width = _video_info.get_plane_width(PLANES[i]);
+            int height = _video_info.get_plane_height(PLANES[i]);
+            aligned_buffer_ptr expected((unsigned char*)_aligned_malloc(width * height * 2, PLANE_ALIGNMENT));
+            ASSERT_EQ(F3KDB_SUCCESS, f3kdb_process_plane(_core.get(), frame_number, PLANES[i], expected.get(), width * 2, src, width));
+            ASSERT_EQ(0, memcmp(expected.get(), dst, width * height * 2));
+            src += width * height;
+            dst += width * height * 2;
+        }
+    }
+}
+
+TEST_F(FrameServiceTest, NegativeFrameNumberFailsOnlyThatSlot) {
+    frame_service client;
+    const char* error = client.connect(_name);
+    ASSERT_TRUE(error == NULL) << error;
+
+    int slot_index = client.get_client_slot(0);
+    fill_source(client.get_src(slot_index), 0);
+    ASSERT_EQ(F3KDB_ERROR_INVALID_ARGUMENT, client.process(slot_index, -1));
+    ASSERT_EQ(F3KDB_ERROR_INVALID_ARGUMENT, client.process(slot_index, INT_MIN));
+    // the service keeps running
+    ASSERT_EQ(F3KDB_SUCCESS, client.process(slot_index, 0));
+}
+
+TEST_F(FrameServiceTest, ProcessFailsAfterStop) {
+    frame_service client;
+    const char* error = client.connect(_name);
+    ASSERT_TRUE(error == NULL) << error;
+
+    _service.stop();
+    int slot_index = client.get_client_slot(0);
+    fill_source(client.get_src(slot_index), 0);
+    ASSERT_EQ(-1, client.process(slot_index, 0));
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <assert.h>
+#include <malloc.h>
+
+#include <memory>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "../include/f3kdb.h"
+
+template <typename T>
+class AlignedMemoryDeleter
+{
+public:
+    void operator() (T* ptr)
+    {
+        _aligned_free(ptr);
+    }
+};
+
+class F3kdbCoreDeleter
+{
+public:
+    void operator() (f3kdb_core_t* ptr)
+    {
+        if (!ptr) {
+            return;
+        }
+        int ret = f3kdb_destroy(ptr);
+        assert(ret == F3KDB_SUCCESS);
+    }
+};
+
+typedef std::unique_ptr< unsigned char, AlignedMemoryDeleter<unsigned char> > aligned_buffer_ptr;
+typedef std::unique_ptr< f3kdb_core_t, F3kdbCoreDeleter > f3kdb_core_ptr;
+
+// pages are used to place data right before an inaccessible page, so reading past its end crashes
+
+static size_t get_page_size()
+{
+#ifdef _WIN32
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+    return system_info.dwPageSize;
+#else
+    return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+// returns nullptr if out of memory
+static unsigned char* alloc_pages(size_t size)
+{
+#ifdef _WIN32
+    return (unsigned char*)VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+    void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return memory != MAP_FAILED ? (unsigned char*)memory : nullptr;
+#endif
+}
+
+static bool protect_pages_no_access(unsigned char* pages, size_t size)
+{
+#ifdef _WIN32
+    DWORD old_protect;
+    return !!VirtualProtect(pages, size, PAGE_NOACCESS, &old_protect);
+#else
+    return mprotect(pages, size, PROT_NONE) == 0;
+#endif
+}
+
+static void free_pages(unsigned char* pages, size_t size)
+{
+#ifdef _WIN32
+    VirtualFree(pages, 0, MEM_RELEASE);
+#else
+    munmap(pages, size);
+#endif
+}
@@ -6,6 +6,8 @@ typedef struct {
     VSNodeRef *node;
     VSVideoInfo vi;
     f3kdb_core_t* core;
+    // planes that are taken from the source frame as they are
+    bool passthrough[3];
 } f3kdb_vs_context_t;
 
 static const int F3KDB_PLANES[] = {PLANE_Y, PLANE_CB, PLANE_CR};
@@ -22,9 +24,20 @@ static const VSFrameRef *VS_CC f3kdbGetFrame(int n, int activationReason, void *
         vsapi->requestFrameFilter(n, d->node, frameCtx);
     } else if (activationReason == arAllFramesReady) {
         const VSFrameRef *src = vsapi->getFrameFilter(n, d->node, frameCtx);
-        VSFrameRef *dst = vsapi->newVideoFrame(d->vi.format, d->vi.width, d->vi.height, src, core);
+        // untouched planes are shared with the source frame instead of being copied
+        const VSFrameRef* plane_src[3];
+        static const int planes[3] = {0, 1, 2};
+        for (int i = 0; i < 3; i++)
+        {
+            plane_src[i] = d->passthrough[i] ? src : NULL;
+        }
+        VSFrameRef *dst = vsapi->newVideoFrame2(d->vi.format, d->vi.width, d->vi.height, plane_src, planes, src, core);
         for (int i = 0; i < d->vi.format->numPlanes; i++)
         {
+            if (d->passthrough[i])
+            {
+                continue;
+            }
             const unsigned char* src_ptr = vsapi->getReadPtr(src, i);
             int src_stride = vsapi->getStride(src, i);
             unsigned char* dst_ptr = vsapi->getWritePtr(dst, i);
@@ -38,6 +51,8 @@ static const VSFrameRef *VS_CC f3kdbGetFrame(int n, int activationReason, void *
                 memset(msg, 0, sizeof(msg));
                 _snprintf(msg, sizeof(msg) - 1, "f3kdb: Error while processing plane, f3kdb_plane: %d, code: %d", f3kdb_plane, result);
                 vsapi->setFilterError(msg, frameCtx);
+                vsapi->freeFrame(src);
+                vsapi->freeFrame(dst);
                 return 0;
             }
         }
@@ -66,14 +81,15 @@ static void VS_CC f3kdbCreate(const VSMap *in, VSMap *out, void *userData, VSCor
         return;
     }
 
-    if (vi.format->sampleType != stInteger)
+    bool float_input = vi.format->sampleType == stFloat;
+    if (float_input && vi.format->bitsPerSample != 32)
     {
-        vsapi->setError(out, "f3kdb: Only integer sample format is supported");
+        vsapi->setError(out, "f3kdb: Only 32-bit float samples are supported");
         vsapi->freeNode(node);
         return;
     }
 
-    if (vi.format->bitsPerSample < 8 || vi.format->bitsPerSample > 16)
+    if (!float_input && (vi.format->bitsPerSample < 8 || vi.format->bitsPerSample > 16))
     {
         vsapi->setError(out, "f3kdb: Only 8 ~ 16 bits per sample is supported");
         vsapi->freeNode(node);
@@ -89,19 +105,55 @@ static void VS_CC f3kdbCreate(const VSMap *in, VSMap *out, void *userData, VSCor
         vsapi->freeNode(node);
         return;
     }
-    params.output_mode = params.output_depth <= 8 ? LOW_BIT_DEPTH : HIGH_BIT_DEPTH_INTERLEAVED;
+    if (float_input && params.output_depth == -1)
+    {
+        // float clips stay float unless another depth is asked for
+        params.output_depth = 32;
+    }
+    if (params.output_depth == 32)
+    {
+        params.output_mode = HIGH_BIT_DEPTH_FLOAT;
+    } else {
+        params.output_mode = params.output_depth <= 8 ? LOW_BIT_DEPTH : HIGH_BIT_DEPTH_INTERLEAVED;
+    }
     f3kdb_params_sanitize(&params);
 
+    // all planes are processed unless they are listed
+    bool process_planes[3] = {true, true, true};
+    int plane_count = vsapi->propNumElements(in, "planes");
+    if (plane_count >= 0)
+    {
+        process_planes[0] = process_planes[1] = process_planes[2] = false;
+        for (int i = 0; i < plane_count; i++)
+        {
+            int plane = int64ToIntS(vsapi->propGetInt(in, "planes", i, 0));
+            if (plane < 0 || plane >= vi.format->numPlanes)
+            {
+                vsapi->setError(out, "f3kdb: Plane index out of range");
+                vsapi->freeNode(node);
+                return;
+            }
+            process_planes[plane] = true;
+        }
+    }
+
     f3kdb_video_info_t video_info;
     video_info.width = vi.width;
     video_info.height = vi.height;
     video_info.depth = vi.format->bitsPerSample;
-    video_info.pixel_mode = vi.format->bitsPerSample == 8 ? LOW_BIT_DEPTH : HIGH_BIT_DEPTH_INTERLEAVED;
+    if (float_input)
+    {
+        video_info.pixel_mode = HIGH_BIT_DEPTH_FLOAT;
+    } else {
+        video_info.pixel_mode = vi.format->bitsPerSample == 8 ? LOW_BIT_DEPTH : HIGH_BIT_DEPTH_INTERLEAVED;
+    }
     video_info.num_frames = vi.numFrames;
     video_info.chroma_width_subsampling = vi.format->subSamplingW;
     video_info.chroma_height_subsampling = vi.format->subSamplingH;
+    // R, G and B take y, cb and cr as thresholds, and grainy, grainc and grainc as grain
+    video_info.color_family = vi.format->colorFamily == cmRGB ? COLOR_FAMILY_RGB : COLOR_FAMILY_YUV;
 
-    const VSFormat* new_format = vsapi->registerFormat(vi.format->colorFamily, vi.format->sampleType, params.output_depth, vi.format->subSamplingW, vi.format->subSamplingH, core);
+    const VSFormat* new_format = vsapi->registerFormat(vi.format->colorFamily, params.output_mode == HIGH_BIT_DEPTH_FLOAT ? stFloat : stInteger, params.output_depth, vi.format->subSamplingW, vi.format->subSamplingH, core);
     if (!new_format)
     {
         vsapi->setError(out, "f3kdb: Unable to register output format");
@@ -123,6 +175,22 @@ static void VS_CC f3kdbCreate(const VSMap *in, VSMap *out, void *userData, VSCor
         return;
     }
 
+    bool passthrough[3] = {false, false, false};
+    for (int i = 0; i < vi.format->numPlanes; i++)
+    {
+        int plane_passthrough = 0;
+        f3kdb_get_plane_passthrough(f3kdb_core, F3KDB_PLANES[i], &plane_passthrough);
+        if (!process_planes[i] && !plane_passthrough && new_format != vi.format)
+        {
+            // the plane still has to be converted to the output format
+            vsapi->setError(out, "f3kdb: planes can only leave out planes if output_depth is the same as the input");
+            f3kdb_destroy(f3kdb_core);
+            vsapi->freeNode(node);
+            return;
+        }
+        passthrough[i] = !process_planes[i] || plane_passthrough;
+    }
+
     f3kdb_vs_context_t* context = (f3kdb_vs_context_t*)malloc(sizeof(f3kdb_vs_context_t));
     if (!context)
     {
@@ -136,6 +204,7 @@ static void VS_CC f3kdbCreate(const VSMap *in, VSMap *out, void *userData, VSCor
     context->node = node;
     context->vi = vi;
     context->vi.format = new_format;
+    memcpy(context->passthrough, passthrough, sizeof(passthrough));
 
     vsapi->createFilter(in, out, "f3kdb", f3kdbInit, f3kdbGetFrame, f3kdbFree, fmParallel, 0, context, core);
     return;
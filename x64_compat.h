@@ -1,4 +1,4 @@
-#ifdef _M_X64
+#if defined(_M_X64) || defined(__x86_64__)
 typedef __int64 POINTER_INT;
 #else
 typedef int POINTER_INT;